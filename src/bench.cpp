@@ -0,0 +1,338 @@
+//
+// bench.cpp
+//     Benchmark harness that times the individual steps of the TriplClust
+//     algorithm on the reference data sets and on scaled up copies thereof.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "option.h"
+#include "pipeline.h"
+#include "pointcloud.h"
+#include "stats.h"
+#include "util.h"
+
+// usage message
+const char *usage =
+    "Usage:\n"
+    "\ttriplclust-bench [options] <datadir>\n"
+    "Runs each step of triplclust on the reference data files in <datadir>\n"
+    "(with the parameters recommended in data/README.md) and writes the\n"
+    "median and 95th percentile of the run times as JSON.\n"
+    "Options (defaults in brackets):\n"
+    "\t-p <options>   additional triplclust options for all data files,\n"
+    "\t               e.g. -p \"-index grid -threads 4\" ['']\n"
+    "\t-reps <n>      number of repetitions per data set [5]\n"
+    "\t-scale <list>  comma separated scale-up factors; factor f runs\n"
+    "\t               on f translated copies of each data set [1,2,4]\n"
+    "\t-o <file>      write JSON result to <file> instead of stdout\n"
+    "Version:\n"
+    "\t" TRIPLCLUST_VERSION;
+
+// reference data files and their recommended parameters (data/README.md)
+struct ReferenceData {
+  const char *file;
+  const char *params;
+};
+const ReferenceData reference_data[] = {
+    {"attpc.dat", ""},           {"lidar.dat", "-k 12 -t 12"},
+    {"radar.dat", "-a 0.003"},   {"synthetic-clean.dat", ""},
+    {"synthetic-noise.dat", "-r 1.0"}, {"tennis.dat", "-k 12"}};
+const size_t n_reference_data =
+    sizeof(reference_data) / sizeof(reference_data[0]);
+
+// the timed steps of the algorithm, i.e. the timers of run_pipeline
+// (the optional steps have zero times when their option is not given)
+enum Stage {
+  VOXEL, DEDUP, DNN, SMOOTH, TRIPLETS, ISOLATED, CLUSTER, PRUNE, N_STAGES
+};
+const char *stage_names[N_STAGES] = {"voxel",    "dedup",    "dnn",
+                                     "smoothing", "triplets", "isolated",
+                                     "clustering", "pruning"};
+
+// result of a single benchmark run
+struct BenchResult {
+  std::string dataset;
+  std::string params;
+  size_t scale;
+  size_t points;
+  size_t triplets;
+  size_t clusters;
+  std::vector<double> wall[N_STAGES];
+  std::vector<double> cpu[N_STAGES];
+  std::vector<double> wall_total, cpu_total;
+};
+
+//-------------------------------------------------------------------
+// Parses the triplclust command line options in *params* into *opt*.
+// Returns 0 if no error occurred.
+//-------------------------------------------------------------------
+int parse_params(const std::string &params, Opt &opt) {
+  std::istringstream iss(params);
+  std::vector<std::string> tokens;
+  std::string token;
+  while (iss >> token) tokens.push_back(token);
+  std::vector<char *> argv;
+  argv.push_back((char *)"triplclust");
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    argv.push_back((char *)tokens[i].c_str());
+  }
+  argv.push_back(NULL);
+  // beware that no infile is given, so that no dangling pointer to
+  // *tokens* is kept in *opt*
+  return opt.parse_args((int)tokens.size() + 1, &argv[0]);
+}
+
+//-------------------------------------------------------------------
+// Creates *factor* copies of *cloud* in *result* that are translated
+// along the x-axis so that they do not overlap.
+//-------------------------------------------------------------------
+void scale_cloud(const PointCloud &cloud, size_t factor, PointCloud &result) {
+  double xmin = cloud[0].x, xmax = cloud[0].x;
+  for (size_t i = 1; i < cloud.size(); ++i) {
+    if (cloud[i].x < xmin) xmin = cloud[i].x;
+    if (cloud[i].x > xmax) xmax = cloud[i].x;
+  }
+  const double shift = 1.5 * (xmax - xmin) + 1.0;
+  result.clear();
+  result.set2d(cloud.is2d());
+  result.setOrdered(cloud.isOrdered());
+  for (size_t f = 0; f < factor; ++f) {
+    for (size_t i = 0; i < cloud.size(); ++i) {
+      Point p(cloud[i].x + f * shift, cloud[i].y, cloud[i].z, result.size());
+      result.push_back(p);
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+// Runs all steps of the algorithm on *cloud* with the options *opt*
+// through run_pipeline, i.e. with the same engines, spatial indices and
+// threads as triplclust, and appends the wall and CPU time of each step
+// (as recorded by its timers) and of the whole run to *result*. Throws
+// std::runtime_error when the pipeline fails.
+//-------------------------------------------------------------------
+void run_stages(const PointCloud &cloud, Opt opt, BenchResult &result) {
+  Stats stats;
+  std::vector<PipelineResult> results;
+  double wall = wall_time(), cpu = cpu_time();
+  int rc = run_pipeline(cloud, opt, results, stats);
+  result.wall_total.push_back(wall_time() - wall);
+  result.cpu_total.push_back(cpu_time() - cpu);
+  if (rc != 0) {
+    std::ostringstream oss;
+    oss << "exit code " << rc;
+    throw std::runtime_error(oss.str());
+  }
+  for (size_t s = 0; s < N_STAGES; ++s) {
+    double stage_wall, stage_cpu;
+    stats.get_time(stage_names[s], stage_wall, stage_cpu);
+    result.wall[s].push_back(stage_wall);
+    result.cpu[s].push_back(stage_cpu);
+  }
+
+  result.points = cloud.size();
+  result.triplets = stats.get_count("triplets");
+  result.clusters = results.empty() ? 0 : results[0].clusters.size();
+}
+
+//-------------------------------------------------------------------
+// Returns the quantile *q* (between 0 and 1) of *values* with the
+// nearest rank method. The median of an even number of values is
+// the mean of the two middle values.
+//-------------------------------------------------------------------
+double quantile(std::vector<double> values, double q) {
+  if (values.empty()) return 0.0;
+  std::sort(values.begin(), values.end());
+  const size_t n = values.size();
+  if (q == 0.5 && n % 2 == 0) {
+    return (values[n / 2 - 1] + values[n / 2]) / 2.0;
+  }
+  size_t rank = (size_t)std::ceil(q * n);
+  if (rank < 1) rank = 1;
+  return values[rank - 1];
+}
+
+//-------------------------------------------------------------------
+// Writes all benchmark results in *results* as JSON to *os*.
+//-------------------------------------------------------------------
+void results_to_json(std::ostream &os, const std::vector<BenchResult> &results,
+                     size_t reps) {
+  os << "{\n  \"version\": \"" << TRIPLCLUST_VERSION << "\",\n"
+     << "  \"repetitions\": " << reps << ",\n"
+     << "  \"unit\": \"s\",\n"
+     << "  \"runs\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &r = results[i];
+    os << (i ? ",\n" : "\n") << "    {\n"
+       << "      \"dataset\": \"" << json_escape(r.dataset) << "\",\n"
+       << "      \"params\": \"" << json_escape(r.params) << "\",\n"
+       << "      \"scale\": " << r.scale << ",\n"
+       << "      \"points\": " << r.points << ",\n"
+       << "      \"triplets\": " << r.triplets << ",\n"
+       << "      \"clusters\": " << r.clusters << ",\n"
+       << "      \"stages\": {";
+    for (size_t s = 0; s < N_STAGES; ++s) {
+      os << (s ? ",\n" : "\n") << "        \"" << stage_names[s] << "\": "
+         << "{\"wall_median\": " << quantile(r.wall[s], 0.5)
+         << ", \"wall_p95\": " << quantile(r.wall[s], 0.95)
+         << ", \"cpu_median\": " << quantile(r.cpu[s], 0.5)
+         << ", \"cpu_p95\": " << quantile(r.cpu[s], 0.95) << "}";
+    }
+    os << ",\n        \"total\": "
+       << "{\"wall_median\": " << quantile(r.wall_total, 0.5)
+       << ", \"wall_p95\": " << quantile(r.wall_total, 0.95)
+       << ", \"cpu_median\": " << quantile(r.cpu_total, 0.5)
+       << ", \"cpu_p95\": " << quantile(r.cpu_total, 0.95) << "}";
+    os << "\n      }\n    }";
+  }
+  os << "\n  ]\n}\n";
+}
+
+int main(int argc, char **argv) {
+  const char *datadir = NULL, *outfile_name = NULL;
+  std::string extra_params;
+  size_t reps = 5;
+  std::vector<size_t> scales;
+
+  // parse commandline
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (0 == strcmp(argv[i], "-reps")) {
+        if (++i >= argc) {
+          std::cerr << usage << std::endl;
+          return 1;
+        }
+        reps = (size_t)stod(argv[i]);
+      } else if (0 == strcmp(argv[i], "-scale")) {
+        if (++i >= argc) {
+          std::cerr << usage << std::endl;
+          return 1;
+        }
+        std::vector<std::string> items;
+        split(argv[i], items, ',');
+        for (size_t j = 0; j < items.size(); ++j) {
+          scales.push_back((size_t)stod(items[j].c_str()));
+        }
+      } else if (0 == strcmp(argv[i], "-p")) {
+        if (++i >= argc) {
+          std::cerr << usage << std::endl;
+          return 1;
+        }
+        extra_params = argv[i];
+      } else if (0 == strcmp(argv[i], "-o")) {
+        if (++i >= argc) {
+          std::cerr << usage << std::endl;
+          return 1;
+        }
+        outfile_name = argv[i];
+      } else if (argv[i][0] == '-') {
+        std::cerr << usage << std::endl;
+        return 1;
+      } else {
+        datadir = argv[i];
+      }
+    }
+  } catch (const std::invalid_argument &e) {
+    std::cerr << "[Error] " << e.what() << std::endl << usage << std::endl;
+    return 1;
+  }
+  if (!datadir) {
+    std::cerr << "[Error] no data directory given!\n" << usage << std::endl;
+    return 1;
+  }
+  if (scales.empty()) {
+    scales.push_back(1);
+    scales.push_back(2);
+    scales.push_back(4);
+  }
+  for (size_t i = 0; i < scales.size(); ++i) {
+    if (scales[i] < 1) {
+      std::cerr << "[Error] scale factors must be at least one" << std::endl;
+      return 1;
+    }
+  }
+  if (reps < 1) {
+    std::cerr << "[Error] at least one repetition is required" << std::endl;
+    return 1;
+  }
+
+  std::vector<BenchResult> results;
+  for (size_t d = 0; d < n_reference_data; ++d) {
+    std::string fname =
+        std::string(datadir) + "/" + reference_data[d].file;
+    std::string params = reference_data[d].params;
+    if (!extra_params.empty()) {
+      if (!params.empty()) params += " ";
+      params += extra_params;
+    }
+    Opt opt;
+    if (parse_params(params, opt) != 0) {
+      std::cerr << "[Error] invalid parameters for " << reference_data[d].file
+                << std::endl;
+      return 1;
+    }
+    PointCloud cloud;
+    cloud.setOrdered(opt.get_ordered());
+    try {
+      load_csv_file(fname.c_str(), cloud, opt.get_delimiter(),
+                    opt.get_skip());
+    } catch (const std::exception &e) {
+      std::cerr << "[Error] cannot read infile '" << fname << "'! "
+                << e.what() << std::endl;
+      return 2;
+    }
+    if (cloud.empty()) {
+      std::cerr << "[Error] empty cloud in file '" << fname << "'"
+                << std::endl;
+      return 2;
+    }
+
+    for (size_t s = 0; s < scales.size(); ++s) {
+      BenchResult result;
+      result.dataset = reference_data[d].file;
+      result.params = params;
+      result.scale = scales[s];
+      PointCloud scaled_cloud;
+      scale_cloud(cloud, scales[s], scaled_cloud);
+      try {
+        for (size_t k = 0; k < reps; ++k) {
+          run_stages(scaled_cloud, opt, result);
+        }
+      } catch (const std::exception &e) {
+        std::cerr << "[Error] benchmark on '" << fname << "' with scale "
+                  << scales[s] << " failed: " << e.what() << std::endl;
+        return 3;
+      }
+      results.push_back(result);
+    }
+  }
+
+  if (outfile_name) {
+    std::ofstream of(outfile_name);
+    if (!of.is_open()) {
+      std::cerr << "[Error] could not write file '" << outfile_name << "'"
+                << std::endl;
+      return 2;
+    }
+    results_to_json(of, results, reps);
+    of.close();
+  } else {
+    results_to_json(std::cout, results, reps);
+  }
+
+  return 0;
+}
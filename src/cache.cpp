@@ -0,0 +1,298 @@
+//
+// cache.cpp
+//     Cache directory for the results of the individual steps of the
+//     algorithm, so that reruns with partly changed parameters can
+//     resume from the deepest step that is unaffected by the changes.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "cache.h"
+
+// FNV-1a parameters for 64 bit
+const uint64_t fnv_offset = 14695981039346656037ULL;
+const uint64_t fnv_prime = 1099511628211ULL;
+
+// start of each cache file (followed by the format version)
+const char cache_magic[8] = {'T', 'C', 'C', 'A', 'C', 'H', 'E', '1'};
+
+//-------------------------------------------------------------------
+// Starts the hash with the precision of the coordinates and distances,
+// so that triplclust and triplclust-float never share cache entries.
+//-------------------------------------------------------------------
+CacheKey::CacheKey() {
+  this->hash = fnv_offset;
+  this->add(sizeof(coord_t)).add(sizeof(t_float));
+}
+
+// adds *n* bytes from *bytes* to the hash
+CacheKey &CacheKey::add(const void *bytes, size_t n) {
+  const unsigned char *p = (const unsigned char *)bytes;
+  for (size_t i = 0; i < n; ++i) {
+    this->hash ^= p[i];
+    this->hash *= fnv_prime;
+  }
+  return *this;
+}
+
+CacheKey &CacheKey::add(double value) { return this->add(&value, sizeof(value)); }
+
+CacheKey &CacheKey::add(size_t value) {
+  uint64_t v = value;
+  return this->add(&v, sizeof(v));
+}
+
+CacheKey &CacheKey::add(const char *str) {
+  return this->add(str, strlen(str) + 1);
+}
+
+// adds the coordinates and the flags of *cloud* to the hash
+CacheKey &CacheKey::add(const PointCloud &cloud) {
+  this->add(cloud.size());
+  this->add((size_t)(cloud.is2d() ? 1 : 0));
+  this->add((size_t)(cloud.isOrdered() ? 1 : 0));
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    this->add(cloud[i].x).add(cloud[i].y).add(cloud[i].z);
+  }
+  return *this;
+}
+
+uint64_t CacheKey::value() const { return this->hash; }
+
+//-------------------------------------------------------------------
+// Buffers for the binary cache file contents in native byte order.
+//-------------------------------------------------------------------
+class CacheWriter {
+ public:
+  std::vector<char> data;
+  template <typename T>
+  void put(const T &value) {
+    const char *p = (const char *)&value;
+    this->data.insert(this->data.end(), p, p + sizeof(T));
+  }
+};
+
+class CacheReader {
+ private:
+  const std::vector<char> &data;
+  size_t pos;
+
+ public:
+  CacheReader(const std::vector<char> &d) : data(d), pos(0) {}
+  // returns false when the data is exhausted
+  template <typename T>
+  bool get(T &value) {
+    if (this->pos + sizeof(T) > this->data.size()) return false;
+    memcpy(&value, &this->data[this->pos], sizeof(T));
+    this->pos += sizeof(T);
+    return true;
+  }
+  bool at_end() const { return this->pos == this->data.size(); }
+};
+
+//-------------------------------------------------------------------
+// Uses the directory *dir* for the cache and creates it if necessary.
+//-------------------------------------------------------------------
+StageCache::StageCache(const char *dir) : dir(dir) {
+#ifdef _WIN32
+  _mkdir(dir);
+#else
+  mkdir(dir, 0777);
+#endif
+}
+
+// file name for the result of step *ext* with key *key*
+std::string StageCache::path(const CacheKey &key, const char *ext) const {
+  char hex[17];
+  sprintf(hex, "%016llx", (unsigned long long)key.value());
+  return this->dir + "/" + hex + "." + ext;
+}
+
+//-------------------------------------------------------------------
+// Reads the payload of the cache file for *key* and *ext* into *data*.
+// Returns false if the file does not exist or has a wrong header.
+//-------------------------------------------------------------------
+bool StageCache::open_read(const CacheKey &key, const char *ext,
+                           std::vector<char> &data) const {
+  std::ifstream in(this->path(key, ext).c_str(), std::ios::binary);
+  if (!in.is_open()) return false;
+  char magic[sizeof(cache_magic)];
+  uint64_t stored_key;
+  in.read(magic, sizeof(magic));
+  in.read((char *)&stored_key, sizeof(stored_key));
+  if (!in || memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+      stored_key != key.value())
+    return false;
+  std::ostringstream oss;
+  oss << in.rdbuf();
+  std::string s = oss.str();
+  data.assign(s.begin(), s.end());
+  return true;
+}
+
+//-------------------------------------------------------------------
+// Writes *data* to the cache file for *key* and *ext*. The file is
+// first written under a temporary name with the process id, so that
+// concurrent runs never see incomplete files nor write to the same
+// temporary file. Returns false on errors.
+//-------------------------------------------------------------------
+bool StageCache::write(const CacheKey &key, const char *ext,
+                       const std::vector<char> &data) const {
+  std::string fname = this->path(key, ext);
+  std::ostringstream tmp;
+  tmp << fname << "." << getpid() << ".tmp";
+  std::string tmpname = tmp.str();
+  std::ofstream of(tmpname.c_str(), std::ios::binary);
+  if (!of.is_open()) return false;
+  uint64_t stored_key = key.value();
+  of.write(cache_magic, sizeof(cache_magic));
+  of.write((const char *)&stored_key, sizeof(stored_key));
+  if (!data.empty()) of.write(&data[0], data.size());
+  of.close();
+  if (!of || std::rename(tmpname.c_str(), fname.c_str()) != 0) {
+    std::remove(tmpname.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool StageCache::load_dnn(const CacheKey &key, double &dnn) const {
+  std::vector<char> data;
+  if (!this->open_read(key, "dnn", data)) return false;
+  CacheReader reader(data);
+  return reader.get(dnn) && reader.at_end();
+}
+
+bool StageCache::save_dnn(const CacheKey &key, double dnn) const {
+  CacheWriter writer;
+  writer.put(dnn);
+  return this->write(key, "dnn", writer.data);
+}
+
+bool StageCache::load_cloud(const CacheKey &key, PointCloud &cloud) const {
+  std::vector<char> data;
+  if (!this->open_read(key, "cloud", data)) return false;
+  CacheReader reader(data);
+  uint64_t n, index, flags;
+  if (!reader.get(n) || !reader.get(flags)) return false;
+  cloud.clear();
+  cloud.set2d((flags & 1) != 0);
+  cloud.setOrdered((flags & 2) != 0);
+  for (uint64_t i = 0; i < n; ++i) {
+    double x, y, z;
+    if (!reader.get(x) || !reader.get(y) || !reader.get(z) ||
+        !reader.get(index))
+      return false;
+    cloud.push_back(Point(x, y, z, (size_t)index));
+  }
+  return reader.at_end();
+}
+
+bool StageCache::save_cloud(const CacheKey &key,
+                            const PointCloud &cloud) const {
+  CacheWriter writer;
+  writer.put((uint64_t)cloud.size());
+  writer.put((uint64_t)((cloud.is2d() ? 1 : 0) | (cloud.isOrdered() ? 2 : 0)));
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    writer.put(cloud[i].x);
+    writer.put(cloud[i].y);
+    writer.put(cloud[i].z);
+    writer.put((uint64_t)cloud[i].index);
+  }
+  return this->write(key, "cloud", writer.data);
+}
+
+bool StageCache::load_triplets(const CacheKey &key,
+                               std::vector<triplet> &triplets) const {
+  std::vector<char> data;
+  if (!this->open_read(key, "triplets", data)) return false;
+  CacheReader reader(data);
+  uint64_t n, a, b, c;
+  if (!reader.get(n)) return false;
+  triplets.clear();
+  for (uint64_t i = 0; i < n; ++i) {
+    triplet t;
+    if (!reader.get(a) || !reader.get(b) || !reader.get(c) ||
+        !reader.get(t.center[0]) || !reader.get(t.center[1]) ||
+        !reader.get(t.center[2]) || !reader.get(t.direction[0]) ||
+        !reader.get(t.direction[1]) || !reader.get(t.direction[2]) ||
+        !reader.get(t.error))
+      return false;
+    t.point_index_a = a;
+    t.point_index_b = b;
+    t.point_index_c = c;
+    triplets.push_back(t);
+  }
+  return reader.at_end();
+}
+
+bool StageCache::save_triplets(const CacheKey &key,
+                               const std::vector<triplet> &triplets) const {
+  CacheWriter writer;
+  writer.put((uint64_t)triplets.size());
+  for (size_t i = 0; i < triplets.size(); ++i) {
+    const triplet &t = triplets[i];
+    writer.put((uint64_t)t.point_index_a);
+    writer.put((uint64_t)t.point_index_b);
+    writer.put((uint64_t)t.point_index_c);
+    writer.put(t.center[0]);
+    writer.put(t.center[1]);
+    writer.put(t.center[2]);
+    writer.put(t.direction[0]);
+    writer.put(t.direction[1]);
+    writer.put(t.direction[2]);
+    writer.put(t.error);
+  }
+  return this->write(key, "triplets", writer.data);
+}
+
+bool StageCache::load_dendrogram(const CacheKey &key,
+                                 Dendrogram &dendrogram) const {
+  std::vector<char> data;
+  if (!this->open_read(key, "dendro", data)) return false;
+  CacheReader reader(data);
+  uint64_t n;
+  if (!reader.get(n)) return false;
+  size_t n_merges = n ? n - 1 : 0;
+  dendrogram.n = n;
+  dendrogram.merge.resize(2 * n_merges);
+  dendrogram.height.resize(n_merges);
+  for (size_t i = 0; i < 2 * n_merges; ++i) {
+    int32_t m;
+    if (!reader.get(m)) return false;
+    dendrogram.merge[i] = m;
+  }
+  for (size_t i = 0; i < n_merges; ++i) {
+    if (!reader.get(dendrogram.height[i])) return false;
+  }
+  return reader.at_end();
+}
+
+bool StageCache::save_dendrogram(const CacheKey &key,
+                                 const Dendrogram &dendrogram) const {
+  CacheWriter writer;
+  writer.put((uint64_t)dendrogram.n);
+  for (size_t i = 0; i < dendrogram.merge.size(); ++i) {
+    writer.put((int32_t)dendrogram.merge[i]);
+  }
+  for (size_t i = 0; i < dendrogram.height.size(); ++i) {
+    writer.put(dendrogram.height[i]);
+  }
+  return this->write(key, "dendro", writer.data);
+}
@@ -0,0 +1,67 @@
+//
+// cache.h
+//     Cache directory for the results of the individual steps of the
+//     algorithm, so that reruns with partly changed parameters can
+//     resume from the deepest step that is unaffected by the changes.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "cluster.h"
+#include "pointcloud.h"
+#include "triplet.h"
+
+// FNV-1a hash over the bytes of values, used as key for the cache.
+// The key of a step combines the key of the previous step with the
+// parameters on which the step depends.
+class CacheKey {
+ private:
+  uint64_t hash;
+
+ public:
+  CacheKey();
+  CacheKey &add(const void *bytes, size_t n);
+  CacheKey &add(double value);
+  CacheKey &add(size_t value);
+  CacheKey &add(const char *str);
+  CacheKey &add(const PointCloud &cloud);
+  uint64_t value() const;
+};
+
+// Directory with the cached results (dnn, smoothed cloud, triplets,
+// dendrogram), each stored in the file <dir>/<key>.<step>. Files
+// that cannot be read are treated as missing.
+class StageCache {
+ private:
+  std::string dir;
+  std::string path(const CacheKey &key, const char *ext) const;
+  bool open_read(const CacheKey &key, const char *ext,
+                 std::vector<char> &data) const;
+  bool write(const CacheKey &key, const char *ext,
+             const std::vector<char> &data) const;
+
+ public:
+  StageCache(const char *dir);
+  bool load_dnn(const CacheKey &key, double &dnn) const;
+  bool save_dnn(const CacheKey &key, double dnn) const;
+  bool load_cloud(const CacheKey &key, PointCloud &cloud) const;
+  bool save_cloud(const CacheKey &key, const PointCloud &cloud) const;
+  bool load_triplets(const CacheKey &key,
+                     std::vector<triplet> &triplets) const;
+  bool save_triplets(const CacheKey &key,
+                     const std::vector<triplet> &triplets) const;
+  bool load_dendrogram(const CacheKey &key, Dendrogram &dendrogram) const;
+  bool save_dendrogram(const CacheKey &key,
+                       const Dendrogram &dendrogram) const;
+};
+
+#endif
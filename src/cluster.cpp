@@ -11,9 +11,15 @@
 #include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <limits>
+#include <stdexcept>
 
 #include "cluster.h"
+#include "directionbins.h"
+#include "diskmatrix.h"
 #include "hclust/fastcluster.h"
+#include "spatialindex.h"
+#include "stats.h"
 
 // compute mean of *a* with size *m*
 double mean(const double *a, size_t m) {
@@ -39,15 +45,21 @@ double sd(const double *a, size_t m) {
 //-------------------------------------------------------------------
 // computation of condensed distance matrix.
 // The distance matrix is computed from the triplets in *triplets*
-// and saved in *result*. *triplet_metric* is used as distance metric.
+// and saved in *result*. *triplet_metric* is used as distance metric
+// for the triplets of a cloud of dimension *D*. The rows are computed
+// by *threads* threads.
 //-------------------------------------------------------------------
+template <size_t D>
 void calculate_distance_matrix(const std::vector<triplet> &triplets,
-                               const PointCloud &cloud, double *result,
-                               ScaleTripletMetric &triplet_metric) {
+                               const PointCloud &cloud, t_float *result,
+                               const ScaleTripletMetric<D> &triplet_metric,
+                               int threads) {
   size_t const triplet_size = triplets.size();
-  size_t k = 0;
 
-  for (size_t i = 0; i < triplet_size; ++i) {
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 64) if (threads > 1)
+  for (long i = 0; i < (long)triplet_size; ++i) {
+    // offset of row i in the condensed matrix
+    size_t k = (size_t)i * (2 * triplet_size - i - 1) / 2;
     for (size_t j = i + 1; j < triplet_size; j++) {
       result[k++] = triplet_metric(triplets[i], triplets[j]);
     }
@@ -55,23 +67,93 @@ void calculate_distance_matrix(const std::vector<triplet> &triplets,
 }
 
 //-------------------------------------------------------------------
-// Computation of the clustering.
+// triplet dissimilarity computed on demand for the clustering
+// without distance matrix for a cloud of dimension *D*. Counts the
+// number of evaluations.
+//-------------------------------------------------------------------
+template <size_t D>
+class TripletDissimilarity : public hclust_dissimilarity {
+ private:
+  const std::vector<triplet> &triplets;
+  ScaleTripletMetric<D> triplet_metric;
+
+ public:
+  size_t evaluations;
+  TripletDissimilarity(const std::vector<triplet> &t, double s)
+      : triplets(t), triplet_metric(s), evaluations(0) {}
+  double operator()(int i, int j) {
+    ++evaluations;
+    // same argument order as in calculate_distance_matrix
+    if (i < j)
+      return triplet_metric(triplets[i], triplets[j]);
+    else
+      return triplet_metric(triplets[j], triplets[i]);
+  }
+};
+
+// single linkage clustering of *triplets* of a cloud of dimension *D*
+// with TripletDissimilarity; returns the result of hclust_fast_nomatrix
+// and the number of distance *evaluations*
+template <size_t D>
+static int cluster_without_matrix(const std::vector<triplet> &triplets,
+                                  double s, int *merge, double *cdists,
+                                  size_t &evaluations) {
+  TripletDissimilarity<D> dissimilarity(triplets, s);
+  int rc = hclust_fast_nomatrix(triplets.size(), dissimilarity, merge, cdists);
+  evaluations = dissimilarity.evaluations;
+  return rc;
+}
+
+//-------------------------------------------------------------------
+// Estimate of the memory in bytes that is needed by compute_hc for
+// clustering *n_triplets* triplets with the linkage *method* and
+// the algorithm *engine*. The triplets themselves are not included.
+//-------------------------------------------------------------------
+double estimate_hc_memory(size_t n_triplets, Linkage method,
+                          HcEngine engine) {
+  const double n = (double)n_triplets;
+  // output arrays (merge, cdists, labels) and the internal working
+  // arrays of fastcluster (dendrogram, union-find, linked list, etc.)
+  // need about 128 bytes per triplet
+  double bytes = 128.0 * n;
+  if (engine != ENGINE_DISK && engine != ENGINE_GRAPH &&
+      (engine != ENGINE_MATRIXFREE || method != SINGLE)) {
+    // condensed distance matrix (ENGINE_DISK keeps it in a file)
+    bytes += sizeof(t_float) * n * (n - 1.0) / 2.0;
+  }
+  return bytes;
+}
+
+//-------------------------------------------------------------------
+// Computation of the dendrogram.
 // The triplets in *triplets* are clustered by the fastcluster algorithm
-// and the result is returned as cluster_group. *t* is the cut distance
-// and *triplet_metric* is the distance metric for the triplets.
-// *opt_verbose* is the verbosity level for debug outputs. the clustering
-// is returned in *result*.
+// with the distance scale *s* and the linkage *method*, and the merge
+// steps are returned in *result*. *engine* determines whether the
+// distance matrix is stored (ENGINE_MATRIX), stored in a memory-mapped
+// file in the directory *matrix_dir* (ENGINE_DISK), or whether the
+// distances are computed on demand (ENGINE_MATRIXFREE, only possible
+// for single linkage). *opt_verbose* is the verbosity level for debug
+// outputs. When *stats* is given, the times for the distance matrix and
+// the dendrogram and the sizes are recorded. The distance matrix and,
+// for the engines with matrix, the dendrogram are computed by *threads*
+// threads, which does not change the result; the dendrogram scans are
+// only split for at least *min_chunk* clusters per thread. Throws
+// runtime_error when
+// the matrix file cannot be created or a triplet distance is NaN.
 //-------------------------------------------------------------------
-void compute_hc(const PointCloud &cloud, cluster_group &result,
-                const std::vector<triplet> &triplets, double s, double t,
-                bool tauto, double dmax, bool is_dmax, Linkage method,
-                int opt_verbose) {
+void compute_dendrogram(const PointCloud &cloud, Dendrogram &result,
+                        const std::vector<triplet> &triplets, double s,
+                        Linkage method, HcEngine engine, int opt_verbose,
+                        Stats *stats, const char *matrix_dir, int threads,
+                        int min_chunk) {
   const size_t triplet_size = triplets.size();
-  size_t k, cluster_size;
   hclust_fast_methods link;
 
-  if (!triplet_size) {
-    // if no triplets are generated
+  result.n = triplet_size;
+  result.merge.clear();
+  result.height.clear();
+  if (triplet_size < 2) {
+    // if no triplets are generated or there is nothing to merge
     return;
   }
   // choose linkage method
@@ -87,18 +169,118 @@ void compute_hc(const PointCloud &cloud, cluster_group &result,
       break;
   }
 
-  double *distance_matrix = new double[(triplet_size * (triplet_size - 1)) / 2];
-  double *cdists = new double[triplet_size - 1];
-  int *merge = new int[2 * (triplet_size - 1)], *labels = new int[triplet_size];
-  ScaleTripletMetric metric(s);
-  calculate_distance_matrix(triplets, cloud, distance_matrix, metric);
+  if (engine == ENGINE_MATRIXFREE && method != SINGLE) {
+    throw std::invalid_argument(
+        "clustering without distance matrix requires single linkage");
+  }
+  if (engine == ENGINE_GRAPH) {
+    throw std::invalid_argument("engine 'graph' yields no dendrogram");
+  }
+
+  result.merge.resize(2 * (triplet_size - 1));
+  result.height.resize(triplet_size - 1);
+  int *merge = &result.merge[0];
+  double *cdists = &result.height[0];
+  const bool is2d = (cloud.dimension() == 2);
+  if (engine == ENGINE_MATRIXFREE) {
+    size_t evaluations;
+    if (stats) stats->start("dendrogram");
+    int rc = is2d ? cluster_without_matrix<2>(triplets, s, merge, cdists,
+                                              evaluations)
+                  : cluster_without_matrix<3>(triplets, s, merge, cdists,
+                                              evaluations);
+    if (stats) stats->stop("dendrogram");
+    if (rc == 2) throw std::runtime_error("triplet distance is NaN");
+    if (stats) stats->count("distance_evaluations", evaluations);
+  } else {
+    const size_t n_distances = (triplet_size * (triplet_size - 1)) / 2;
+    DiskMatrix disk_matrix;
+    t_float *distance_matrix;
+    if (engine == ENGINE_DISK) {
+      distance_matrix = disk_matrix.create(matrix_dir, n_distances);
+      if (!distance_matrix) throw std::runtime_error(disk_matrix.get_error());
+      if (stats) {
+        stats->set_count("matrix_file_bytes", disk_matrix.size_bytes());
+      }
+    } else {
+      distance_matrix = new t_float[n_distances];
+    }
+    if (stats) stats->start("distance_matrix");
+    disk_matrix.advise_sequential();
+    if (is2d) {
+      calculate_distance_matrix(triplets, cloud, distance_matrix,
+                                ScaleTripletMetric<2>(s), threads);
+    } else {
+      calculate_distance_matrix(triplets, cloud, distance_matrix,
+                                ScaleTripletMetric<3>(s), threads);
+    }
+    disk_matrix.advise_normal();
+    if (stats) stats->stop("distance_matrix");
+
+    if (stats) stats->start("dendrogram");
+    int rc = hclust_fast(triplet_size, distance_matrix, link, merge, cdists,
+                         threads, min_chunk);
+    if (stats) stats->stop("dendrogram");
+    if (stats) stats->count("distance_evaluations", n_distances);
+    if (engine != ENGINE_DISK) delete[] distance_matrix;
+    if (rc == 2) throw std::runtime_error("triplet distance is NaN");
+  }
+  if (stats) stats->set_count("dendrogram_merges", triplet_size - 1);
+
+  if (opt_verbose > 1) {
+    // write debug file
+    const char *fname = "debug_cdist.csv";
+    std::ofstream of(fname);
+    of << std::fixed;  // set float style
+    if (of.is_open()) {
+      for (size_t i = 0; i < (triplet_size - 1); ++i) {
+        of << cdists[i] << std::endl;
+      }
+    } else {
+      std::cerr << "[Error] could not write file '" << fname << "'\n";
+    }
+    of.close();
+  }
+}
+
+//-------------------------------------------------------------------
+// Splitting of the dendrogram *dendrogram* into clusters.
+// *t* is the cut distance, or the automatic stopping criterion is
+// used when *tauto* is set. The clustering is returned in *result*.
+// *opt_verbose* is the verbosity level for debug outputs. When *stats*
+// is given, the number of clusters is recorded. When *weights* is given,
+// each triplet stands for *weights* identical triplets, which the
+// automatic stopping criterion counts as merges at distance zero.
+//-------------------------------------------------------------------
+void cut_dendrogram(const Dendrogram &dendrogram, cluster_group &result,
+                    double t, bool tauto, int opt_verbose, Stats *stats,
+                    const std::vector<size_t> *weights) {
+  const size_t triplet_size = dendrogram.n;
+  const double *cdists = dendrogram.height.empty() ? NULL
+                                                   : &dendrogram.height[0];
+  size_t k, cluster_size;
 
-  hclust_fast(triplet_size, distance_matrix, link, merge, cdists);
+  result.clear();
+  if (!triplet_size) {
+    // if no triplets are generated
+    return;
+  }
 
   // splitting the dendrogram into clusters
   if (tauto) {
+    // merges of the identical triplets come first
+    size_t n_merges = triplet_size - 1, n_zero = 0;
+    std::vector<double> heights;
+    if (weights) {
+      for (size_t i = 0; i < triplet_size; ++i) n_zero += (*weights)[i] - 1;
+      heights.assign(n_zero, 0.0);
+      heights.insert(heights.end(), dendrogram.height.begin(),
+                     dendrogram.height.end());
+      cdists = heights.empty() ? NULL : &heights[0];
+      n_merges += n_zero;
+    }
     // automatic stopping criterion where cdist is unexpected large
-    for (k = (triplet_size - 1) / 2; k < (triplet_size - 1); ++k) {
+    for (k = n_merges / 2; k < n_merges; ++k) {
       if ((cdists[k - 1] > 0.0 || cdists[k] > 1.0e-8) &&
           (cdists[k] > cdists[k - 1] + 2 * sd(cdists, k + 1))) {
         break;
@@ -107,14 +289,15 @@ void compute_hc(const PointCloud &cloud, cluster_group &result,
     if (opt_verbose) {
       double automatic_t;
       double prev_cdist = (k > 0) ? cdists[k - 1] : 0.0;
-      if (k < (triplet_size - 1)) {
+      if (k < n_merges) {
         automatic_t = (prev_cdist + cdists[k]) / 2.0;
       } else {
-        automatic_t = cdists[k - 1];
+        automatic_t = prev_cdist;
       }
       std::cout << "[Info] optimal cdist threshold: " << automatic_t
                 << std::endl;
     }
+    k = (k > n_zero) ? k - n_zero : 0;
   } else {
     // fixed threshold t
     for (k = 0; k < (triplet_size - 1); ++k) {
@@ -124,49 +307,353 @@ void compute_hc(const PointCloud &cloud, cluster_group &result,
     }
   }
   cluster_size = triplet_size - k;
-  cutree_k(triplet_size, merge, cluster_size, labels);
+  std::vector<int> labels(triplet_size);
+  cutree_k(triplet_size, dendrogram.merge.empty() ? NULL : &dendrogram.merge[0],
+           cluster_size, &labels[0]);
 
   // generate clusters
-  for (size_t i = 0; i < cluster_size; ++i) {
-    cluster_t new_cluster;
-    result.push_back(new_cluster);
-  }
-
+  result.resize(cluster_size);
   for (size_t i = 0; i < triplet_size; ++i) {
     result[labels[i]].push_back(i);
   }
+  if (stats) stats->set_count("clusters_before_pruning", cluster_size);
+}
 
-  if (opt_verbose > 1) {
-    // write debug file
-    const char *fname = "debug_cdist.csv";
-    std::ofstream of(fname);
-    of << std::fixed;  // set float style
-    if (of.is_open()) {
-      for (size_t i = 0; i < (triplet_size - 1); ++i) {
-        of << cdists[i] << std::endl;
+//-------------------------------------------------------------------
+// Test of pairs of triplets for a distance < t. Pairs whose result is
+// already known are skipped, and most other pairs are rejected without
+// computing the distance by two lower bounds: the distance is at least
+// |tan(angle)|, and at least |c|*sin(angle/2)/s, where c is the
+// difference of the centers, because one of both directions has at
+// least half the angle to c. The derived classes decide which pairs are
+// known and what is done with close pairs.
+//-------------------------------------------------------------------
+class ClosePairs {
+ private:
+  const std::vector<triplet> &triplets;
+  size_t dimension;
+  double s, t;
+  // squared cosine of the largest angle with |tan(angle)| < t
+  double min_cos2;
+  // squared center distance s*t
+  double max_dist2;
+  // directions and centers of the triplets in compact arrays with
+  // *dimension* coordinates
+  std::vector<double> directions, centers;
+  template <size_t D>
+  void test_d(size_t i, size_t j);
+
+ protected:
+  // whether the pair *i*, *j* need not be tested
+  virtual bool known(size_t i, size_t j) = 0;
+  // records that the triplets *i* < *j* are close
+  virtual void join(size_t i, size_t j) = 0;
+
+ public:
+  size_t evaluations;   // number of distance computations
+  size_t angle_pruned;  // pairs rejected by their angle
+  size_t dist_pruned;   // pairs rejected by their center distance
+  size_t skipped;       // pairs with a known result
+  ClosePairs(const std::vector<triplet> &triplets, size_t dimension,
+             double s, double t);
+  virtual ~ClosePairs() {}
+  void test(size_t i, size_t j);
+};
+
+ClosePairs::ClosePairs(const std::vector<triplet> &triplets,
+                       size_t dimension, double s, double t)
+    : triplets(triplets),
+      dimension(dimension),
+      s(s),
+      t(t),
+      evaluations(0),
+      angle_pruned(0),
+      dist_pruned(0),
+      skipped(0) {
+  // slightly smaller, so that rounding cannot reject a close pair;
+  // perpendicular triplets have the distance 1e8 regardless of the angle
+  this->min_cos2 = (t > 1.0e+8) ? 0.0 : (1.0 - 1.0e-9) / (1.0 + t * t);
+  this->max_dist2 = (t > 1.0e+8) ? std::numeric_limits<double>::infinity()
+                                 : (1.0 + 1.0e-6) * (s * t) * (s * t);
+  const size_t n = triplets.size();
+  this->directions.resize(dimension * n);
+  this->centers.resize(dimension * n);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t k = 0; k < dimension; ++k) {
+      this->directions[dimension * i + k] = triplets[i].direction[k];
+      this->centers[dimension * i + k] = triplets[i].center[k];
+    }
+  }
+}
+
+// joins the triplets *i* < *j* of a cloud of dimension *D* when their
+// distance is < t
+template <size_t D>
+void ClosePairs::test_d(size_t i, size_t j) {
+  const double *di = &this->directions[D * i];
+  const double *dj = &this->directions[D * j];
+  double anglecos = di[0] * dj[0];
+  for (size_t k = 1; k < D; ++k) anglecos += di[k] * dj[k];
+  if (anglecos * anglecos < this->min_cos2) {
+    this->angle_pruned++;
+    return;
+  }
+  // sin(angle/2)^2 = (1 - cos(angle))/2, with a margin for rounding
+  // errors of the distance at far centers
+  const double *ci = &this->centers[D * i];
+  const double *cj = &this->centers[D * j];
+  double dist2 = 0.0;
+  for (size_t k = 0; k < D; ++k) {
+    const double dk = ci[k] - cj[k];
+    dist2 += dk * dk;
+  }
+  if (dist2 * (0.5 * (1.0 - std::fabs(anglecos)) - 1.0e-12) >
+      this->max_dist2) {
+    this->dist_pruned++;
+    return;
+  }
+  this->evaluations++;
+  // rounded like the entries of the distance matrix
+  const ScaleTripletMetric<D> metric(this->s);
+  if ((t_float)metric(this->triplets[i], this->triplets[j]) < this->t) {
+    this->join(i, j);
+  }
+}
+
+// joins the triplets *i* < *j* when their distance is < t
+void ClosePairs::test(size_t i, size_t j) {
+  if (this->known(i, j)) {
+    this->skipped++;
+    return;
+  }
+  if (this->dimension == 2) {
+    this->test_d<2>(i, j);
+  } else {
+    this->test_d<3>(i, j);
+  }
+}
+
+// graph of the close pairs, whose connected components are tracked with
+// union-find; the root of a component is its smallest triplet index
+class ThresholdGraph : public ClosePairs {
+ protected:
+  bool known(size_t i, size_t j) {
+    return find_root(this->parent, i) == find_root(this->parent, j);
+  }
+  void join(size_t i, size_t j) {
+    size_t root_i = find_root(this->parent, i);
+    size_t root_j = find_root(this->parent, j);
+    this->parent[std::max(root_i, root_j)] = std::min(root_i, root_j);
+  }
+
+ public:
+  std::vector<size_t> parent;
+  ThresholdGraph(const std::vector<triplet> &triplets, size_t dimension,
+                 double s, double t)
+      : ClosePairs(triplets, dimension, s, t), parent(triplets.size()) {
+    for (size_t i = 0; i < this->parent.size(); ++i) this->parent[i] = i;
+  }
+};
+
+// triplets with at least one close triplet
+class IsolationTest : public ClosePairs {
+ protected:
+  bool known(size_t i, size_t j) {
+    return this->has_neighbour[i] && this->has_neighbour[j];
+  }
+  void join(size_t i, size_t j) {
+    this->has_neighbour[i] = this->has_neighbour[j] = true;
+  }
+
+ public:
+  std::vector<bool> has_neighbour;
+  IsolationTest(const std::vector<triplet> &triplets, size_t dimension,
+                double s, double t)
+      : ClosePairs(triplets, dimension, s, t),
+        has_neighbour(triplets.size(), false) {}
+};
+
+//-------------------------------------------------------------------
+// Tests all pairs of *triplets* of *cloud* for a distance < t (with the
+// distance scale *s*) with *pairs*. The pairs with centers closer than
+// s*t are tested first with a spatial index of type *index*, because
+// they are most likely close. All other pairs must still be tested,
+// because nearly collinear triplets are close at any distance of their
+// centers, but only the pairs of direction bins with an angle < atan(t)
+// are enumerated, and for bins with the angle phi > 0 only the pairs
+// whose centers are within s*t/sin(phi/2) along the sweep axis. When
+// *stats* is given, the distance computations and the skipped and
+// rejected pairs are counted.
+//-------------------------------------------------------------------
+static void test_pairs(const PointCloud &cloud,
+                       const std::vector<triplet> &triplets, double s,
+                       double t, IndexType index, ClosePairs &pairs,
+                       Stats *stats) {
+  const size_t triplet_size = triplets.size();
+
+  // pairs with close centers
+  const double r = s * t;
+  if (triplet_size > 1 && r > 0.0) {
+    const size_t dimension = cloud.dimension();
+    Kdtree::KdNodeVector nodes;
+    for (size_t i = 0; i < triplet_size; ++i) {
+      nodes.push_back(Kdtree::KdNode(triplets[i].center.as_vector(dimension),
+                                     NULL, (int)i));
+    }
+    SpatialIndex *spatial_index =
+        build_spatial_index(&nodes, index, 0, r);
+    Kdtree::KdNodeVector neighbours;
+    for (size_t i = 0; i < triplet_size; ++i) {
+      spatial_index->range_nearest_neighbors(nodes[i].point, r, &neighbours);
+      for (size_t k = 0; k < neighbours.size(); ++k) {
+        size_t j = (size_t)neighbours[k].index;
+        if (j > i) pairs.test(i, j);
       }
-    } else {
-      std::cerr << "[Error] could not write file '" << fname << "'\n";
     }
-    of.close();
+    delete spatial_index;
+  }
+
+  // all other pairs of the bins with compatible directions; for large
+  // t, the perpendicular triplets with distance 1e8 are close, too
+  const double infinity = std::numeric_limits<double>::infinity();
+  const double max_angle = (t > 1.0e+8) ? infinity : std::atan(t);
+  DirectionBins bins(triplets, direction_bin_resolution(max_angle,
+                                                        triplet_size));
+  size_t bin_pruned = 0, window_pruned = 0;
+  for (size_t a = 0; a < bins.size(); ++a) {
+    const DirectionBin &bin_a = bins[a];
+    for (size_t b = a; b < bins.size(); ++b) {
+      const DirectionBin &bin_b = bins[b];
+      const double phi = bins.min_angle(a, b);
+      if (phi >= max_angle) {
+        bin_pruned += bin_a.members.size() * bin_b.members.size();
+        continue;
+      }
+      double r = infinity;
+      if (phi > 0.0 && t <= 1.0e+8) {
+        r = (1.0 + 1.0e-6) * s * t / std::sin(0.5 * phi);
+      }
+      for (size_t p = 0; p < bin_a.members.size(); ++p) {
+        const double key = bin_a.keys[p];
+        size_t q_begin, q_end, n_pairs;
+        if (a == b) {
+          q_begin = p + 1;
+          q_end = bin_b.members.size();
+          n_pairs = q_end - q_begin;
+        } else {
+          q_begin = std::lower_bound(bin_b.keys.begin(), bin_b.keys.end(),
+                                     key - r) - bin_b.keys.begin();
+          q_end = std::upper_bound(bin_b.keys.begin(), bin_b.keys.end(),
+                                   key + r) - bin_b.keys.begin();
+          n_pairs = bin_b.members.size();
+        }
+        window_pruned += n_pairs - (q_end - q_begin);
+        for (size_t q = q_begin; q < q_end; ++q) {
+          const size_t i = bin_a.members[p], j = bin_b.members[q];
+          pairs.test(std::min(i, j), std::max(i, j));
+        }
+      }
+    }
+  }
+
+  if (stats) {
+    stats->count("distance_evaluations", pairs.evaluations);
+    stats->count("angle_pruned_pairs", pairs.angle_pruned);
+    stats->count("distance_pruned_pairs", pairs.dist_pruned);
+    stats->count("connected_pairs_skipped", pairs.skipped);
+    stats->set_count("direction_bins", bins.size());
+    stats->count("direction_bin_pruned_pairs", bin_pruned);
+    stats->count("center_window_pruned_pairs", window_pruned);
+  }
+}
+
+//-------------------------------------------------------------------
+// Single linkage clustering of *triplets* at the fixed distance *t*
+// without dendrogram. The clusters are the connected components of the
+// graph with edges between the triplets with a distance < t (with the
+// distance scale *s*), which are found by test_pairs with the spatial
+// index of type *index*; pairs in the same component are skipped. The
+// clusters are numbered like by cut_dendrogram and returned in *result*.
+// When *stats* is given, the pairs are counted as in test_pairs.
+//-------------------------------------------------------------------
+void threshold_components(const PointCloud &cloud, cluster_group &result,
+                          const std::vector<triplet> &triplets, double s,
+                          double t, IndexType index, Stats *stats) {
+  const size_t triplet_size = triplets.size();
+  result.clear();
+  if (!triplet_size) {
+    // if no triplets are generated
+    return;
   }
+  ThresholdGraph graph(triplets, cloud.dimension(), s, t);
+  test_pairs(cloud, triplets, s, t, index, graph, stats);
 
-  // cleanup
-  delete[] distance_matrix;
-  delete[] cdists;
-  delete[] merge;
-  delete[] labels;
+  // clusters in the order of their smallest triplet like in cutree_k
+  std::vector<size_t> labels(triplet_size);
+  for (size_t i = 0; i < triplet_size; ++i) {
+    size_t root = find_root(graph.parent, i);
+    if (root == i) {
+      labels[i] = result.size();
+      result.push_back(cluster_t());
+    }
+    result[labels[root]].push_back(i);
+  }
+}
+
+//-------------------------------------------------------------------
+// Marks the triplets without any other triplet at a distance < *t*
+// (with the distance scale *s*) in *isolated*. These are singletons in
+// every clustering cut at a distance <= t, because the linkage distance
+// of a cluster with an isolated triplet is at least its distance to the
+// nearest triplet. The pairs are tested by test_pairs with the spatial
+// index of type *index*; pairs of triplets that both have a neighbour
+// are skipped.
+//-------------------------------------------------------------------
+void find_isolated_triplets(const PointCloud &cloud,
+                            const std::vector<triplet> &triplets, double s,
+                            double t, std::vector<bool> &isolated,
+                            IndexType index) {
+  IsolationTest test(triplets, cloud.dimension(), s, t);
+  test_pairs(cloud, triplets, s, t, index, test, NULL);
+  isolated.resize(triplets.size());
+  for (size_t i = 0; i < triplets.size(); ++i) {
+    isolated[i] = !test.has_neighbour[i];
+  }
+}
+
+//-------------------------------------------------------------------
+// Computation of the clustering.
+// The triplets in *triplets* are clustered by the fastcluster algorithm
+// and the dendrogram is cut at the distance *t* (or automatically when
+// *tauto* is set). See compute_dendrogram and cut_dendrogram for the
+// other parameters. The clustering is returned in *result*.
+//-------------------------------------------------------------------
+void compute_hc(const PointCloud &cloud, cluster_group &result,
+                const std::vector<triplet> &triplets, double s, double t,
+                bool tauto, double dmax, bool is_dmax, Linkage method,
+                HcEngine engine, int opt_verbose, Stats *stats) {
+  Dendrogram dendrogram;
+  compute_dendrogram(cloud, dendrogram, triplets, s, method, engine,
+                     opt_verbose, stats);
+  cut_dendrogram(dendrogram, result, t, tauto, opt_verbose, stats);
 }
 
 //-------------------------------------------------------------------
 // Remove all clusters in *cl_group* which contains less then *m*
-// triplets. *cl_group* will be modified.
+// triplets. *cl_group* will be modified. When *weights* is given, each
+// triplet counts *weights* times.
 //-------------------------------------------------------------------
-void cleanup_cluster_group(cluster_group &cl_group, size_t m, int opt_verbose) {
+void cleanup_cluster_group(cluster_group &cl_group, size_t m, int opt_verbose,
+                           const std::vector<size_t> *weights) {
   size_t old_size = cl_group.size();
   cluster_group::iterator it = cl_group.begin();
   while (it != cl_group.end()) {
-    if (it->size() < m) {
+    size_t size = it->size();
+    if (weights) {
+      size = 0;
+      for (size_t i = 0; i < it->size(); ++i) size += (*weights)[(*it)[i]];
+    }
+    if (size < m) {
       it = cl_group.erase(it);
     } else {
       ++it;
@@ -14,20 +14,56 @@
 #include <cstddef>
 #include <vector>
 
+#include "hclust/fastcluster.h"
 #include "triplet.h"
 #include "util.h"
 
+class Stats;
+
 typedef std::vector<size_t> cluster_t;
 
 typedef std::vector<cluster_t> cluster_group;
 
-// compute hierarchical clustering
+// dendrogram of the triplet clustering in the format of fastcluster
+struct Dendrogram {
+  size_t n;                    // number of triplets
+  std::vector<int> merge;      // merge steps (2*(n-1) entries)
+  std::vector<double> height;  // cluster distance of each merge step
+};
+
+// estimate memory in bytes needed by compute_hc
+double estimate_hc_memory(size_t n_triplets, Linkage method, HcEngine engine);
+// compute the dendrogram of the hierarchical clustering
+void compute_dendrogram(const PointCloud &cloud, Dendrogram &result,
+                        const std::vector<triplet> &triplets, double s,
+                        Linkage method = SINGLE,
+                        HcEngine engine = ENGINE_MATRIX, int opt_verbose = 0,
+                        Stats *stats = NULL, const char *matrix_dir = NULL,
+                        int threads = 1, int min_chunk = HCLUST_MIN_CHUNK);
+// split the dendrogram into clusters at distance *t*
+void cut_dendrogram(const Dendrogram &dendrogram, cluster_group &result,
+                    double t, bool tauto = false, int opt_verbose = 0,
+                    Stats *stats = NULL,
+                    const std::vector<size_t> *weights = NULL);
+// single linkage clusters at the fixed distance *t* without dendrogram
+void threshold_components(const PointCloud &cloud, cluster_group &result,
+                          const std::vector<triplet> &triplets, double s,
+                          double t, IndexType index = INDEX_KDTREE,
+                          Stats *stats = NULL);
+// marks the triplets without other triplet at a distance < *t*
+void find_isolated_triplets(const PointCloud &cloud,
+                            const std::vector<triplet> &triplets, double s,
+                            double t, std::vector<bool> &isolated,
+                            IndexType index = INDEX_KDTREE);
+// compute hierarchical clustering (dendrogram and cut)
 void compute_hc(const PointCloud &cloud, cluster_group &result,
                 const std::vector<triplet> &triplets, double s, double t,
                 bool tauto = false, double dmax = 0, bool is_dmax = false,
-                Linkage method = SINGLE, int opt_verbose = 0);
-// remove all small clusters
-void cleanup_cluster_group(cluster_group &cg, size_t m, int opt_verbose = 0);
+                Linkage method = SINGLE, HcEngine engine = ENGINE_MATRIX,
+                int opt_verbose = 0, Stats *stats = NULL);
+// remove all small clusters (*weights* are the triplet multiplicities)
+void cleanup_cluster_group(cluster_group &cg, size_t m, int opt_verbose = 0,
+                           const std::vector<size_t> *weights = NULL);
 // convert the triplet indices ind *cl_group* to point indices.
 void cluster_triplets_to_points(const std::vector<triplet> &triplets,
                                 cluster_group &cl_group);
@@ -0,0 +1,122 @@
+//
+// collapse.cpp
+//     Collapsing of the points of a cloud into weighted representatives
+//     and propagation of the cluster labels back to the points.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <map>
+
+#include "collapse.h"
+#include "gridindex.h"
+
+//-------------------------------------------------------------------
+// Voxel downsampling of *cloud*: all points in the same cube with edge
+// length *voxelsize* are replaced by their centroid. The representatives
+// are in the order of their first point, whose index they keep, so that
+// an ordered cloud stays ordered. The number of points and the point
+// indices of each voxel are stored in *result* as well.
+//-------------------------------------------------------------------
+void voxel_downsample(const PointCloud &cloud, double voxelsize,
+                      CollapsedCloud &result) {
+  std::map<GridCell, size_t> voxels;
+  result.cloud.clear();
+  result.weights.clear();
+  result.members.clear();
+
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    const Point &p = cloud[i];
+    GridCell cell;
+    cell.x = grid_coordinate(p.x, voxelsize);
+    cell.y = grid_coordinate(p.y, voxelsize);
+    cell.z = grid_coordinate(p.z, voxelsize);
+    std::map<GridCell, size_t>::iterator it = voxels.find(cell);
+    if (it == voxels.end()) {
+      it = voxels.insert(std::make_pair(cell, result.members.size())).first;
+      result.members.push_back(cluster_t());
+    }
+    result.members[it->second].push_back(i);
+  }
+
+  // centroids of the voxels
+  result.cloud.reserve(result.members.size());
+  result.weights.reserve(result.members.size());
+  for (size_t v = 0; v < result.members.size(); ++v) {
+    const cluster_t &members = result.members[v];
+    double x = 0.0, y = 0.0, z = 0.0;
+    for (size_t j = 0; j < members.size(); ++j) {
+      x += cloud[members[j]].x;
+      y += cloud[members[j]].y;
+      z += cloud[members[j]].z;
+    }
+    size_t n = members.size();
+    result.cloud.push_back(Point(x / n, y / n, z / n,
+                                 cloud[members[0]].index));
+    result.weights.push_back(n);
+  }
+  result.cloud.set2d(cloud.is2d());
+  result.cloud.setOrdered(cloud.isOrdered());
+}
+
+// exact coordinates of a point as key for finding duplicates
+struct Coordinates {
+  coord_t x, y, z;
+  Coordinates(const Point &p) : x(p.x), y(p.y), z(p.z) {}
+  friend bool operator<(const Coordinates &c1, const Coordinates &c2) {
+    if (c1.x != c2.x) return c1.x < c2.x;
+    if (c1.y != c2.y) return c1.y < c2.y;
+    return c1.z < c2.z;
+  }
+};
+
+//-------------------------------------------------------------------
+// Collapsing of duplicates: all points of *cloud* with identical
+// coordinates are replaced by the first of them, which keeps its index.
+// The representatives are in the order of their first point, and their
+// weight is the number of their points.
+//-------------------------------------------------------------------
+void collapse_duplicates(const PointCloud &cloud, CollapsedCloud &result) {
+  std::map<Coordinates, size_t> unique;
+  result.cloud.clear();
+  result.weights.clear();
+  result.members.clear();
+
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    std::pair<std::map<Coordinates, size_t>::iterator, bool> it =
+        unique.insert(std::make_pair(Coordinates(cloud[i]),
+                                     result.members.size()));
+    if (it.second) {
+      result.cloud.push_back(
+          Point(cloud[i].x, cloud[i].y, cloud[i].z, cloud[i].index));
+      result.weights.push_back(0);
+      result.members.push_back(cluster_t());
+    }
+    size_t u = it.first->second;
+    result.weights[u]++;
+    result.members[u].push_back(i);
+  }
+  result.cloud.set2d(cloud.is2d());
+  result.cloud.setOrdered(cloud.isOrdered());
+}
+
+//-------------------------------------------------------------------
+// Label propagation: the clusters in *cl_group* contain indices of
+// representatives, which are replaced by the indices of all points in
+// their group *members*. The point indices of each cluster are sorted.
+//-------------------------------------------------------------------
+void expand_clusters(const std::vector<cluster_t> &members,
+                     cluster_group &cl_group) {
+  for (size_t i = 0; i < cl_group.size(); ++i) {
+    cluster_t point_indices;
+    for (size_t j = 0; j < cl_group[i].size(); ++j) {
+      const cluster_t &group = members[cl_group[i][j]];
+      point_indices.insert(point_indices.end(), group.begin(), group.end());
+    }
+    std::sort(point_indices.begin(), point_indices.end());
+    cl_group[i] = point_indices;
+  }
+}
@@ -0,0 +1,40 @@
+//
+// collapse.h
+//     Collapsing of the points of a cloud into weighted representatives
+//     and propagation of the cluster labels back to the points.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef COLLAPSE_H
+#define COLLAPSE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "cluster.h"
+#include "pointcloud.h"
+
+// representatives of groups of points of a cloud
+struct CollapsedCloud {
+  PointCloud cloud;                // one representative per group
+  std::vector<size_t> weights;     // number of points of each group
+  std::vector<cluster_t> members;  // point indices of each group
+};
+
+// collapses the points of *cloud* in the same cube with edge length
+// *voxelsize* into their centroid
+void voxel_downsample(const PointCloud &cloud, double voxelsize,
+                      CollapsedCloud &result);
+
+// collapses identical points of *cloud* into one point
+void collapse_duplicates(const PointCloud &cloud, CollapsedCloud &result);
+
+// replaces the representatives in the clusters of *cl_group* with the
+// points of their groups *members*
+void expand_clusters(const std::vector<cluster_t> &members,
+                     cluster_group &cl_group);
+
+#endif
@@ -0,0 +1,451 @@
+//
+// compare.cpp
+//     Runs TriplClust with two different configurations on the same
+//     input file and compares the resulting point labels. This is meant
+//     for checking that an optimized engine or option yields the same
+//     clustering as the reference configuration.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cluster.h"
+#include "option.h"
+#include "outofcore.h"
+#include "pipeline.h"
+#include "pointcloud.h"
+#include "spatialindex.h"
+#include "stats.h"
+#include "stream.h"
+#include "util.h"
+
+// usage message
+const char *usage =
+    "Usage:\n"
+    "\ttriplclust-compare [options] <infile>\n"
+    "Runs triplclust on <infile> with two configurations A and B and\n"
+    "compares the resulting point labels up to a permutation of the\n"
+    "cluster ids. Points belonging to several clusters are labeled with\n"
+    "the set of their cluster ids, noise points have their own label.\n"
+    "Options (defaults in brackets):\n"
+    "\t-a <options>   triplclust options for configuration A ['']\n"
+    "\t-b <options>   triplclust options for configuration B ['']\n"
+    "\t               (must be quoted, e.g. -b \"-engine matrixfree\";\n"
+    "\t               with -window or -outofcore, the labels are read\n"
+    "\t               from the csv output of the streaming or out-of-core\n"
+    "\t               mode, so -oprefix and -v are not allowed)\n"
+    "\t               (with \"recut <dendrogram file> <options>\", the\n"
+    "\t               dendrogram saved with -savedendro is cut instead)\n"
+    "\t-select <name> compare the result with the parameters <name>\n"
+    "\t               (e.g. 't=5' or 'k=12,a=0.05') of a configuration\n"
+    "\t               with several values for -k, -n, -a or -t [first]\n"
+    "\t-knn <k>       compare the squared distances of the k nearest\n"
+    "\t               neighbours of each point, searched with the -index\n"
+    "\t               and -knn-eps of A and B, instead of the labels\n"
+    "\t-maxdiff <n>   number of differing points that is tolerated [0]\n"
+    "\t-minari <x>    minimum adjusted Rand index that is tolerated [1]\n"
+    "\t-v             list the differing points\n"
+    "Exit code:\n"
+    "\t0 when the labels agree within the tolerances, 5 when not,\n"
+    "\tother values for errors as in triplclust\n"
+    "Version:\n"
+    "\t" TRIPLCLUST_VERSION;
+
+// the label of a point is the set of its cluster ids (empty for noise)
+typedef std::set<size_t> Label;
+
+//-------------------------------------------------------------------
+// Parses the option string *params* and the *infile_name* into *opt*.
+// The tokens are stored in *tokens*, which must live as long as *opt*,
+// because *opt* keeps pointers to string arguments. When *params*
+// starts with "recut", *recut* is set, and the dendrogram file that
+// follows is the infile of *opt* like in triplclust's recut mode.
+//-------------------------------------------------------------------
+int parse_params(const std::string &params, const char *infile_name,
+                 Opt &opt, std::vector<std::string> &tokens, bool &recut) {
+  std::istringstream iss(params);
+  std::string token;
+  tokens.clear();
+  while (iss >> token) tokens.push_back(token);
+  recut = (!tokens.empty() && tokens[0] == "recut");
+  if (recut)
+    tokens.erase(tokens.begin());
+  else
+    tokens.push_back(infile_name);
+  std::vector<char *> argv;
+  argv.push_back((char *)"triplclust");
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    argv.push_back((char *)tokens[i].c_str());
+  }
+  argv.push_back(NULL);
+  return opt.parse_args((int)tokens.size() + 1, &argv[0]);
+}
+
+//-------------------------------------------------------------------
+// Runs the streaming (-window) or out-of-core (-outofcore) mode with the
+// options *opt*, which write the points with their labels as csv to
+// stdout instead of returning clusters. The csv output is captured and
+// the label of each point is stored in *labels*. Returns the exit code
+// of triplclust (0 = success).
+//-------------------------------------------------------------------
+int run_csv_config(Opt &opt, std::vector<Label> &labels, size_t &n_clusters) {
+  if (opt.get_ofprefix() || opt.get_verbosity() > 0) {
+    std::cerr << "[Error] -oprefix and -v cannot be used with -window or "
+              << "-outofcore" << std::endl;
+    return 1;
+  }
+  if (opt.get_window() > 0 && !opt.get_ordered()) {
+    std::cerr << "[Error] -window requires -ordered" << std::endl;
+    return 1;
+  }
+  if (opt.get_outofcoredir() && opt.get_tile() <= 0) {
+    std::cerr << "[Error] -outofcore requires -tile" << std::endl;
+    return 1;
+  }
+
+  // redirect cout to a string
+  std::ostringstream csv;
+  std::streambuf *backup = std::cout.rdbuf(csv.rdbuf());
+  std::ios::fmtflags flags = std::cout.flags();
+  Stats stats;
+  int rc = (opt.get_window() > 0) ? run_stream(opt, stats)
+                                  : run_outofcore(opt, stats);
+  std::cout.flags(flags);
+  std::cout.rdbuf(backup);
+  if (rc != 0) return rc;
+
+  // the label is the last column, with ids separated by ';'
+  std::istringstream lines(csv.str());
+  std::string line;
+  std::set<size_t> ids;
+  labels.clear();
+  while (std::getline(lines, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::string column = line.substr(line.rfind(',') + 1);
+    Label label;
+    if (column != "-1") {
+      std::istringstream iss(column);
+      std::string id;
+      while (std::getline(iss, id, ';')) {
+        label.insert((size_t)atol(id.c_str()));
+      }
+    }
+    ids.insert(label.begin(), label.end());
+    labels.push_back(label);
+  }
+  n_clusters = ids.size();
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Loads *infile_name* with the options *opt* into *cloud*. Returns the
+// exit code of triplclust (0 = success).
+//-------------------------------------------------------------------
+int load_cloud(const char *infile_name, Opt &opt, PointCloud &cloud) {
+  cloud.setOrdered(opt.get_ordered());
+  try {
+    load_csv_file(infile_name, cloud, opt.get_delimiter(), opt.get_skip());
+  } catch (const std::exception &e) {
+    std::cerr << "[Error] cannot read infile '" << infile_name << "'! "
+              << e.what() << std::endl;
+    return 2;
+  }
+  if (cloud.empty()) {
+    std::cerr << "[Error] empty cloud in file '" << infile_name << "'"
+              << std::endl;
+    return 2;
+  }
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Searches the *k* nearest neighbours of each point of *infile_name*
+// with the spatial index of the options *opt* like the triplet
+// generation, and stores their squared distances in *distances*.
+// Returns the exit code of triplclust (0 = success).
+//-------------------------------------------------------------------
+int knn_distances(const char *infile_name, Opt &opt, size_t k,
+                  std::vector<std::vector<double> > &distances) {
+  PointCloud cloud;
+  int rc = load_cloud(infile_name, opt, cloud);
+  if (rc != 0) return rc;
+  Kdtree::KdNodeVector nodes;
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    nodes.push_back(Kdtree::KdNode(cloud[i].as_vector(cloud.dimension())));
+  }
+  // approximate searches are only supported by the kd-tree
+  IndexType type = (opt.get_knn_eps() > 0.0) ? INDEX_KDTREE : opt.get_index();
+  SpatialIndex *index = build_spatial_index(&nodes, type, k, 0.0);
+  if (index->get_kdtree()) index->get_kdtree()->set_epsilon(opt.get_knn_eps());
+  Kdtree::KdNodeVector result;
+  distances.resize(cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    index->k_nearest_neighbors(nodes[i].point, k, &result, &distances[i]);
+  }
+  delete index;
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Loads *infile_name* and runs the algorithm with the options *opt*.
+// The label of each point is stored in *labels*; with several results,
+// the labels are taken from the result named *select* (or the first
+// one when *select* is empty). Returns the exit code of triplclust
+// (0 = success). With *recut*, the cloud and the dendrogram are loaded
+// from the infile of *opt* instead.
+//-------------------------------------------------------------------
+int run_config(const char *infile_name, Opt &opt, bool recut,
+               const std::string &select, std::vector<Label> &labels,
+               size_t &n_clusters) {
+  if (opt.get_window() > 0 || opt.get_outofcoredir()) {
+    return run_csv_config(opt, labels, n_clusters);
+  }
+  PointCloud cloud;
+  std::vector<PipelineResult> results;
+  Stats stats;
+  int rc;
+  if (recut) {
+    rc = run_recut(opt.get_ifname(), cloud, opt, results, stats);
+  } else {
+    rc = load_cloud(infile_name, opt, cloud);
+    if (rc != 0) return rc;
+    rc = run_pipeline(cloud, opt, results, stats);
+  }
+  if (rc != 0) return rc;
+  if (results.empty()) {
+    std::cerr << "[Error] no clustering computed (option -dry-run?)"
+              << std::endl;
+    return 1;
+  }
+  size_t selected = 0;
+  if (results.size() > 1 && !select.empty()) {
+    while (selected < results.size() && results[selected].name != select)
+      ++selected;
+    if (selected == results.size()) {
+      std::cerr << "[Error] no result with the parameters '" << select
+                << "'" << std::endl;
+      return 1;
+    }
+  }
+  cluster_group &cl_group = results[selected].clusters;
+  add_clusters(cloud, cl_group, false);
+  n_clusters = cl_group.size();
+  labels.resize(cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    labels[i] = cloud[i].cluster_ids;
+  }
+  return 0;
+}
+
+// prints a label in the same format as the csv output
+std::string label_to_string(const Label &label) {
+  if (label.empty()) return "-1";
+  std::ostringstream oss;
+  for (Label::const_iterator it = label.begin(); it != label.end(); ++it) {
+    if (it != label.begin()) oss << ";";
+    oss << *it;
+  }
+  return oss.str();
+}
+
+// number of pairs among *n* elements
+double pairs(double n) { return n * (n - 1) / 2; }
+
+// sorts contingency table entries by decreasing overlap
+struct OverlapGreater {
+  bool operator()(const std::pair<std::pair<size_t, size_t>, size_t> &a,
+                  const std::pair<std::pair<size_t, size_t>, size_t> &b) const {
+    if (a.second != b.second) return a.second > b.second;
+    return a.first < b.first;
+  }
+};
+
+//-------------------------------------------------------------------
+// Compares the labels *la* and *lb*. Returns the adjusted Rand index
+// and stores the indices of points whose labels differ under the best
+// (greedy) one-to-one matching of the labels in *differing*.
+//-------------------------------------------------------------------
+double compare_labels(const std::vector<Label> &la, const std::vector<Label> &lb,
+                      std::vector<size_t> &differing) {
+  // map each distinct label to a class number
+  std::map<Label, size_t> classes_a, classes_b;
+  std::vector<size_t> ca(la.size()), cb(lb.size());
+  for (size_t i = 0; i < la.size(); ++i) {
+    std::map<Label, size_t>::iterator it = classes_a.find(la[i]);
+    if (it == classes_a.end())
+      it = classes_a.insert(std::make_pair(la[i], classes_a.size())).first;
+    ca[i] = it->second;
+    it = classes_b.find(lb[i]);
+    if (it == classes_b.end())
+      it = classes_b.insert(std::make_pair(lb[i], classes_b.size())).first;
+    cb[i] = it->second;
+  }
+
+  // contingency table and its marginals
+  std::map<std::pair<size_t, size_t>, size_t> table;
+  std::vector<size_t> sum_a(classes_a.size(), 0), sum_b(classes_b.size(), 0);
+  for (size_t i = 0; i < ca.size(); ++i) {
+    table[std::make_pair(ca[i], cb[i])]++;
+    sum_a[ca[i]]++;
+    sum_b[cb[i]]++;
+  }
+
+  // adjusted Rand index
+  double index = 0, pairs_a = 0, pairs_b = 0;
+  std::map<std::pair<size_t, size_t>, size_t>::const_iterator t;
+  for (t = table.begin(); t != table.end(); ++t) index += pairs(t->second);
+  for (size_t i = 0; i < sum_a.size(); ++i) pairs_a += pairs(sum_a[i]);
+  for (size_t j = 0; j < sum_b.size(); ++j) pairs_b += pairs(sum_b[j]);
+  // with less than two points, there are no pairs to disagree on
+  double ari = 1.0;
+  if (ca.size() > 1) {
+    double expected = pairs_a * pairs_b / pairs(ca.size());
+    double maximum = (pairs_a + pairs_b) / 2;
+    if (maximum != expected) ari = (index - expected) / (maximum - expected);
+  }
+
+  // one-to-one matching of the classes by decreasing overlap;
+  // noise can only be matched with noise
+  size_t noise_a = classes_a.count(Label()) ? classes_a[Label()] : ca.size();
+  size_t noise_b = classes_b.count(Label()) ? classes_b[Label()] : cb.size();
+  std::vector<std::pair<std::pair<size_t, size_t>, size_t> > overlaps(
+      table.begin(), table.end());
+  std::sort(overlaps.begin(), overlaps.end(), OverlapGreater());
+  std::vector<bool> used_b(classes_b.size(), false);
+  std::vector<size_t> match(classes_a.size(), cb.size());
+  for (size_t i = 0; i < overlaps.size(); ++i) {
+    size_t a = overlaps[i].first.first, b = overlaps[i].first.second;
+    if (match[a] != cb.size() || used_b[b]) continue;
+    if ((a == noise_a) != (b == noise_b)) continue;
+    match[a] = b;
+    used_b[b] = true;
+  }
+
+  differing.clear();
+  for (size_t i = 0; i < ca.size(); ++i) {
+    if (match[ca[i]] != cb[i]) differing.push_back(i);
+  }
+  return ari;
+}
+
+int main(int argc, char **argv) {
+  std::string params_a, params_b, select;
+  const char *infile_name = NULL;
+  size_t maxdiff = 0, knn = 0;
+  double minari = 1.0;
+  bool verbose = false;
+
+  // parse command line
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (0 == strcmp(argv[i], "-a") && i + 1 < argc) {
+        params_a = argv[++i];
+      } else if (0 == strcmp(argv[i], "-b") && i + 1 < argc) {
+        params_b = argv[++i];
+      } else if (0 == strcmp(argv[i], "-knn") && i + 1 < argc) {
+        knn = (size_t)stod(argv[++i]);
+      } else if (0 == strcmp(argv[i], "-select") && i + 1 < argc) {
+        select = argv[++i];
+      } else if (0 == strcmp(argv[i], "-maxdiff") && i + 1 < argc) {
+        maxdiff = (size_t)stod(argv[++i]);
+      } else if (0 == strcmp(argv[i], "-minari") && i + 1 < argc) {
+        minari = stod(argv[++i]);
+      } else if (0 == strcmp(argv[i], "-v")) {
+        verbose = true;
+      } else if (argv[i][0] == '-' || infile_name) {
+        std::cerr << usage << std::endl;
+        return 1;
+      } else {
+        infile_name = argv[i];
+      }
+    }
+  } catch (const std::invalid_argument &e) {
+    std::cerr << "[Error] " << e.what() << std::endl << usage << std::endl;
+    return 1;
+  }
+  if (!infile_name) {
+    std::cerr << "[Error] no infile given!\n" << usage << std::endl;
+    return 1;
+  }
+
+  Opt opt_a, opt_b;
+  std::vector<std::string> tokens_a, tokens_b;
+  bool recut_a, recut_b;
+  if (parse_params(params_a, infile_name, opt_a, tokens_a, recut_a) != 0) {
+    std::cerr << "[Error] invalid options for configuration A" << std::endl;
+    return 1;
+  }
+  if (parse_params(params_b, infile_name, opt_b, tokens_b, recut_b) != 0) {
+    std::cerr << "[Error] invalid options for configuration B" << std::endl;
+    return 1;
+  }
+
+  if (knn > 0) {
+    std::vector<std::vector<double> > distances_a, distances_b;
+    int rc = knn_distances(infile_name, opt_a, knn, distances_a);
+    if (rc != 0) return rc;
+    rc = knn_distances(infile_name, opt_b, knn, distances_b);
+    if (rc != 0) return rc;
+    std::vector<size_t> differing;
+    for (size_t i = 0; i < distances_a.size(); ++i) {
+      if (distances_a[i] != distances_b[i]) differing.push_back(i);
+    }
+    std::cout << "points: " << distances_a.size() << std::endl
+              << "points with differing neighbour distances: "
+              << differing.size() << std::endl;
+    if (verbose) {
+      for (size_t i = 0; i < differing.size(); ++i) {
+        std::cout << "  point " << differing[i] << std::endl;
+      }
+    }
+    return (differing.size() > maxdiff) ? 5 : 0;
+  }
+
+  std::vector<Label> labels_a, labels_b;
+  size_t n_clusters_a = 0, n_clusters_b = 0;
+  int rc = run_config(infile_name, opt_a, recut_a, select, labels_a,
+                      n_clusters_a);
+  if (rc != 0) return rc;
+  rc = run_config(infile_name, opt_b, recut_b, select, labels_b,
+                  n_clusters_b);
+  if (rc != 0) return rc;
+  if (labels_a.size() != labels_b.size()) {
+    std::cerr << "[Error] configurations read different numbers of points"
+              << std::endl;
+    return 2;
+  }
+
+  std::vector<size_t> differing;
+  double ari = compare_labels(labels_a, labels_b, differing);
+
+  std::cout << "points: " << labels_a.size() << std::endl
+            << "clusters: " << n_clusters_a << " (A), " << n_clusters_b
+            << " (B)" << std::endl
+            << "adjusted Rand index: " << ari << std::endl
+            << "differing points: " << differing.size() << std::endl;
+  if (verbose) {
+    for (size_t i = 0; i < differing.size(); ++i) {
+      size_t p = differing[i];
+      std::cout << "  point " << p << ": " << label_to_string(labels_a[p])
+                << " (A), " << label_to_string(labels_b[p]) << " (B)"
+                << std::endl;
+    }
+  }
+
+  if (differing.size() > maxdiff || ari < minari) {
+    return 5;
+  }
+  return 0;
+}
@@ -0,0 +1,165 @@
+//
+// dendrofile.cpp
+//     Functions for saving and loading the dendrogram of the triplet
+//     clustering, so that it can be cut again without recomputation.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <stdint.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "dendrofile.h"
+
+// The file consists of the following blocks in native byte order:
+//   header:    magic "TCDENDRO", uint32 version, uint32 flags
+//              (bit 0: 2D cloud, bit 1: ordered cloud), uint64 number
+//              of points, uint64 number of triplets, double dnn
+//   points:    x, y, z as double for each point
+//   triplets:  point indices a, b, c as uint64 for each triplet
+//   merge:     2*(triplets-1) int32 in the format of fastcluster
+//   height:    (triplets-1) double
+const char dendro_magic[8] = {'T', 'C', 'D', 'E', 'N', 'D', 'R', 'O'};
+const uint32_t dendro_version = 1;
+
+// writes *n* values of type T from *values* to *of*
+template <typename T>
+void write_values(std::ofstream &of, const T *values, size_t n) {
+  if (n) of.write((const char *)values, n * sizeof(T));
+}
+
+// reads *n* values of type T from *in* into *values*
+template <typename T>
+void read_values(std::ifstream &in, T *values, size_t n) {
+  if (n) in.read((char *)values, n * sizeof(T));
+  if (!in) throw std::invalid_argument("unexpected end of file");
+}
+
+//-------------------------------------------------------------------
+// Saves the cloud *cloud*, the point indices of the *triplets*, the
+// *dendrogram* of their clustering and the characteristic length
+// *dnn* to the binary file *fname*. Returns false if the file cannot
+// be written.
+//-------------------------------------------------------------------
+bool save_dendrogram(const char *fname, const PointCloud &cloud,
+                     const std::vector<triplet> &triplets,
+                     const Dendrogram &dendrogram, double dnn) {
+  std::ofstream of(fname, std::ios::binary);
+  if (!of.is_open()) {
+    std::cerr << "[Error] could not write file '" << fname << "'\n";
+    return false;
+  }
+  uint32_t flags = (cloud.is2d() ? 1 : 0) | (cloud.isOrdered() ? 2 : 0);
+  uint64_t n_points = cloud.size(), n_triplets = triplets.size();
+  of.write(dendro_magic, sizeof(dendro_magic));
+  write_values(of, &dendro_version, 1);
+  write_values(of, &flags, 1);
+  write_values(of, &n_points, 1);
+  write_values(of, &n_triplets, 1);
+  write_values(of, &dnn, 1);
+
+  std::vector<double> coords;
+  coords.reserve(3 * cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    coords.push_back(cloud[i].x);
+    coords.push_back(cloud[i].y);
+    coords.push_back(cloud[i].z);
+  }
+  write_values(of, coords.empty() ? NULL : &coords[0], coords.size());
+
+  std::vector<uint64_t> indices;
+  indices.reserve(3 * triplets.size());
+  for (size_t i = 0; i < triplets.size(); ++i) {
+    indices.push_back(triplets[i].point_index_a);
+    indices.push_back(triplets[i].point_index_b);
+    indices.push_back(triplets[i].point_index_c);
+  }
+  write_values(of, indices.empty() ? NULL : &indices[0], indices.size());
+
+  std::vector<int32_t> merge(dendrogram.merge.begin(), dendrogram.merge.end());
+  write_values(of, merge.empty() ? NULL : &merge[0], merge.size());
+  write_values(of, dendrogram.height.empty() ? NULL : &dendrogram.height[0],
+               dendrogram.height.size());
+
+  if (!of) {
+    std::cerr << "[Error] could not write file '" << fname << "'\n";
+    return false;
+  }
+  return true;
+}
+
+//-------------------------------------------------------------------
+// Loads the cloud *cloud*, the *triplets* (only their point indices),
+// the *dendrogram* and the characteristic length *dnn* from the binary
+// file *fname* written by save_dendrogram. Throws std::invalid_argument
+// if the file cannot be read or has the wrong format.
+//-------------------------------------------------------------------
+void load_dendrogram(const char *fname, PointCloud &cloud,
+                     std::vector<triplet> &triplets, Dendrogram &dendrogram,
+                     double &dnn) {
+  std::ifstream in(fname, std::ios::binary);
+  if (!in.is_open()) {
+    throw std::invalid_argument("cannot open file");
+  }
+  char magic[sizeof(dendro_magic)];
+  uint32_t version, flags;
+  uint64_t n_points, n_triplets;
+  read_values(in, magic, sizeof(magic));
+  if (0 != memcmp(magic, dendro_magic, sizeof(magic))) {
+    throw std::invalid_argument("not a dendrogram file");
+  }
+  read_values(in, &version, 1);
+  if (version != dendro_version) {
+    throw std::invalid_argument("unsupported dendrogram file version");
+  }
+  read_values(in, &flags, 1);
+  read_values(in, &n_points, 1);
+  read_values(in, &n_triplets, 1);
+  read_values(in, &dnn, 1);
+
+  std::vector<double> coords(3 * n_points);
+  read_values(in, coords.empty() ? NULL : &coords[0], coords.size());
+  cloud.clear();
+  cloud.set2d((flags & 1) != 0);
+  cloud.setOrdered((flags & 2) != 0);
+  for (size_t i = 0; i < n_points; ++i) {
+    cloud.push_back(Point(coords[3 * i], coords[3 * i + 1], coords[3 * i + 2],
+                          i));
+  }
+
+  std::vector<uint64_t> indices(3 * n_triplets);
+  read_values(in, indices.empty() ? NULL : &indices[0], indices.size());
+  triplets.resize(n_triplets);
+  for (size_t i = 0; i < n_triplets; ++i) {
+    triplets[i].point_index_a = indices[3 * i];
+    triplets[i].point_index_b = indices[3 * i + 1];
+    triplets[i].point_index_c = indices[3 * i + 2];
+    triplets[i].error = 0.0;
+    if (indices[3 * i] >= n_points || indices[3 * i + 1] >= n_points ||
+        indices[3 * i + 2] >= n_points) {
+      throw std::invalid_argument("invalid point index in triplet");
+    }
+  }
+
+  dendrogram.n = n_triplets;
+  size_t n_merges = n_triplets ? n_triplets - 1 : 0;
+  std::vector<int32_t> merge(2 * n_merges);
+  read_values(in, merge.empty() ? NULL : &merge[0], merge.size());
+  for (size_t i = 0; i < merge.size(); ++i) {
+    // merge[s] and merge[n_merges+s] are the nodes merged in step s+1,
+    // i.e. atoms -1..-n or clusters of the earlier steps 1..s
+    if (merge[i] == 0 || merge[i] < -(int64_t)n_triplets ||
+        merge[i] > (int64_t)(i % n_merges)) {
+      throw std::invalid_argument("invalid merge step in dendrogram");
+    }
+  }
+  dendrogram.merge.assign(merge.begin(), merge.end());
+  dendrogram.height.resize(n_merges);
+  read_values(in, dendrogram.height.empty() ? NULL : &dendrogram.height[0],
+              n_merges);
+}
@@ -0,0 +1,29 @@
+//
+// dendrofile.h
+//     Functions for saving and loading the dendrogram of the triplet
+//     clustering, so that it can be cut again without recomputation.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef DENDROFILE_H
+#define DENDROFILE_H
+
+#include <vector>
+
+#include "cluster.h"
+#include "pointcloud.h"
+#include "triplet.h"
+
+// saves cloud, triplets, dendrogram and dnn as binary file
+bool save_dendrogram(const char *fname, const PointCloud &cloud,
+                     const std::vector<triplet> &triplets,
+                     const Dendrogram &dendrogram, double dnn);
+// loads cloud, triplets, dendrogram and dnn from a binary file
+void load_dendrogram(const char *fname, PointCloud &cloud,
+                     std::vector<triplet> &triplets, Dendrogram &dendrogram,
+                     double &dnn);
+
+#endif
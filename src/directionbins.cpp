@@ -0,0 +1,169 @@
+//
+// directionbins.cpp
+//     Bins of triplets with similar directions for skipping the pairs
+//     whose angle alone exceeds a triplet distance.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "directionbins.h"
+
+// margin for the rounding errors of acos close to 1
+const double angle_margin = 1.0e-6;
+
+// angle between the lines with the unit directions *u* and *v*,
+// which is at most pi/2 as the sign of the directions does not matter
+double line_angle(const double *u, const double *v) {
+  double c = std::fabs(u[0] * v[0] + u[1] * v[1] + u[2] * v[2]);
+  return std::acos(std::min(c, 1.0));
+}
+
+//-------------------------------------------------------------------
+// Cell of the direction *u* on the octahedral grid: the direction is
+// folded onto the upper hemisphere (z >= 0) and projected onto the
+// octahedron |x| + |y| + |z| = 1, whose upper half is the diamond
+// |x| + |y| <= 1 in the plane, which is divided into *resolution* x
+// *resolution* cells.
+//-------------------------------------------------------------------
+size_t direction_cell(const PointD<3> &u, size_t resolution) {
+  const size_t res = std::max(resolution, (size_t)1);
+  double x = u[0], y = u[1], z = u[2];
+  if (z < 0.0) {
+    x = -x;
+    y = -y;
+    z = -z;
+  }
+  double l1 = std::fabs(x) + std::fabs(y) + z;
+  double px = (l1 > 0.0) ? x / l1 : 0.0;
+  double py = (l1 > 0.0) ? y / l1 : 0.0;
+  size_t cx = std::min((size_t)((px + 1.0) * 0.5 * res), res - 1);
+  size_t cy = std::min((size_t)((py + 1.0) * 0.5 * res), res - 1);
+  return cy * res + cx;
+}
+
+//-------------------------------------------------------------------
+// Bins the *triplets* by the cells of their directions (direction_cell).
+// The axis and radius of each bin are computed from its members, so that
+// folded directions on the equator are no special case.
+//-------------------------------------------------------------------
+DirectionBins::DirectionBins(const std::vector<triplet> &triplets,
+                             size_t resolution) {
+  const size_t n = triplets.size();
+  const size_t res = std::max(resolution, (size_t)1);
+
+  // sweep axis from the bounding box of the centers
+  this->sweep_axis = 0;
+  if (n > 0) {
+    double lo[3], hi[3];
+    for (size_t d = 0; d < 3; ++d) {
+      lo[d] = hi[d] = triplets[0].center[d];
+    }
+    for (size_t i = 1; i < n; ++i) {
+      for (size_t d = 0; d < 3; ++d) {
+        double x = triplets[i].center[d];
+        lo[d] = std::min(lo[d], x);
+        hi[d] = std::max(hi[d], x);
+      }
+    }
+    for (size_t d = 1; d < 3; ++d) {
+      if (hi[d] - lo[d] > hi[this->sweep_axis] - lo[this->sweep_axis])
+        this->sweep_axis = d;
+    }
+  }
+
+  // cells of the directions
+  std::vector<long> cell_bin(res * res, -1);
+  for (size_t i = 0; i < n; ++i) {
+    long &bin = cell_bin[direction_cell(triplets[i].direction, res)];
+    if (bin < 0) {
+      bin = (long)this->bins.size();
+      this->bins.push_back(DirectionBin());
+    }
+    this->bins[bin].members.push_back(i);
+  }
+
+  for (size_t b = 0; b < this->bins.size(); ++b) {
+    DirectionBin &bin = this->bins[b];
+    // mean of the directions with the sign of the first member
+    const PointD<3> &first = triplets[bin.members[0]].direction;
+    double sum[3] = {0.0, 0.0, 0.0};
+    for (size_t k = 0; k < bin.members.size(); ++k) {
+      const PointD<3> &u = triplets[bin.members[k]].direction;
+      double sign = (u * first < 0.0) ? -1.0 : 1.0;
+      for (size_t d = 0; d < 3; ++d) sum[d] += sign * u[d];
+    }
+    double norm = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] +
+                            sum[2] * sum[2]);
+    if (norm > 0.0) {
+      for (size_t d = 0; d < 3; ++d) bin.axis[d] = sum[d] / norm;
+    } else {
+      for (size_t d = 0; d < 3; ++d) bin.axis[d] = first[d];
+    }
+    bin.radius = 0.0;
+    for (size_t k = 0; k < bin.members.size(); ++k) {
+      const PointD<3> &u = triplets[bin.members[k]].direction;
+      double dir[3] = {u[0], u[1], u[2]};
+      bin.radius = std::max(bin.radius, line_angle(bin.axis, dir));
+    }
+
+    // members sorted along the sweep axis (ties by index)
+    std::vector<std::pair<double, size_t> > sorted;
+    sorted.reserve(bin.members.size());
+    for (size_t k = 0; k < bin.members.size(); ++k) {
+      size_t i = bin.members[k];
+      sorted.push_back(std::make_pair(
+          triplets[i].center[this->sweep_axis], i));
+    }
+    std::sort(sorted.begin(), sorted.end());
+    bin.keys.resize(sorted.size());
+    for (size_t k = 0; k < sorted.size(); ++k) {
+      bin.keys[k] = sorted[k].first;
+      bin.members[k] = sorted[k].second;
+    }
+  }
+}
+
+size_t DirectionBins::size() const { return this->bins.size(); }
+
+const DirectionBin &DirectionBins::operator[](size_t b) const {
+  return this->bins[b];
+}
+
+size_t DirectionBins::get_sweep_axis() const { return this->sweep_axis; }
+
+//-------------------------------------------------------------------
+// Lower bound for the angle between the lines of the directions of any
+// member of bin *a* and any member of bin *b*. As the angle between
+// lines fulfills the triangle inequality, this is the angle between the
+// axes minus both radii.
+//-------------------------------------------------------------------
+double DirectionBins::min_angle(size_t a, size_t b) const {
+  const DirectionBin &bin_a = this->bins[a];
+  const DirectionBin &bin_b = this->bins[b];
+  double angle = line_angle(bin_a.axis, bin_b.axis) - bin_a.radius -
+                 bin_b.radius - angle_margin;
+  return std::max(angle, 0.0);
+}
+
+//-------------------------------------------------------------------
+// Grid resolution of the direction bins. The cells span about 1/16 of
+// *max_angle*, so that the bins of most pairs are clearly closer or
+// farther apart than *max_angle* and the window for their centers is
+// narrow, but they hold at least about 16 of the *n* triplets on average,
+// so that the bins do not cost more than they save.
+//-------------------------------------------------------------------
+size_t direction_bin_resolution(double max_angle, size_t n) {
+  // the diamond spans the angle pi in each direction and covers half
+  // of the grid
+  const double pi = std::acos(-1.0);
+  double res = 16.0 * pi / std::max(max_angle, 1.0e-3);
+  res = std::min(res, std::sqrt(2.0 * n / 16.0));
+  res = std::min(res, 256.0);
+  return (size_t)std::max(res, 1.0);
+}
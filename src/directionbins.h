@@ -0,0 +1,60 @@
+//
+// directionbins.h
+//     Bins of triplets with similar directions for skipping the pairs
+//     whose angle alone exceeds a triplet distance.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef DIRECTIONBINS_H
+#define DIRECTIONBINS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "triplet.h"
+
+// triplets whose directions are in the same cell
+struct DirectionBin {
+  double axis[3];               // mean direction of the members
+  double radius;                // max angle between a member and the axis
+  std::vector<size_t> members;  // triplet indices sorted by their keys
+  std::vector<double> keys;     // center coordinates along the sweep axis
+};
+
+// Triplets binned by their direction on an octahedral grid. As the sign
+// of a direction does not matter, directions are folded onto the upper
+// hemisphere, which the octahedron maps onto a diamond in the plane that
+// is divided into *resolution* x *resolution* cells. Only non-empty cells
+// are kept.
+class DirectionBins {
+ private:
+  std::vector<DirectionBin> bins;
+  // coordinate (0, 1, 2 for x, y, z) with the largest extent of the
+  // triplet centers, by which the members of the bins are sorted
+  size_t sweep_axis;
+
+ public:
+  DirectionBins(const std::vector<triplet> &triplets, size_t resolution);
+  size_t size() const;
+  const DirectionBin &operator[](size_t b) const;
+  size_t get_sweep_axis() const;
+  // lower bound for the angle between the members of the bins *a* and *b*
+  double min_angle(size_t a, size_t b) const;
+};
+
+// grid resolution for pruning the pairs of *n* triplets with an angle
+// larger than *max_angle*
+size_t direction_bin_resolution(double max_angle, size_t n);
+
+// cell of the direction *u* on the octahedral grid of DirectionBins with
+// *resolution* x *resolution* cells
+size_t direction_cell(const PointD<3> &u, size_t resolution);
+
+// angle between the lines with the unit directions *u* and *v* (at most
+// pi/2, because the sign of the directions does not matter)
+double line_angle(const double *u, const double *v);
+
+#endif
@@ -0,0 +1,106 @@
+//
+// diskmatrix.cpp
+//     Condensed distance matrix in a memory-mapped temporary file for
+//     clustering more triplets than fit into memory.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "diskmatrix.h"
+
+DiskMatrix::DiskMatrix() : data(NULL), bytes(0) {}
+
+DiskMatrix::~DiskMatrix() {
+#ifndef _WIN32
+  if (this->data) munmap(this->data, this->bytes);
+#endif
+}
+
+//-------------------------------------------------------------------
+// Creates a temporary file in the directory *dir* that is large enough
+// for *n* entries and maps it into memory. The disk space is allocated
+// up front, because a full disk would otherwise kill the process with
+// SIGBUS when a page of the mapping is written back. File systems that
+// cannot allocate space leave the file sparse. The file is removed
+// right away. Returns the mapped entries or NULL in case of errors,
+// whose reason is then available with get_error().
+//-------------------------------------------------------------------
+t_float *DiskMatrix::create(const char *dir, size_t n) {
+#ifdef _WIN32
+  this->error = "memory-mapped distance matrix not supported on Windows";
+  return NULL;
+#else
+  std::string path = std::string(dir) + "/triplclust-matrix-XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  int fd = mkstemp(&name[0]);
+  if (fd < 0) {
+    this->error = std::string("cannot create file in '") + dir +
+                  "': " + strerror(errno);
+    return NULL;
+  }
+  unlink(&name[0]);
+  this->bytes = n * sizeof(t_float);
+  if (ftruncate(fd, (off_t)this->bytes) != 0) {
+    this->error = std::string("cannot resize file in '") + dir +
+                  "': " + strerror(errno);
+    close(fd);
+    this->bytes = 0;
+    return NULL;
+  }
+  // returns the error number instead of setting errno
+  int rc = posix_fallocate(fd, 0, (off_t)this->bytes);
+  if (rc != 0 && rc != EINVAL && rc != EOPNOTSUPP) {
+    std::ostringstream msg;
+    msg << "cannot allocate " << this->bytes << " bytes in '" << dir
+        << "': " << strerror(rc);
+    this->error = msg.str();
+    close(fd);
+    this->bytes = 0;
+    return NULL;
+  }
+  void *p = mmap(NULL, this->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    this->error = std::string("cannot map file in '") + dir +
+                  "': " + strerror(errno);
+    close(fd);
+    this->bytes = 0;
+    return NULL;
+  }
+  close(fd);  // the mapping keeps the file open
+  this->data = (t_float *)p;
+  return this->data;
+#endif
+}
+
+// the distance matrix is computed row by row, so that the kernel can
+// write back the pages early and read ahead
+void DiskMatrix::advise_sequential() {
+#ifndef _WIN32
+  if (this->data) posix_madvise(this->data, this->bytes, POSIX_MADV_SEQUENTIAL);
+#endif
+}
+
+// the clustering jumps between rows and columns
+void DiskMatrix::advise_normal() {
+#ifndef _WIN32
+  if (this->data) posix_madvise(this->data, this->bytes, POSIX_MADV_NORMAL);
+#endif
+}
+
+size_t DiskMatrix::size_bytes() const { return this->bytes; }
+
+const std::string &DiskMatrix::get_error() const { return this->error; }
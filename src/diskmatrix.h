@@ -0,0 +1,44 @@
+//
+// diskmatrix.h
+//     Condensed distance matrix in a memory-mapped temporary file for
+//     clustering more triplets than fit into memory.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef DISKMATRIX_H
+#define DISKMATRIX_H
+
+#include <cstddef>
+#include <string>
+
+#include "hclust/fastcluster.h"
+
+// distance matrix that is backed by a file instead of memory; the file
+// is removed as soon as it is mapped, so that it vanishes with the object
+class DiskMatrix {
+ private:
+  t_float *data;
+  size_t bytes;
+  std::string error;
+  // not copyable
+  DiskMatrix(const DiskMatrix &);
+  DiskMatrix &operator=(const DiskMatrix &);
+
+ public:
+  DiskMatrix();
+  ~DiskMatrix();
+  // maps a file in *dir* for *n* entries; returns NULL on failure
+  t_float *create(const char *dir, size_t n);
+  // the pages are about to be written from start to end
+  void advise_sequential();
+  // the pages are accessed in no predictable order
+  void advise_normal();
+  size_t size_bytes() const;
+  // reason why create failed
+  const std::string &get_error() const;
+};
+
+#endif
@@ -7,60 +7,142 @@
 // License: see ../LICENSE
 //
 
+#include <stdint.h>
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <vector>
 
 #include "dnn.h"
 #include "kdtree/kdtree.hpp"
+#include "spatialindex.h"
+#include "stats.h"
+
+// z value of the two-sided 95% confidence interval of the normal
+// distribution
+const double z95 = 1.96;
+
+//-------------------------------------------------------------------
+// Mean squared distances of the points *point_indices* of *cloud* (or
+// of all points, when NULL) to their *k* nearest neighbours in
+// *spatial_index*, which also contains the points themselves. The
+// distances are returned in *msd*. The points are processed by
+// *threads* threads when compiled with OpenMP.
+//-------------------------------------------------------------------
+void index_mean_square_distance(const PointCloud &cloud,
+                                SpatialIndex *spatial_index,
+                                const std::vector<size_t> *point_indices,
+                                std::vector<double> &msd, size_t k,
+                                int threads) {
+  const size_t dimension = cloud.dimension();
+  const size_t n = point_indices ? point_indices->size() : cloud.size();
+  msd.resize(n);
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 1024) if (threads > 1)
+  for (long j = 0; j < (long)n; ++j) {
+    size_t i = point_indices ? (*point_indices)[j] : (size_t)j;
+    Kdtree::KdNodeVector result;
+    std::vector<double> squared_distances;
+    // k + 1 neighbours, because the first one is the point itself
+    spatial_index->k_nearest_neighbors(cloud[i].as_vector(dimension), k + 1,
+                                       &result, &squared_distances);
+    double sum = std::accumulate(squared_distances.begin() + 1,
+                                 squared_distances.end(), 0.0);
+    msd[j] = sum / (squared_distances.size() - 1);
+  }
+}
 
 //-------------------------------------------------------------------
 // Compute mean squared distances.
 // the distances is computed for every point in *cloud* to its *k*
-// nearest neighbours. The distances are returned in *msd*.
+// nearest neighbours. The distances are returned in *msd*. The
+// neighbours are searched with the spatial index of type *index*. When
+// *stats* is given, the index build time is recorded. The points are
+// processed by *threads* threads.
 //-------------------------------------------------------------------
 void compute_mean_square_distance(const PointCloud &cloud,
-                                  std::vector<double> &msd, int k) {
-  // compute mean square distances for every point to its k nearest neighbours
-  Kdtree::KdNodeVector nodes, result;
-  double sum;
+                                  std::vector<double> &msd, int k,
+                                  IndexType index, Stats *stats,
+                                  int threads) {
+  Kdtree::KdNodeVector nodes;
 
-  // build kdtree
+  // build spatial index
+  const size_t dimension = cloud.dimension();
   for (size_t i = 0; i < cloud.size(); ++i) {
-    nodes.push_back(cloud[i].as_vector());
-  }
-  Kdtree::KdTree kdtree(&nodes);
-
-  k++;  // k must be one higher because the first point found by the kdtree is
-        // the point itself
-
-  for (size_t i = 0; i < cloud.size(); ++i) {
-    // compute
-    std::vector<double> squared_distances;
-    kdtree.k_nearest_neighbors(cloud[i].as_vector(), k, &result,
-                               &squared_distances);
-
-    squared_distances.erase(squared_distances.begin());  // The first value
-                                                         // must be deleted
-                                                         // because it is
-                                                         // the distance
-                                                         // with the point
-                                                         // itself
-
-    sum = std::accumulate(squared_distances.begin(), squared_distances.end(),
-                          0.0);
-    msd.push_back(sum / squared_distances.size());
+    nodes.push_back(cloud[i].as_vector(dimension));
   }
+  SpatialIndex *spatial_index =
+      build_spatial_index(&nodes, index, k + 1, 0.0, stats);
+  index_mean_square_distance(cloud, spatial_index, NULL, msd, k, threads);
+  delete spatial_index;
 }
 
 //-------------------------------------------------------------------
 // Compute first quartile of the mean squared distance of all points
 // in *cloud*
 //-------------------------------------------------------------------
-double first_quartile(const PointCloud &cloud) {
+double first_quartile(const PointCloud &cloud, IndexType index,
+                      Stats *stats, int threads) {
   std::vector<double> msd;
-  compute_mean_square_distance(cloud, msd, 1);
+  compute_mean_square_distance(cloud, msd, 1, index, stats, threads);
   const double q1 = msd.size() / 4;
   std::nth_element(msd.begin(), msd.begin() + q1, msd.end());
   return msd[q1];
 }
+
+//-------------------------------------------------------------------
+// Estimates the first quartile of the mean squared distance of the
+// points in *cloud* from *n_samples* points drawn at random without
+// replacement. The sample is the same in every run. The neighbours are
+// still searched among all points with the spatial index of type
+// *index*. The bounds of the distribution-free 95% confidence interval
+// of the quartile (from the order statistics of the sample) are
+// returned in *lower* and *upper*. When *stats* is given, the index
+// build time and the sample size are recorded. The sampled points are
+// processed by *threads* threads.
+//-------------------------------------------------------------------
+double sampled_first_quartile(const PointCloud &cloud, size_t n_samples,
+                              double &lower, double &upper, IndexType index,
+                              Stats *stats, int threads) {
+  const size_t n = cloud.size();
+  if (n_samples > n) n_samples = n;
+
+  // selection sampling (Knuth's algorithm S) with splitmix64, which
+  // yields the sample in index order
+  std::vector<size_t> sample;
+  sample.reserve(n_samples);
+  uint64_t state = 0;
+  for (size_t i = 0; i < n && sample.size() < n_samples; ++i) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    double u = ((z ^ (z >> 31)) >> 11) * (1.0 / 9007199254740992.0);
+    if ((n - i) * u < n_samples - sample.size()) sample.push_back(i);
+  }
+  if (stats) stats->set_count("dnn_samples", sample.size());
+
+  Kdtree::KdNodeVector nodes;
+  const size_t dimension = cloud.dimension();
+  for (size_t i = 0; i < n; ++i) {
+    nodes.push_back(cloud[i].as_vector(dimension));
+  }
+  SpatialIndex *spatial_index = build_spatial_index(&nodes, index, 2, 0.0,
+                                                    stats);
+  std::vector<double> msd;
+  index_mean_square_distance(cloud, spatial_index, &sample, msd, 1, threads);
+  delete spatial_index;
+  if (msd.empty()) {
+    lower = upper = 0.0;
+    return 0.0;
+  }
+
+  // the rank of the quartile in the sample is binomially distributed
+  std::sort(msd.begin(), msd.end());
+  const size_t m = msd.size();
+  const double q1 = m / 4;
+  const double halfwidth = z95 * std::sqrt(m * 0.25 * 0.75);
+  const double rank_lower = std::floor(m * 0.25 - halfwidth);
+  const double rank_upper = std::ceil(m * 0.25 + halfwidth);
+  lower = msd[rank_lower > 0.0 ? (size_t)rank_lower : 0];
+  upper = msd[std::min(m - 1, (size_t)rank_upper)];
+  return msd[(size_t)q1];
+}
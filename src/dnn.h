@@ -9,9 +9,27 @@
 
 #ifndef DNN_H
 #define DNN_H
+#include <vector>
+
 #include "pointcloud.h"
+#include "util.h"
+
+class Stats;
 
+// compute mean squared distances of each point to its k nearest neighbours
+// (with *threads* threads)
+void compute_mean_square_distance(const PointCloud &cloud,
+                                  std::vector<double> &msd, int k,
+                                  IndexType index = INDEX_KDTREE,
+                                  Stats *stats = NULL, int threads = 1);
 // compute first quartile of the mean squared distance from the points
-double first_quartile(const PointCloud &cloud);
+double first_quartile(const PointCloud &cloud, IndexType index = INDEX_KDTREE,
+                      Stats *stats = NULL, int threads = 1);
+// estimate the first quartile from a random sample of *n_samples* points
+// and the bounds *lower* and *upper* of its 95% confidence interval
+double sampled_first_quartile(const PointCloud &cloud, size_t n_samples,
+                              double &lower, double &upper,
+                              IndexType index = INDEX_KDTREE,
+                              Stats *stats = NULL, int threads = 1);
 
 #endif
@@ -0,0 +1,283 @@
+//
+// extsort.h
+//     Buffered record files and external sorting of records that do not
+//     fit into memory, for the out-of-core mode.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-17
+// License: see ../LICENSE
+//
+
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// writer of records of the plain data type T to a binary file, which
+// buffers *capacity* records
+template <class T>
+class RecordWriter {
+ private:
+  FILE *out;
+  std::vector<T> buffer;
+  size_t capacity;
+  bool ok;
+  // not copyable
+  RecordWriter(const RecordWriter &);
+  RecordWriter &operator=(const RecordWriter &);
+
+ public:
+  RecordWriter(const std::string &path, size_t capacity)
+      : out(fopen(path.c_str(), "wb")),
+        capacity(std::max(capacity, (size_t)1)),
+        ok(out != NULL) {}
+  ~RecordWriter() { this->close(); }
+  // appends *record*; returns false in case of I/O errors
+  bool add(const T &record) {
+    this->buffer.push_back(record);
+    if (this->buffer.size() >= this->capacity) return this->flush();
+    return this->ok;
+  }
+  // writes the buffered records; returns false in case of I/O errors
+  bool flush() {
+    if (this->ok && !this->buffer.empty() &&
+        fwrite(&this->buffer[0], sizeof(T), this->buffer.size(), this->out) !=
+            this->buffer.size())
+      this->ok = false;
+    this->buffer.clear();
+    return this->ok;
+  }
+  // flushes and closes the file; returns false in case of I/O errors
+  bool close() {
+    if (!this->out) return this->ok;
+    this->flush();
+    if (fclose(this->out) != 0) this->ok = false;
+    this->out = NULL;
+    std::vector<T>().swap(this->buffer);
+    return this->ok;
+  }
+};
+
+// reader of the records written by RecordWriter, which reads
+// *capacity* records at a time
+template <class T>
+class RecordReader {
+ private:
+  FILE *in;
+  std::vector<T> buffer;
+  size_t capacity, pos, filled;
+  bool ok;
+  // not copyable
+  RecordReader(const RecordReader &);
+  RecordReader &operator=(const RecordReader &);
+
+ public:
+  RecordReader(const std::string &path, size_t capacity)
+      : in(fopen(path.c_str(), "rb")),
+        buffer(std::max(capacity, (size_t)1)),
+        capacity(std::max(capacity, (size_t)1)),
+        pos(0),
+        filled(0),
+        ok(in != NULL) {}
+  ~RecordReader() {
+    if (this->in) fclose(this->in);
+  }
+  // reads the next record; returns false at the end of the file or in
+  // case of I/O errors (see good)
+  bool next(T &record) {
+    if (this->pos == this->filled) {
+      if (!this->ok) return false;
+      this->filled =
+          fread(&this->buffer[0], sizeof(T), this->capacity, this->in);
+      this->pos = 0;
+      if (ferror(this->in)) this->ok = false;
+      if (this->filled == 0) return false;
+    }
+    record = this->buffer[this->pos++];
+    return true;
+  }
+  // false in case of I/O errors
+  bool good() const { return this->ok; }
+};
+
+// Sorts records of the plain data type T with operator< that do not fit
+// into memory. The records are collected in a buffer of *buffer_size*
+// bytes, which is sorted and written as a run to a file in *dir* when it
+// is full. After finish, the records are returned in sorted order by
+// next, which merges the runs; when there are more than max_fan_in runs,
+// they are merged in several passes. The run files are removed by the
+// destructor. Records that are equal are returned in no specific order.
+template <class T>
+class ExternalSorter {
+ private:
+  // maximum number of runs that are merged at the same time
+  static const size_t max_fan_in = 64;
+  // current record of a run during merging
+  struct Head {
+    T record;
+    size_t run;
+  };
+  // order of the heap of the smallest records
+  struct HeadGreater {
+    bool operator()(const Head &h1, const Head &h2) const {
+      if (h2.record < h1.record) return true;
+      if (h1.record < h2.record) return false;
+      return h1.run > h2.run;
+    }
+  };
+
+  std::string dir, prefix;
+  size_t capacity;  // number of records in the buffer
+  std::vector<T> buffer;
+  std::vector<std::string> runs;
+  size_t n_files, n_records, pos;
+  bool ok;
+  std::vector<RecordReader<T> *> readers;
+  std::vector<Head> heap;
+  // not copyable
+  ExternalSorter(const ExternalSorter &);
+  ExternalSorter &operator=(const ExternalSorter &);
+
+  // path of a new run file
+  std::string new_run_path() {
+    std::ostringstream name;
+    name << this->dir << "/" << this->prefix << this->n_files++ << ".run";
+    return name.str();
+  }
+  // sorts the buffer and writes it as a new run
+  bool write_run();
+  // opens the readers of *runs* and fills the heap with their first records
+  bool open_runs(const std::vector<std::string> &runs);
+  // closes the readers and removes the files of *runs*
+  void close_runs(const std::vector<std::string> &runs);
+  // removes the smallest record of the heap and advances its run
+  bool pop(T &record);
+
+ public:
+  ExternalSorter(const char *dir, const std::string &prefix,
+                 size_t buffer_size)
+      : dir(dir),
+        prefix(prefix),
+        capacity(std::max(buffer_size / sizeof(T), (size_t)2)),
+        n_files(0),
+        n_records(0),
+        pos(0),
+        ok(true) {}
+  ~ExternalSorter() { this->close_runs(this->runs); }
+  // adds *record*; returns false in case of I/O errors
+  bool add(const T &record) {
+    this->buffer.push_back(record);
+    this->n_records++;
+    if (this->buffer.size() >= this->capacity) return this->write_run();
+    return this->ok;
+  }
+  // sorts all records added so far; returns false in case of I/O errors
+  bool finish();
+  // next record in sorted order; returns false after the last record or
+  // in case of I/O errors (see good)
+  bool next(T &record) {
+    if (this->runs.empty()) {
+      if (this->pos == this->buffer.size()) return false;
+      record = this->buffer[this->pos++];
+      return true;
+    }
+    return this->pop(record);
+  }
+  // false in case of I/O errors
+  bool good() const { return this->ok; }
+  // number of records added
+  size_t size() const { return this->n_records; }
+  // number of run files written, including those of the merge passes
+  size_t run_files() const { return this->n_files; }
+};
+
+template <class T>
+bool ExternalSorter<T>::write_run() {
+  if (this->buffer.empty() || !this->ok) return this->ok;
+  std::sort(this->buffer.begin(), this->buffer.end());
+  this->runs.push_back(this->new_run_path());
+  FILE *out = fopen(this->runs.back().c_str(), "wb");
+  this->ok = (out != NULL &&
+              fwrite(&this->buffer[0], sizeof(T), this->buffer.size(), out) ==
+                  this->buffer.size());
+  if (out && fclose(out) != 0) this->ok = false;
+  this->buffer.clear();
+  return this->ok;
+}
+
+template <class T>
+bool ExternalSorter<T>::open_runs(const std::vector<std::string> &runs) {
+  // the read buffers share the memory of the sort buffer
+  size_t run_capacity = this->capacity / (runs.size() + 1) + 1;
+  this->heap.clear();
+  for (size_t r = 0; r < runs.size(); ++r) {
+    this->readers.push_back(new RecordReader<T>(runs[r], run_capacity));
+    Head head;
+    head.run = r;
+    if (this->readers[r]->next(head.record)) {
+      this->heap.push_back(head);
+    } else if (!this->readers[r]->good()) {
+      this->ok = false;
+    }
+  }
+  std::make_heap(this->heap.begin(), this->heap.end(), HeadGreater());
+  return this->ok;
+}
+
+template <class T>
+void ExternalSorter<T>::close_runs(const std::vector<std::string> &runs) {
+  for (size_t r = 0; r < this->readers.size(); ++r) delete this->readers[r];
+  this->readers.clear();
+  this->heap.clear();
+  for (size_t r = 0; r < runs.size(); ++r) remove(runs[r].c_str());
+}
+
+template <class T>
+bool ExternalSorter<T>::pop(T &record) {
+  if (this->heap.empty()) return false;
+  std::pop_heap(this->heap.begin(), this->heap.end(), HeadGreater());
+  Head &head = this->heap.back();
+  record = head.record;
+  if (this->readers[head.run]->next(head.record)) {
+    std::push_heap(this->heap.begin(), this->heap.end(), HeadGreater());
+  } else {
+    if (!this->readers[head.run]->good()) this->ok = false;
+    this->heap.pop_back();
+  }
+  return this->ok;
+}
+
+template <class T>
+bool ExternalSorter<T>::finish() {
+  this->pos = 0;
+  if (this->runs.empty()) {
+    std::sort(this->buffer.begin(), this->buffer.end());
+    return this->ok;
+  }
+  if (!this->write_run()) return false;
+  std::vector<T>().swap(this->buffer);
+
+  // merge passes until all runs can be merged at the same time
+  while (this->runs.size() > max_fan_in && this->ok) {
+    std::vector<std::string> inputs(this->runs.begin(),
+                                    this->runs.begin() + max_fan_in);
+    this->runs.erase(this->runs.begin(), this->runs.begin() + max_fan_in);
+    this->runs.push_back(this->new_run_path());
+    if (this->open_runs(inputs)) {
+      RecordWriter<T> writer(this->runs.back(), this->capacity / 2 + 1);
+      T record;
+      while (this->ok && this->pop(record)) writer.add(record);
+      if (!writer.close()) this->ok = false;
+    }
+    this->close_runs(inputs);
+  }
+  if (this->ok) this->open_runs(this->runs);
+  return this->ok;
+}
+
+#endif
@@ -0,0 +1,400 @@
+//
+// generate.cpp
+//     Generator for synthetic point clouds with curves (helices, lines,
+//     arcs, crossing lines) and uniform noise, together with ground truth
+//     labels, for testing scaling behaviour and correctness of triplclust.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+// usage message
+const char *usage =
+    "Usage:\n"
+    "\ttriplclust-gen [options]\n"
+    "Writes a synthetic point cloud with curves and uniform noise that can\n"
+    "be used as input for triplclust. Curve points are written in the order\n"
+    "in which they are traversed, so that the output can also be used with\n"
+    "the triplclust option -ordered.\n"
+    "Options (defaults in brackets):\n"
+    "\t-n <n>         total number of points [10000]\n"
+    "\t-shape <list>  comma separated list of curve shapes that are used\n"
+    "\t               in turn; possible shapes are 'helix', 'line', 'arc'\n"
+    "\t               and 'cross' (line crossing the previous curve)\n"
+    "\t               [helix,line,arc,cross]\n"
+    "\t-curves <n>    number of curves [one per 500 curve points]\n"
+    "\t-density <d>   number of curve points per unit length [10]\n"
+    "\t-jitter <s>    standard deviation of the position noise of curve\n"
+    "\t               points in multiples of the point spacing [0.1]\n"
+    "\t-noise <f>     fraction of uniformly distributed noise points [0.1]\n"
+    "\t-seed <n>      seed of the random number generator [1]\n"
+    "\t-2d            generate 2D points instead of 3D points\n"
+    "\t-thickness <h> with -2d, write 3D points with z uniformly in [0,h]\n"
+    "\t               instead of 2D points, i.e. a flat 3D cloud [0]\n"
+    "\t-o <file>      write points to <file> instead of stdout\n"
+    "\t-labels <file> write ground truth labels to <file>, one line per\n"
+    "\t               point with the curve number or -1 for noise\n"
+    "Version:\n"
+    "\t" TRIPLCLUST_VERSION;
+
+const double pi = 3.14159265358979323846;
+
+//-------------------------------------------------------------------
+// Random number generator (splitmix64) that yields the same sequence
+// on all platforms for the same seed.
+//-------------------------------------------------------------------
+class Random {
+ private:
+  uint64_t state;
+  bool has_gauss;
+  double next_gauss;
+
+ public:
+  Random(uint64_t seed) {
+    state = seed;
+    has_gauss = false;
+    next_gauss = 0.0;
+  }
+  uint64_t next() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  // uniform in [0,1)
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+  // uniform integer in [0,n)
+  uint64_t integer(uint64_t n) { return (uint64_t)(uniform() * n); }
+  // standard normal distribution (Box-Muller)
+  double gauss() {
+    if (has_gauss) {
+      has_gauss = false;
+      return next_gauss;
+    }
+    double u1 = uniform(), u2 = uniform();
+    if (u1 < 1.0e-300) u1 = 1.0e-300;
+    const double r = std::sqrt(-2.0 * std::log(u1));
+    next_gauss = r * std::sin(2.0 * pi * u2);
+    has_gauss = true;
+    return r * std::cos(2.0 * pi * u2);
+  }
+};
+
+// simple 3D vector
+struct Vec {
+  double x, y, z;
+};
+Vec vec(double x, double y, double z) {
+  Vec v = {x, y, z};
+  return v;
+}
+Vec operator+(const Vec &a, const Vec &b) {
+  return vec(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+Vec operator*(double c, const Vec &a) { return vec(c * a.x, c * a.y, c * a.z); }
+Vec cross(const Vec &a, const Vec &b) {
+  return vec(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+             a.x * b.y - a.y * b.x);
+}
+Vec normalize(const Vec &a) {
+  return (1.0 / std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z)) * a;
+}
+
+// random unit vector (in the xy-plane for 2D)
+Vec random_direction(Random &rng, bool is2d) {
+  if (is2d) {
+    const double phi = 2.0 * pi * rng.uniform();
+    return vec(std::cos(phi), std::sin(phi), 0.0);
+  }
+  Vec v;
+  double n2;
+  do {
+    v = vec(rng.gauss(), rng.gauss(), rng.gauss());
+    n2 = v.x * v.x + v.y * v.y + v.z * v.z;
+  } while (n2 < 1.0e-12);
+  return (1.0 / std::sqrt(n2)) * v;
+}
+
+enum Shape { HELIX, LINE, ARC, CROSS };
+
+//-------------------------------------------------------------------
+// A curve with *npoints* equidistant points (before jitter) along
+// its arc length *length*. Points are created in traversal order.
+//-------------------------------------------------------------------
+struct Curve {
+  Shape shape;
+  size_t npoints, next;  // number of points and index of next point
+  double length;
+  Vec center, e1, e2, e3;  // center and orthonormal frame
+  double radius, turns;    // for helices and arcs
+
+  // point at fraction *u* (in [0,1]) of the arc length
+  Vec point(double u) const {
+    const double s = (u - 0.5) * length;
+    if (shape == LINE || shape == CROSS) {
+      return center + s * e1;
+    } else if (shape == ARC) {
+      const double phi = s / radius;
+      return center + (radius * std::sin(phi)) * e1 +
+             (radius * (1.0 - std::cos(phi))) * e2;
+    } else {  // HELIX
+      // arc length per radian is sqrt(radius^2 + pitch^2)
+      const double phi = 2.0 * pi * turns * (u - 0.5);
+      const double pitch = std::sqrt(std::max(
+          0.0, length * length / (4.0 * pi * pi * turns * turns) -
+                   radius * radius));
+      return center + (radius * std::cos(phi)) * e1 +
+             (radius * std::sin(phi)) * e2 + (pitch * phi) * e3;
+    }
+  }
+};
+
+//-------------------------------------------------------------------
+// Fenwick tree over the number of remaining points per source for
+// drawing the source of the next point proportionally to its
+// remaining points in O(log n).
+//-------------------------------------------------------------------
+class Fenwick {
+ private:
+  std::vector<uint64_t> tree;
+
+ public:
+  Fenwick(size_t n) : tree(n + 1, 0) {}
+  void add(size_t i, int64_t delta) {
+    for (++i; i < tree.size(); i += i & (~i + 1)) tree[i] += delta;
+  }
+  // smallest index i with prefix sum(0..i) > r
+  size_t find(uint64_t r) const {
+    size_t pos = 0, step = 1;
+    while (step * 2 < tree.size()) step *= 2;
+    for (; step > 0; step /= 2) {
+      if (pos + step < tree.size() && tree[pos + step] <= r) {
+        pos += step;
+        r -= tree[pos];
+      }
+    }
+    return pos;
+  }
+};
+
+int main(int argc, char **argv) {
+  size_t npoints = 10000, ncurves = 0, seed = 1;
+  double density = 10.0, jitter = 0.1, noise = 0.1, thickness = 0.0;
+  bool is2d = false;
+  std::vector<Shape> shapes;
+  const char *outfile_name = NULL, *labelfile_name = NULL;
+
+  // parse commandline
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (0 == strcmp(argv[i], "-2d")) {
+        is2d = true;
+        continue;
+      }
+      if (argv[i][0] != '-' || i + 1 >= argc) {
+        std::cerr << usage << std::endl;
+        return 1;
+      }
+      const char *arg = argv[++i];
+      if (0 == strcmp(argv[i - 1], "-n")) {
+        npoints = (size_t)stod(arg);
+      } else if (0 == strcmp(argv[i - 1], "-curves")) {
+        ncurves = (size_t)stod(arg);
+      } else if (0 == strcmp(argv[i - 1], "-seed")) {
+        seed = (size_t)stod(arg);
+      } else if (0 == strcmp(argv[i - 1], "-density")) {
+        density = stod(arg);
+      } else if (0 == strcmp(argv[i - 1], "-jitter")) {
+        jitter = stod(arg);
+      } else if (0 == strcmp(argv[i - 1], "-noise")) {
+        noise = stod(arg);
+      } else if (0 == strcmp(argv[i - 1], "-thickness")) {
+        thickness = stod(arg);
+      } else if (0 == strcmp(argv[i - 1], "-o")) {
+        outfile_name = arg;
+      } else if (0 == strcmp(argv[i - 1], "-labels")) {
+        labelfile_name = arg;
+      } else if (0 == strcmp(argv[i - 1], "-shape")) {
+        std::vector<std::string> items;
+        split(arg, items, ',');
+        for (size_t j = 0; j < items.size(); ++j) {
+          if (items[j] == "helix") {
+            shapes.push_back(HELIX);
+          } else if (items[j] == "line") {
+            shapes.push_back(LINE);
+          } else if (items[j] == "arc") {
+            shapes.push_back(ARC);
+          } else if (items[j] == "cross") {
+            shapes.push_back(CROSS);
+          } else {
+            std::cerr << "[Error] unknown shape '" << items[j] << "'"
+                      << std::endl;
+            return 1;
+          }
+        }
+      } else {
+        std::cerr << usage << std::endl;
+        return 1;
+      }
+    }
+  } catch (const std::invalid_argument &e) {
+    std::cerr << "[Error] " << e.what() << std::endl << usage << std::endl;
+    return 1;
+  }
+  if (noise < 0.0 || noise > 1.0 || density <= 0.0 || jitter < 0.0 ||
+      thickness < 0.0) {
+    std::cerr << "[Error] noise must be in [0,1], density positive "
+              << "and jitter and thickness non negative" << std::endl;
+    return 1;
+  }
+  if (shapes.empty()) {
+    shapes.push_back(HELIX);
+    shapes.push_back(LINE);
+    shapes.push_back(ARC);
+    shapes.push_back(CROSS);
+  }
+
+  // distribute points among curves and noise
+  const size_t nnoise = (size_t)(noise * npoints + 0.5);
+  const size_t ncurvepoints = npoints - nnoise;
+  if (ncurves == 0) ncurves = std::max((size_t)1, ncurvepoints / 500);
+  if (ncurvepoints == 0) ncurves = 0;
+  if (ncurves > 0 && ncurvepoints / ncurves < 3) {
+    std::cerr << "[Error] less than three points per curve" << std::endl;
+    return 1;
+  }
+
+  // size of the bounding box grows with the number of curves so that
+  // the curve density does not depend on the number of points
+  Random rng(seed);
+  const double dim = is2d ? 2.0 : 3.0;
+  const double avg_length = (ncurves ? (double)ncurvepoints / ncurves : 500.0)
+                            / density;
+  const double boxsize =
+      avg_length * std::max(1.0, std::pow((double)ncurves, 1.0 / dim));
+
+  std::vector<Curve> curves(ncurves);
+  for (size_t i = 0; i < ncurves; ++i) {
+    Curve &c = curves[i];
+    c.shape = shapes[i % shapes.size()];
+    c.npoints = ncurvepoints / ncurves + (i < ncurvepoints % ncurves ? 1 : 0);
+    c.next = 0;
+    c.length = c.npoints / density;
+    if (c.shape == CROSS && i > 0) {
+      // crossing the middle of the previous curve
+      c.center = curves[i - 1].point(0.5);
+    } else {
+      c.center = vec(boxsize * rng.uniform(), boxsize * rng.uniform(),
+                     is2d ? 0.0 : boxsize * rng.uniform());
+    }
+    if (is2d) {
+      Vec d = random_direction(rng, true), perp = vec(-d.y, d.x, 0.0);
+      if (c.shape == HELIX) {
+        // the projection of a helix along its axis d is a sine curve
+        c.e1 = perp;
+        c.e2 = vec(0.0, 0.0, 0.0);
+        c.e3 = d;
+      } else {
+        c.e1 = d;
+        c.e2 = perp;
+        c.e3 = vec(0.0, 0.0, 0.0);
+      }
+    } else {
+      c.e1 = random_direction(rng, false);
+      c.e2 = normalize(cross(c.e1, random_direction(rng, false)));
+      c.e3 = cross(c.e1, c.e2);
+    }
+    // arcs cover between a quarter and a half circle, helices
+    // have between two and five turns with a radius of 70% of
+    // the maximum radius for the given length per turn
+    if (c.shape == ARC) {
+      const double angle = pi * (0.5 + 0.5 * rng.uniform());
+      c.radius = c.length / angle;
+      c.turns = 0.0;
+    } else {
+      c.turns = 2.0 + 3.0 * rng.uniform();
+      c.radius = c.length / (c.turns * 2.0 * pi) * 0.7;
+    }
+  }
+
+  // open output files
+  std::ofstream of, lf;
+  if (outfile_name) {
+    of.open(outfile_name);
+    if (!of.is_open()) {
+      std::cerr << "[Error] could not write file '" << outfile_name << "'"
+                << std::endl;
+      return 2;
+    }
+  }
+  if (labelfile_name) {
+    lf.open(labelfile_name);
+    if (!lf.is_open()) {
+      std::cerr << "[Error] could not write file '" << labelfile_name << "'"
+                << std::endl;
+      return 2;
+    }
+  }
+  std::ostream &os = outfile_name ? of : std::cout;
+  os << "# synthetic point cloud from triplclust-gen with " << npoints
+     << " points, " << ncurves << " curves, seed " << seed << "\n";
+
+  // draw the source of each point (curve or noise) randomly with
+  // probabilities proportional to the remaining points
+  Fenwick remaining(ncurves + 1);
+  for (size_t i = 0; i < ncurves; ++i) remaining.add(i, curves[i].npoints);
+  remaining.add(ncurves, nnoise);
+  for (uint64_t left = npoints; left > 0; --left) {
+    size_t source = remaining.find(rng.integer(left));
+    remaining.add(source, -1);
+    Vec p;
+    long label;
+    if (source == ncurves) {
+      p = vec(boxsize * rng.uniform(), boxsize * rng.uniform(),
+              is2d ? 0.0 : boxsize * rng.uniform());
+      label = -1;
+    } else {
+      Curve &c = curves[source];
+      const double sigma = jitter / density;
+      p = c.point((c.next + 0.5) / c.npoints) +
+          vec(sigma * rng.gauss(), sigma * rng.gauss(),
+              is2d ? 0.0 : sigma * rng.gauss());
+      c.next++;
+      label = (long)source;
+    }
+    // sprintf is much faster than ostream formatting for large clouds
+    char buff[128];
+    int len;
+    if (is2d && thickness > 0.0)
+      len = sprintf(buff, "%.6f %.6f %.6f\n", p.x, p.y,
+                    thickness * rng.uniform());
+    else if (is2d)
+      len = sprintf(buff, "%.6f %.6f\n", p.x, p.y);
+    else
+      len = sprintf(buff, "%.6f %.6f %.6f\n", p.x, p.y, p.z);
+    os.write(buff, len);
+    if (labelfile_name) {
+      len = sprintf(buff, "%ld\n", label);
+      lf.write(buff, len);
+    }
+  }
+
+  if (outfile_name) of.close();
+  if (labelfile_name) lf.close();
+  return 0;
+}
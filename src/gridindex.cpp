@@ -0,0 +1,190 @@
+//
+// gridindex.cpp
+//     Spatial index of points in the cells of a uniform grid, into which
+//     points can be inserted and from which they can be removed, and
+//     the ring search for the nearest neighbours shared by all grids.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "gridindex.h"
+
+GridIndex::GridIndex(double cellsize, bool is2d)
+    : cellsize(cellsize), is2d(is2d), n_points(0) {}
+
+// grid coordinate of the coordinate *x*
+long grid_coordinate(double x, double cellsize) {
+  return (long)std::floor(x / cellsize);
+}
+
+GridCell GridIndex::cell(const Point &p) const {
+  GridCell c;
+  c.x = grid_coordinate(p.x, this->cellsize);
+  c.y = grid_coordinate(p.y, this->cellsize);
+  c.z = grid_coordinate(p.z, this->cellsize);
+  return c;
+}
+
+double GridIndex::get_cellsize() const { return this->cellsize; }
+
+size_t GridIndex::size() const { return this->n_points; }
+
+void GridIndex::insert(size_t id, const Point &p) {
+  GridEntry entry;
+  entry.id = id;
+  entry.x = p.x;
+  entry.y = p.y;
+  entry.z = p.z;
+  this->cells[this->cell(p)].push_back(entry);
+  this->n_points++;
+}
+
+void GridIndex::remove(size_t id, const Point &p) {
+  std::map<GridCell, std::vector<GridEntry> >::iterator it =
+      this->cells.find(this->cell(p));
+  if (it == this->cells.end()) return;
+  std::vector<GridEntry> &entries = it->second;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i].id == id) {
+      entries[i] = entries.back();
+      entries.pop_back();
+      this->n_points--;
+      break;
+    }
+  }
+  if (entries.empty()) this->cells.erase(it);
+}
+
+// squared distance between *entry* and *p*
+double squared_distance(const GridEntry &entry, const Point &p) {
+  double dx = entry.x - p.x, dy = entry.y - p.y, dz = entry.z - p.z;
+  return dx * dx + dy * dy + dz * dz;
+}
+
+//-------------------------------------------------------------------
+// Range search. All cells overlapping the bounding box of the ball are
+// tested, or all non-empty cells when there are fewer of them, which is
+// always the case for an infinite radius *r*.
+//-------------------------------------------------------------------
+void GridIndex::range(const Point &p, double r,
+                      std::vector<size_t> &result) const {
+  const double r2 = r * r;
+  result.clear();
+  long lo[3], hi[3];
+  double q[3] = {p.x, p.y, p.z};
+  const bool infinite = (r == std::numeric_limits<double>::infinity());
+  double n_range = infinite ? r : 1.0;
+  const size_t dimension = this->is2d ? 2 : 3;
+  lo[2] = hi[2] = 0;
+  for (size_t d = 0; d < dimension && !infinite; ++d) {
+    lo[d] = grid_coordinate(q[d] - r, this->cellsize);
+    hi[d] = grid_coordinate(q[d] + r, this->cellsize);
+    n_range *= (double)(hi[d] - lo[d] + 1);
+  }
+
+  std::map<GridCell, std::vector<GridEntry> >::const_iterator it;
+  if (n_range > (double)this->cells.size()) {
+    for (it = this->cells.begin(); it != this->cells.end(); ++it) {
+      const std::vector<GridEntry> &entries = it->second;
+      for (size_t i = 0; i < entries.size(); ++i) {
+        if (squared_distance(entries[i], p) <= r2)
+          result.push_back(entries[i].id);
+      }
+    }
+    return;
+  }
+  GridCell c;
+  for (c.z = lo[2]; c.z <= hi[2]; ++c.z) {
+    for (c.y = lo[1]; c.y <= hi[1]; ++c.y) {
+      for (c.x = lo[0]; c.x <= hi[0]; ++c.x) {
+        it = this->cells.find(c);
+        if (it == this->cells.end()) continue;
+        const std::vector<GridEntry> &entries = it->second;
+        for (size_t i = 0; i < entries.size(); ++i) {
+          if (squared_distance(entries[i], p) <= r2)
+            result.push_back(entries[i].id);
+        }
+      }
+    }
+  }
+}
+
+// offers the points in *entries* as neighbours of *p* to *heap*; ties
+// are broken by the identifier
+void offer_neighbours(const std::vector<GridEntry> &entries, const Point &p,
+                      NeighbourHeap &heap) {
+  for (size_t i = 0; i < entries.size(); ++i) {
+    heap.offer(squared_distance(entries[i], p), entries[i].id,
+               entries[i].id);
+  }
+}
+
+// cells of a GridIndex for ring_search
+class GridIndexRings {
+ private:
+  const GridIndex &grid;
+  const Point &p;
+  size_t visited;
+
+ public:
+  GridCell center;
+  GridIndexRings(const GridIndex &grid, const Point &p)
+      : grid(grid), p(p), visited(0), center(grid.cell(p)) {}
+  bool finished(long) const { return this->visited >= this->grid.n_points; }
+  // when the box up to the ring has more cells than there are non-empty
+  // cells, all non-empty cells from the ring on are visited instead
+  bool visit_beyond(long ring, NeighbourHeap &heap) {
+    double side = 2.0 * ring + 1.0;
+    double box_cells = this->grid.is2d ? side * side : side * side * side;
+    if (box_cells <= (double)this->grid.cells.size()) return false;
+    std::map<GridCell, std::vector<GridEntry> >::const_iterator it;
+    for (it = this->grid.cells.begin(); it != this->grid.cells.end(); ++it) {
+      const GridCell &c = it->first;
+      long dist = std::max(std::labs(c.x - this->center.x),
+                           std::max(std::labs(c.y - this->center.y),
+                                    std::labs(c.z - this->center.z)));
+      if (dist >= ring) offer_neighbours(it->second, this->p, heap);
+    }
+    return true;
+  }
+  void visit(const long *cell, NeighbourHeap &heap) {
+    GridCell c;
+    c.x = cell[0];
+    c.y = cell[1];
+    c.z = cell[2];
+    std::map<GridCell, std::vector<GridEntry> >::const_iterator it =
+        this->grid.cells.find(c);
+    if (it == this->grid.cells.end()) return;
+    offer_neighbours(it->second, this->p, heap);
+    this->visited += it->second.size();
+  }
+};
+
+//-------------------------------------------------------------------
+// k nearest neighbour search with ring_search around the cell of *p*.
+// The cells are not bounded, and 2D grids only have one layer. Ties are
+// broken by the identifier.
+//-------------------------------------------------------------------
+void GridIndex::knn(const Point &p, size_t k, std::vector<size_t> &result,
+                    std::vector<double> &distances) const {
+  result.clear();
+  distances.clear();
+  if (k == 0 || this->n_points == 0) return;
+
+  NeighbourHeap heap(k);
+  GridIndexRings rings(*this, p);
+  long center[3] = {rings.center.x, rings.center.y, rings.center.z};
+  long lo[3] = {LONG_MIN / 2, LONG_MIN / 2, LONG_MIN / 2};
+  long hi[3] = {LONG_MAX / 2, LONG_MAX / 2, LONG_MAX / 2};
+  if (this->is2d) lo[2] = hi[2] = center[2];
+  ring_search(rings, center, lo, hi, this->cellsize, heap);
+  heap.extract(result, distances);
+}
@@ -0,0 +1,158 @@
+//
+// gridindex.h
+//     Spatial index of points in the cells of a uniform grid, into which
+//     points can be inserted and from which they can be removed, and
+//     the ring search for the nearest neighbours shared by all grids.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef GRIDINDEX_H
+#define GRIDINDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "pointcloud.h"
+
+// integer coordinates of a grid cell
+struct GridCell {
+  long x, y, z;
+  friend bool operator<(const GridCell &c1, const GridCell &c2) {
+    if (c1.x != c2.x) return c1.x < c2.x;
+    if (c1.y != c2.y) return c1.y < c2.y;
+    return c1.z < c2.z;
+  }
+};
+
+// point stored in a grid cell
+struct GridEntry {
+  size_t id;
+  coord_t x, y, z;
+};
+
+// grid coordinate of the coordinate *x* for cubes with edge length *cellsize*
+long grid_coordinate(double x, double cellsize);
+
+// Candidates of a k nearest neighbour search in a grid, ordered by their
+// squared distance. Ties are broken by a *key* (the identifier or the
+// input position of the points), so that the result does not depend on
+// the order in which the cells are visited; *ref* locates the point in
+// the grid.
+class NeighbourHeap {
+ private:
+  typedef std::pair<double, std::pair<size_t, size_t> > Neighbour;
+  size_t k;
+  std::priority_queue<Neighbour> heap;
+
+ public:
+  NeighbourHeap(size_t k) : k(k) {}
+  // offers the point *ref* with squared distance *d2* and tie key *key*
+  void offer(double d2, size_t key, size_t ref) {
+    Neighbour neighbour(d2, std::make_pair(key, ref));
+    if (this->heap.size() < this->k) {
+      this->heap.push(neighbour);
+    } else if (neighbour < this->heap.top()) {
+      this->heap.pop();
+      this->heap.push(neighbour);
+    }
+  }
+  // true when the points from ring *ring* on, which are farther than
+  // (ring - 1) * cellsize, cannot be among the k nearest neighbours; a
+  // tie could still have a lower key
+  bool complete(long ring, double cellsize) const {
+    if (ring == 0 || this->heap.size() < this->k) return false;
+    double bound = (ring - 1) * cellsize;
+    return this->heap.top().first < bound * bound;
+  }
+  // empties the heap into *refs* and *distances*, sorted by distance
+  void extract(std::vector<size_t> &refs, std::vector<double> &distances) {
+    refs.resize(this->heap.size());
+    distances.resize(this->heap.size());
+    for (size_t i = this->heap.size(); i > 0; --i) {
+      refs[i - 1] = this->heap.top().second.second;
+      distances[i - 1] = this->heap.top().first;
+      this->heap.pop();
+    }
+  }
+};
+
+//-------------------------------------------------------------------
+// Ring search for the k nearest neighbours in a grid of cubes with edge
+// length *cellsize*, which is shared by GridIndex and the CellGrid of
+// "-index grid", so that both find the same neighbours. The cells are
+// visited in rings of increasing Chebyshev distance around the cell
+// *center*, clipped to the cells from *lo* to *hi*, until the heap is
+// complete. *cells* offers the points of a cell to the heap with
+// visit(cell, heap); finished(ring) is true when no points are left
+// from ring *ring* on, and visit_beyond(ring, heap) may offer all points
+// from ring *ring* on at once and return true, when this is cheaper.
+//-------------------------------------------------------------------
+template <class Cells>
+void ring_search(Cells &cells, const long center[3], const long lo[3],
+                 const long hi[3], double cellsize, NeighbourHeap &heap) {
+  for (long ring = 0; !cells.finished(ring); ++ring) {
+    if (heap.complete(ring, cellsize)) break;
+    if (cells.visit_beyond(ring, heap)) break;
+    long from[3], to[3];
+    for (size_t d = 0; d < 3; ++d) {
+      from[d] = std::max(center[d] - ring, lo[d]);
+      to[d] = std::min(center[d] + ring, hi[d]);
+    }
+    long cell[3];
+    for (cell[2] = from[2]; cell[2] <= to[2]; ++cell[2]) {
+      bool zring = (std::labs(cell[2] - center[2]) == ring);
+      for (cell[1] = from[1]; cell[1] <= to[1]; ++cell[1]) {
+        bool yzring = zring || (std::labs(cell[1] - center[1]) == ring);
+        for (cell[0] = from[0]; cell[0] <= to[0]; ++cell[0]) {
+          // inside the ring only the first and last cell of a row
+          if (!yzring && std::labs(cell[0] - center[0]) != ring) {
+            if (cell[0] < center[0] + ring) cell[0] = center[0] + ring - 1;
+            continue;
+          }
+          cells.visit(cell, heap);
+        }
+      }
+    }
+  }
+}
+
+// Grid of cubes with edge length *cellsize*. Only the non-empty cells
+// are stored, so that the extent of the points need not be known in
+// advance. For 2D points (z = 0), the grid only has one layer of cells
+// and the searches do not visit neighbouring layers.
+class GridIndex {
+ private:
+  double cellsize;
+  bool is2d;
+  size_t n_points;
+  std::map<GridCell, std::vector<GridEntry> > cells;
+  friend class GridIndexRings;
+
+ public:
+  GridIndex(double cellsize, bool is2d = false);
+  // cell containing the point *p*
+  GridCell cell(const Point &p) const;
+  double get_cellsize() const;
+  size_t size() const;
+  // adds the point *p* with the identifier *id*
+  void insert(size_t id, const Point &p);
+  // removes the point *id*, which must have been inserted at *p*
+  void remove(size_t id, const Point &p);
+  // identifiers of all points with distance <= *r* from *p* (*r* may
+  // be infinite)
+  void range(const Point &p, double r, std::vector<size_t> &result) const;
+  // identifiers of the *k* nearest neighbours of *p* and their squared
+  // distances, sorted by distance
+  void knn(const Point &p, size_t k, std::vector<size_t> &result,
+           std::vector<double> &distances) const;
+};
+
+#endif
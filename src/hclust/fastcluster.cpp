@@ -15,9 +15,10 @@
 
 // Code by Daniel Müllner
 // workaround to make it usable as a standalone version (without R)
-bool fc_isnan(double x) { return false; }
+bool fc_isnan(double x) { return x != x; }
 #include "fastcluster_dm.cpp"
 #include "fastcluster_R_dm.cpp"
+#include "fastcluster_parallel.cpp"
 
 //
 // Assigns cluster labels (0, ..., nclust-1) to the n points such
@@ -118,6 +119,11 @@ void cutree_cdist(int n, const int* merge, double* height, double cdist, int* la
 //               d20 d21 d22 d23
 //               d30 d31 d32 d33
 //   method  = cluster metric (see enum method_code)
+//   threads = number of threads for single, complete and average linkage
+//             (the result does not depend on it)
+//   min_chunk = minimum number of active clusters per thread, below which
+//             the scans are not split, because the synchronization of
+//             the threads costs more than it saves
 // Output arguments:
 //   merge   = allocated (n-1)x2 matrix (2*(n-1) array) for storing result.
 //             Result follows R hclust convention:
@@ -128,32 +134,47 @@ void cutree_cdist(int n, const int* merge, double* height, double cdist, int* la
 // Return code:
 //   0 = ok
 //   1 = invalid method
+//   2 = a dissimilarity is NaN
 //
-int hclust_fast(int n, double* distmat, int method, int* merge, double* height) {
+int hclust_fast(int n, t_float* distmat, int method, int* merge, double* height,
+                int threads, int min_chunk) {
   
-  // call appropriate culstering function
+  // call appropriate culstering function; the multithreaded cores are
+  // slower than the serial ones when they do not split any scan
   cluster_result Z2(n-1);
-  if (method == HCLUST_METHOD_SINGLE) {
-    // single link
-    MST_linkage_core(n, distmat, Z2);
-  }
-  else if (method == HCLUST_METHOD_COMPLETE) {
-    // complete link
-    NN_chain_core<METHOD_METR_COMPLETE, t_float>(n, distmat, NULL, Z2);
-  }
-  else if (method == HCLUST_METHOD_AVERAGE) {
-    // best average distance
-    double* members = new double[n];
-    for (int i=0; i<n; i++) members[i] = 1;
-    NN_chain_core<METHOD_METR_AVERAGE, t_float>(n, distmat, members, Z2);
-    delete[] members;
-  }
-  else if (method == HCLUST_METHOD_MEDIAN) {
-    // best median distance (beware: O(n^3))
-    generic_linkage<METHOD_METR_MEDIAN, t_float>(n, distmat, NULL, Z2);
-  }
-  else {
-    return 1;
+  const bool parallel = (threads > 1 && n >= 2 * min_chunk);
+  try {
+    if (method == HCLUST_METHOD_SINGLE) {
+      // single link
+      if (parallel)
+        MST_linkage_core_parallel(n, distmat, Z2, threads, min_chunk);
+      else
+        MST_linkage_core(n, distmat, Z2);
+    }
+    else if (method == HCLUST_METHOD_COMPLETE) {
+      // complete link
+      if (parallel)
+        NN_chain_core_parallel<METHOD_METR_COMPLETE, t_float>(n, distmat, NULL, Z2, threads, min_chunk);
+      else
+        NN_chain_core<METHOD_METR_COMPLETE, t_float>(n, distmat, NULL, Z2);
+    }
+    else if (method == HCLUST_METHOD_AVERAGE) {
+      // best average distance (members are freed on nan_error)
+      std::vector<t_float> members(n, 1);
+      if (parallel)
+        NN_chain_core_parallel<METHOD_METR_AVERAGE, t_float>(n, distmat, &members[0], Z2, threads, min_chunk);
+      else
+        NN_chain_core<METHOD_METR_AVERAGE, t_float>(n, distmat, &members[0], Z2);
+    }
+    else if (method == HCLUST_METHOD_MEDIAN) {
+      // best median distance (beware: O(n^3))
+      generic_linkage<METHOD_METR_MEDIAN, t_float>(n, distmat, NULL, Z2);
+    }
+    else {
+      return 1;
+    }
+  } catch (const nan_error&) {
+    return 2;
   }
   
   int* order = new int[n];
@@ -167,3 +188,33 @@ int hclust_fast(int n, double* distmat, int method, int* merge, double* height)
   
   return 0;
 }
+
+
+//
+// Single linkage hierarchical clustering without a distance matrix
+//
+// Input arguments:
+//   n       = number of observables
+//   dist    = function object computing the dissimilarities
+// Output arguments:
+//   merge   = allocated (n-1)x2 matrix (see hclust_fast)
+//   height  = allocated (n-1) array with distances at each merge step
+// Return code:
+//   0 = ok
+//   2 = a dissimilarity is NaN
+//
+int hclust_fast_nomatrix(int n, hclust_dissimilarity& dist, int* merge, double* height) {
+
+  cluster_result Z2(n-1);
+  try {
+    MST_linkage_core_vector(n, dist, Z2);
+  } catch (const nan_error&) {
+    return 2;
+  }
+
+  int* order = new int[n];
+  generate_R_dendrogram<false>(merge, height, order, Z2, n);
+  delete[] order; // only needed for visualization
+
+  return 0;
+}
@@ -10,6 +10,17 @@
 #ifndef fastclustercpp_H
 #define fastclustercpp_H
 
+// floating point type of the distance matrix (single precision when
+// compiled with -DTRIPLCLUST_FLOAT)
+#ifdef TRIPLCLUST_FLOAT
+typedef float t_float;
+#else
+typedef double t_float;
+#endif
+
+// default of the parameter *min_chunk* of hclust_fast
+#define HCLUST_MIN_CHUNK 4096
+
 //
 // Assigns cluster labels (0, ..., nclust-1) to the n points such
 // that the cluster result is split into nclust clusters.
@@ -50,6 +61,11 @@ void cutree_cdist(int n, const int* merge, double* height, double cdist, int* la
 //               d20 d21 d22 d23
 //               d30 d31 d32 d33
 //   method  = cluster metric (see enum method_code)
+//   threads = number of threads for single, complete and average linkage
+//             (the result does not depend on it)
+//   min_chunk = minimum number of active clusters per thread, below which
+//             the scans are not split, because the synchronization of
+//             the threads costs more than it saves
 // Output arguments:
 //   merge   = allocated (n-1)x2 matrix (2*(n-1) array) for storing result.
 //             Result follows R hclust convention:
@@ -60,8 +76,41 @@ void cutree_cdist(int n, const int* merge, double* height, double cdist, int* la
 // Return code:
 //   0 = ok
 //   1 = invalid method
+//   2 = a dissimilarity is NaN
+//
+int hclust_fast(int n, t_float* distmat, int method, int* merge, double* height,
+                int threads = 1, int min_chunk = HCLUST_MIN_CHUNK);
+
+//
+// Base class for computing dissimilarities on demand in hclust_fast_nomatrix.
+// Derived classes must implement the call operator returning the
+// dissimilarity between the observables i and j (starting with zero).
+//
+class hclust_dissimilarity {
+ public:
+  virtual ~hclust_dissimilarity() {}
+  virtual double operator()(int i, int j) = 0;
+};
+
 //
-int hclust_fast(int n, double* distmat, int method, int* merge, double* height);
+// Single linkage hierarchical clustering without a distance matrix.
+// The dissimilarities are computed on demand, which requires O(n) memory
+// instead of O(n^2). Each dissimilarity is computed once, when the first
+// of its two observables is added to the minimum spanning tree. The result
+// is identical to hclust_fast with HCLUST_METHOD_SINGLE.
+//
+// Input arguments:
+//   n       = number of observables
+//   dist    = function object computing the dissimilarities
+// Output arguments:
+//   merge   = allocated (n-1)x2 matrix (see hclust_fast)
+//   height  = allocated (n-1) array with distances at each merge step
+// Return code:
+//   0 = ok
+//   2 = a dissimilarity is NaN
+//
+int hclust_fast_nomatrix(int n, hclust_dissimilarity& dist, int* merge, double* height);
+
 enum hclust_fast_methods {
   HCLUST_METHOD_SINGLE = 0,
   HCLUST_METHOD_COMPLETE = 1,
@@ -0,0 +1,290 @@
+//
+// Multithreaded versions of MST_linkage_core and NN_chain_core
+//
+// The active nodes are kept in a compact sorted array instead of the
+// doubly_linked_list, so that the scans over them can be split into
+// contiguous chunks, which are processed by OpenMP threads. Each chunk
+// yields its first minimum in index order, and the chunk minima are
+// combined in chunk order. Ties are thus resolved like in the serial
+// cores, and the merges are identical.
+//
+// Copyright: triplclust contributors, 2026
+// License:   BSD style license
+//            (see the file LICENSE for details)
+//
+
+// sorted array of the active nodes
+class active_array {
+public:
+  std::vector<t_index> nodes;
+
+  // all nodes from *start* to *N*-1 are active
+  active_array(const t_index start, const t_index N) {
+    nodes.reserve(N - start);
+    for (t_index i = start; i < N; ++i) nodes.push_back(i);
+  }
+
+  void remove(const t_index idx) {
+    nodes.erase(std::lower_bound(nodes.begin(), nodes.end(), idx));
+  }
+};
+
+//
+// First minimum of value(i) for the active nodes i at the positions
+// [begin, nodes.size()) with *threads* threads, each of which scans at
+// least *min_chunk* nodes. When all values are
+// infinity, *idx* is -1. Throws nan_error when a value is NaN, like
+// the scans of the serial cores.
+//
+template <typename t_value>
+static void chunked_argmin(const std::vector<t_index>& nodes,
+                           const t_index begin, const t_value& value,
+                           const int threads, const t_index min_chunk,
+                           t_float& min, t_index& idx) {
+  const t_index n = static_cast<t_index>(nodes.size()) - begin;
+  int n_chunks = static_cast<int>(std::min<t_index>(threads, n / min_chunk));
+  if (n_chunks < 1) n_chunks = 1;
+  std::vector<t_float> chunk_min(n_chunks);
+  std::vector<t_index> chunk_idx(n_chunks);
+  // exceptions must not leave the parallel region
+  bool has_nan = false;
+
+#pragma omp parallel for num_threads(threads) schedule(static) if (n_chunks > 1) reduction(||:has_nan)
+  for (int c = 0; c < n_chunks; ++c) {
+    const t_index end = begin + n * (c + 1) / n_chunks;
+    t_float m = std::numeric_limits<t_float>::infinity();
+    t_index k = -1;
+    for (t_index p = begin + n * c / n_chunks; p < end; ++p) {
+      const t_float v = value(nodes[p]);
+      if (v < m) {
+        m = v;
+        k = nodes[p];
+      }
+      else if (fc_isnan(v))
+        has_nan = true;
+    }
+    chunk_min[c] = m;
+    chunk_idx[c] = k;
+  }
+  if (has_nan) throw nan_error();
+
+  min = std::numeric_limits<t_float>::infinity();
+  idx = -1;
+  for (int c = 0; c < n_chunks; ++c) {
+    if (chunk_min[c] < min) {
+      min = chunk_min[c];
+      idx = chunk_idx[c];
+    }
+  }
+}
+
+// distance of node i to the tree in MST_linkage_core_parallel after
+// the node *prev_node* has been added to the tree
+class mst_distance {
+private:
+  const t_index N;
+  const t_float * const D;
+  t_float * const d;
+  const t_index prev_node;
+
+public:
+  mst_distance(const t_index N_, const t_float * const D_,
+               t_float * const d_, const t_index prev_node_)
+    : N(N_), D(D_), d(d_), prev_node(prev_node_) {}
+
+  t_float operator()(const t_index i) const {
+    const t_float tmp = (i < prev_node) ? D_(i, prev_node) : D_(prev_node, i);
+    if (tmp < d[i]) d[i] = tmp;
+    else if (fc_isnan(tmp)) return tmp;  // for the check in chunked_argmin
+    return d[i];
+  }
+};
+
+static void MST_linkage_core_parallel(const t_index N, const t_float * const D,
+                                      cluster_result & Z2, const int threads,
+                                      const t_index min_chunk) {
+/*
+    Same as MST_linkage_core with *threads* threads, which split the scans
+    over at least 2 * *min_chunk* active nodes.
+*/
+  active_array active_nodes(1, N);
+  auto_array_ptr<t_float> d(N);
+  t_index idx2, prev_node;
+  t_float min;
+
+  // first iteration
+  for (t_index i=1; i<N; ++i) {
+    d[i] = D[i-1];
+  }
+  chunked_argmin(active_nodes.nodes, 0, mst_distance(N, D, d, 0), threads,
+                 min_chunk, min, idx2);
+  if (idx2 < 0) idx2 = 1;
+  Z2.append(0, idx2, min);
+
+  for (t_index j=1; j<N-1; ++j) {
+    prev_node = idx2;
+    active_nodes.remove(prev_node);
+    chunked_argmin(active_nodes.nodes, 0, mst_distance(N, D, d, prev_node),
+                   threads, min_chunk, min, idx2);
+    if (idx2 < 0) {
+      idx2 = active_nodes.nodes[0];
+      min = d[idx2];
+    }
+    Z2.append(prev_node, idx2, min);
+  }
+}
+
+// distance of node i to the node *idx* in NN_chain_core_parallel
+class row_distance {
+private:
+  const t_index N;
+  const t_float * const D;
+  const t_index idx;
+
+public:
+  row_distance(const t_index N_, const t_float * const D_, const t_index idx_)
+    : N(N_), D(D_), idx(idx_) {}
+
+  t_float operator()(const t_index i) const {
+    if (i < idx) return D_(i, idx);
+    if (i > idx) return D_(idx, i);
+    return std::numeric_limits<t_float>::infinity();
+  }
+};
+
+template <method_codes method, typename t_members>
+static void NN_chain_core_parallel(const t_index N, t_float * const D,
+                                   t_members * const members,
+                                   cluster_result & Z2, const int threads,
+                                   const t_index min_chunk) {
+/*
+    Same as NN_chain_core with *threads* threads, which split the scans
+    and updates over at least 2 * *min_chunk* active nodes.
+*/
+  if (method != METHOD_METR_SINGLE && method != METHOD_METR_COMPLETE &&
+      method != METHOD_METR_AVERAGE && method != METHOD_METR_WEIGHTED &&
+      method != METHOD_METR_WARD) {
+    throw std::runtime_error(std::string("Invalid method."));
+  }
+
+  auto_array_ptr<t_index> NN_chain(N);
+  t_index NN_chain_tip = 0;
+
+  t_index idx1, idx2, k;
+
+  t_float size1 = 0, size2 = 0;
+  active_array active_nodes(0, N);
+
+  t_float min, m;
+
+  for (t_float const * DD=D; DD!=D+(static_cast<std::ptrdiff_t>(N)*(N-1)>>1);
+       ++DD) {
+#if HAVE_DIAGNOSTIC
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+#endif
+    if (fc_isnan(*DD)) {
+      throw(nan_error());
+    }
+#if HAVE_DIAGNOSTIC
+#pragma GCC diagnostic pop
+#endif
+  }
+
+  #ifdef FE_INVALID
+  if (feclearexcept(FE_INVALID)) throw fenv_error();
+  #endif
+
+  for (t_index j=0; j<N-1; ++j) {
+    if (NN_chain_tip <= 3) {
+      NN_chain[0] = idx1 = active_nodes.nodes[0];
+      NN_chain_tip = 1;
+
+      idx2 = active_nodes.nodes[1];
+      min = D_(idx1,idx2);
+      chunked_argmin(active_nodes.nodes, 2, row_distance(N, D, idx1),
+                     threads, min_chunk, m, k);
+      if (m < min) {
+        min = m;
+        idx2 = k;
+      }
+    }  // a: idx1   b: idx2
+    else {
+      NN_chain_tip -= 3;
+      idx1 = NN_chain[NN_chain_tip-1];
+      idx2 = NN_chain[NN_chain_tip];
+      min = idx1<idx2 ? D_(idx1,idx2) : D_(idx2,idx1);
+    }  // a: idx1   b: idx2
+
+    do {
+      NN_chain[NN_chain_tip] = idx2;
+
+      // idx1 stays the nearest neighbour on ties, like in NN_chain_core
+      chunked_argmin(active_nodes.nodes, 0, row_distance(N, D, idx2),
+                     threads, min_chunk, m, k);
+      if (m < min) {
+        min = m;
+        idx1 = k;
+      }
+
+      idx2 = idx1;
+      idx1 = NN_chain[NN_chain_tip++];
+
+    } while (idx2 != NN_chain[NN_chain_tip-2]);
+
+    Z2.append(idx1, idx2, min);
+
+    if (idx1>idx2) {
+      t_index tmp = idx1;
+      idx1 = idx2;
+      idx2 = tmp;
+    }
+
+    if (method==METHOD_METR_AVERAGE ||
+        method==METHOD_METR_WARD) {
+      size1 = static_cast<t_float>(members[idx1]);
+      size2 = static_cast<t_float>(members[idx2]);
+      members[idx2] += members[idx1];
+    }
+
+    // Remove the smaller index from the valid indices (active_nodes).
+    active_nodes.remove(idx1);
+
+    // Update the distances to idx2 in the ranges [start, idx1),
+    // (idx1, idx2) and (idx2, N) at once
+    t_float s = 0, t = 0;
+    if (method==METHOD_METR_AVERAGE) {
+      s = size1/(size1+size2);
+      t = size2/(size1+size2);
+    }
+    const t_index n_active = static_cast<t_index>(active_nodes.nodes.size());
+    const t_index * const nodes = &active_nodes.nodes[0];
+#pragma omp parallel for num_threads(threads) schedule(static) if (n_active >= 2 * min_chunk)
+    for (int p = 0; p < static_cast<int>(n_active); ++p) {
+      const t_index i = nodes[p];
+      if (i == idx2) continue;
+      t_float * const b = (i < idx2) ? &D_(i, idx2) : &D_(idx2, i);
+      const t_float a = (i < idx1) ? D_(i, idx1) : D_(idx1, i);
+      switch (method) {
+      case METHOD_METR_SINGLE:
+        f_single(b, a);
+        break;
+      case METHOD_METR_COMPLETE:
+        f_complete(b, a);
+        break;
+      case METHOD_METR_AVERAGE:
+        f_average(b, a, s, t);
+        break;
+      case METHOD_METR_WEIGHTED:
+        f_weighted(b, a);
+        break;
+      default:
+        f_ward(b, a, min, size1, size2, static_cast<t_float>(members[i]));
+        break;
+      }
+    }
+  }
+  #ifdef FE_INVALID
+  if (fetestexcept(FE_INVALID)) throw fenv_error();
+  #endif
+}
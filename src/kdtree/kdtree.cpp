@@ -188,6 +188,7 @@ KdTree::KdTree(const KdNodeVector* nodes, int distance_type /*=2*/) {
   distance = NULL;
   this->distance_type = -1;
   set_distance(distance_type);
+  epsilon = 0.0;
   // compute global bounding box
   lobound = nodes->begin()->point;
   upbound = nodes->begin()->point;
@@ -216,6 +217,25 @@ void KdTree::set_distance(int distance_type,
   }
 }
 
+//--------------------------------------------------------------
+// approximate search with factor (1 + *epsilon*): the k nearest
+// neighbors are at most by this factor farther away than the exact
+// ones, and the range search can miss points that are farther away
+// than r/(1 + epsilon). Zero means exact search (default).
+//--------------------------------------------------------------
+void KdTree::set_epsilon(double epsilon) { this->epsilon = epsilon; }
+
+double KdTree::get_epsilon() const { return this->epsilon; }
+
+// distance bound *dist* shrunk by the approximation factor; squared
+// Euklidean distances must be shrunk by the squared factor
+double KdTree::approximate_distance(double dist) const {
+  if (epsilon <= 0.0) return dist;
+  double factor = 1.0 + epsilon;
+  if (distance_type == 2) factor *= factor;
+  return dist / factor;
+}
+
 //--------------------------------------------------------------
 // recursive build of tree
 // "a" and "b"-1 are the lower and upper indices
@@ -270,7 +290,6 @@ void KdTree::k_nearest_neighbors(const CoordPoint& point, size_t k,
   size_t i;
   double d, temp_dist;
   KdNode temp;
-  searchpredicate = pred;
 
   result->clear();
   if (k < 1) return;
@@ -287,12 +306,12 @@ void KdTree::k_nearest_neighbors(const CoordPoint& point, size_t k,
     // when more neighbors asked than nodes in tree, return everything
     k = allnodes.size();
     for (i = 0; i < k; i++) {
-      if (!(searchpredicate && !(*searchpredicate)(allnodes[i])))
+      if (!(pred && !(*pred)(allnodes[i])))
         neighborheap->push(
             nn4heap(i, distance->distance(allnodes[i].point, point)));
     }
   } else {
-    neighbor_search(point, root, k, neighborheap);
+    neighbor_search(point, root, k, neighborheap, pred);
   }
 
   // copy over result sorted by distance
@@ -355,14 +374,17 @@ void KdTree::range_nearest_neighbors(const CoordPoint& point, double r,
 //--------------------------------------------------------------
 // recursive function for nearest neighbor search in subtree
 // under *node*. Stores result in *neighborheap*.
-// returns "true" when no nearer neighbor elsewhere possible
+// returns "true" when no nearer neighbor elsewhere possible.
+// The search predicate *pred* is passed on instead of stored in the
+// tree, so that several threads can search the same tree.
 //--------------------------------------------------------------
 bool KdTree::neighbor_search(const CoordPoint& point, kdtree_node* node,
-                             size_t k, SearchQueue* neighborheap) {
+                             size_t k, SearchQueue* neighborheap,
+                             KdNodePredicate* pred) {
   double curdist, dist;
 
   curdist = distance->distance(point, node->point);
-  if (!(searchpredicate && !(*searchpredicate)(allnodes[node->dataindex]))) {
+  if (!(pred && !(*pred)(allnodes[node->dataindex]))) {
     if (neighborheap->size() < k) {
       neighborheap->push(nn4heap(node->dataindex, curdist));
     } else if (curdist < neighborheap->top().distance) {
@@ -373,26 +395,31 @@ bool KdTree::neighbor_search(const CoordPoint& point, kdtree_node* node,
   // first search on side closer to point
   if (point[node->cutdim] < node->point[node->cutdim]) {
     if (node->loson)
-      if (neighbor_search(point, node->loson, k, neighborheap)) return true;
+      if (neighbor_search(point, node->loson, k, neighborheap, pred))
+        return true;
   } else {
     if (node->hison)
-      if (neighbor_search(point, node->hison, k, neighborheap)) return true;
+      if (neighbor_search(point, node->hison, k, neighborheap, pred))
+        return true;
   }
   // second search on farther side, if necessary
   if (neighborheap->size() < k) {
     dist = std::numeric_limits<double>::max();
   } else {
-    dist = neighborheap->top().distance;
+    dist = approximate_distance(neighborheap->top().distance);
   }
   if (point[node->cutdim] < node->point[node->cutdim]) {
     if (node->hison && bounds_overlap_ball(point, dist, node->hison))
-      if (neighbor_search(point, node->hison, k, neighborheap)) return true;
+      if (neighbor_search(point, node->hison, k, neighborheap, pred))
+        return true;
   } else {
     if (node->loson && bounds_overlap_ball(point, dist, node->loson))
-      if (neighbor_search(point, node->loson, k, neighborheap)) return true;
+      if (neighbor_search(point, node->loson, k, neighborheap, pred))
+        return true;
   }
 
-  if (neighborheap->size() == k) dist = neighborheap->top().distance;
+  if (neighborheap->size() == k)
+    dist = approximate_distance(neighborheap->top().distance);
   return ball_within_bounds(point, dist, node);
 }
 
@@ -403,13 +430,16 @@ bool KdTree::neighbor_search(const CoordPoint& point, kdtree_node* node,
 void KdTree::range_search(const CoordPoint& point, kdtree_node* node,
                           double r, std::vector<size_t>* range_result) {
   double curdist = distance->distance(point, node->point);
+  double bound = approximate_distance(r);
   if (curdist <= r) {
     range_result->push_back(node->dataindex);
   }
-  if (node->loson != NULL && this->bounds_overlap_ball(point, r, node->loson)) {
+  if (node->loson != NULL &&
+      this->bounds_overlap_ball(point, bound, node->loson)) {
     range_search(point, node->loson, r, range_result);
   }
-  if (node->hison != NULL && this->bounds_overlap_ball(point, r, node->hison)) {
+  if (node->hison != NULL &&
+      this->bounds_overlap_ball(point, bound, node->hison)) {
     range_search(point, node->hison, r, range_result);
   }
 }
@@ -17,7 +17,12 @@
 
 namespace Kdtree {
 
+// coordinates are single precision when compiled with -DTRIPLCLUST_FLOAT
+#ifdef TRIPLCLUST_FLOAT
+typedef std::vector<float> CoordPoint;
+#else
 typedef std::vector<double> CoordPoint;
+#endif
 typedef std::vector<double> DoubleVector;
 
 // for passing points to the constructor of kdtree
@@ -78,7 +83,8 @@ class KdTree {
   CoordPoint lobound, upbound;
   // helper variable to check the distance method
   int distance_type;
-  bool neighbor_search(const CoordPoint& point, kdtree_node* node, size_t k, SearchQueue* neighborheap);
+  bool neighbor_search(const CoordPoint& point, kdtree_node* node, size_t k,
+                       SearchQueue* neighborheap, KdNodePredicate* pred);
   void range_search(const CoordPoint& point, kdtree_node* node, double r, std::vector<size_t>* range_result);
   bool bounds_overlap_ball(const CoordPoint& point, double dist,
                            kdtree_node* node);
@@ -86,8 +92,9 @@ class KdTree {
                           kdtree_node* node);
   // class implementing the distance computation
   DistanceMeasure* distance;
-  // search predicate in knn searches
-  KdNodePredicate* searchpredicate;
+  // approximation factor of the searches
+  double epsilon;
+  double approximate_distance(double dist) const;
 
  public:
   KdNodeVector allnodes;
@@ -97,6 +104,10 @@ class KdTree {
   KdTree(const KdNodeVector* nodes, int distance_type = 2);
   ~KdTree();
   void set_distance(int distance_type, const DoubleVector* weights = NULL);
+  // approximate searches only visit subtrees that can contain points
+  // closer than the current bound divided by (1 + epsilon)
+  void set_epsilon(double epsilon);
+  double get_epsilon() const;
   void k_nearest_neighbors(const CoordPoint& point, size_t k,
                            KdNodeVector* result,
                            std::vector<double>* distances,
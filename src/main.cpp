@@ -7,23 +7,28 @@
 // License: see ../LICENSE
 //
 
-#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "cluster.h"
-#include "dnn.h"
-#include "graph.h"
 #include "option.h"
+#include "outofcore.h"
 #include "output.h"
+#include "pipeline.h"
 #include "pointcloud.h"
+#include "stats.h"
+#include "stream.h"
 
 // usage message
 const char *usage =
     "Usage:\n"
     "\ttriplclust [options] <infile>\n"
+    "\ttriplclust recut [options] <dendrogram file>\n"
+    "\t               (only -t, -m, -dmax and output options are used)\n"
     "Options (defaults in brackets):\n"
     "\t-r <radius>    radius for point smoothing [2dNN]\n"
     "\t               (can be numeric or multiple of dNN)\n"
@@ -31,30 +36,119 @@ const char *usage =
     "\t-n <n>         number of the best triplets to use [2]\n"
     "\t-a <alpha>     maximum value for the angle between the\n"
     "\t               triplet branches [0.03]\n"
+    "\t               (-k, -n, -a can be comma separated lists for a\n"
+    "\t               parameter sweep over all combinations)\n"
+    "\t-knn-eps <eps> approximate the k nearest neighbours of the triplets\n"
+    "\t               up to a factor 1+eps in distance [0]\n"
+    "\t-index <type>  spatial index for the neighbour searches [kdtree]\n"
+    "\t               (can be 'kdtree', 'grid' (uniform grid of cells)\n"
+    "\t               or 'auto' (chooses from the point distribution))\n"
+    "\t-dnn-sample <n>\n"
+    "\t               estimate dNN from <n> random points [all points]\n"
     "\t-s <scale>     scalingfactor for clustering [0.33dNN]\n"
     "\t               (can be numeric or multiple of dNN)\n"
     "\t-t <dist>      best cluster distance [auto]\n"
-    "\t               (can be numeric or 'auto')\n"
+    "\t               (can be numeric or 'auto', or a comma separated\n"
+    "\t               list thereof, e.g. '5,8,auto', which yields one\n"
+    "\t               result column or file <prefix>_t<dist>.csv each)\n"
     "\t-m <n>         minimum number of triplets for a cluster [5]\n"
+    "\t-isolated <dist>\n"
+    "\t               remove triplets without other triplet closer than\n"
+    "\t               <dist> before clustering [none] (can be numeric or\n"
+    "\t               't' for the largest -t; exact for numeric -t up to\n"
+    "\t               <dist>, a heuristic for -t auto)\n"
     "\t-dmax <n>      max gapwidth within a triplet [none]\n"
     "\t               (can be numeric, multiple of dNN or 'none')\n"
     "\t-link <method> linkage method for clustering [single]\n"
     "\t               (can be 'single', 'complete', 'average')\n"
+    "\t-engine <name> algorithm for the dendrogram computation [auto]\n"
+    "\t               (can be 'matrix' (stores distance matrix),\n"
+    "\t               'matrixfree' (only single linkage), 'disk' (stores\n"
+    "\t               distance matrix in a file in -matrixdir), 'graph'\n"
+    "\t               (only single linkage with numeric -t, no dendrogram)\n"
+    "\t               or 'auto')\n"
+    "\t-membudget <bytes>\n"
+    "\t               memory limit for clustering (suffix K,M,G possible);\n"
+    "\t               'auto' engine switches to 'graph' (numeric -t) or\n"
+    "\t               'matrixfree' for single linkage if needed,\n"
+    "\t               or to 'disk' for other linkages with -matrixdir\n"
+    "\t-matrixdir <dir>\n"
+    "\t               directory for the memory-mapped distance matrix\n"
+    "\t               file of the engine 'disk'\n"
+    "\t-threads <n>   number of threads for dNN, the distance matrix and\n"
+    "\t               the dendrogram of the engines 'matrix' and 'disk',\n"
+    "\t               or number of tiles clustered at the same time [1]\n"
+    "\t-threads-chunk <n>\n"
+    "\t               minimum number of active clusters per thread in the\n"
+    "\t               dendrogram computation [4096]\n"
+    "\t-dry-run       only print memory estimate, do not cluster\n"
+    "\t-dedup         collapse identical points before and after smoothing\n"
+    "\t-voxel <size>  cluster one weighted point per cube of edge length\n"
+    "\t               <size> and label all points in the cube alike [none]\n"
+    "\t               (can be numeric or multiple of dNN)\n"
+    "\t-tile <size>   cluster in tiles of edge length <size> [none]\n"
+    "\t               (can be numeric or multiple of dNN)\n"
+    "\t-overlap <width>\n"
+    "\t               overlap of the tiles on all sides [20dNN]\n"
+    "\t-outofcore <dir>\n"
+    "\t               do not load the cloud into memory, but process the\n"
+    "\t               tiles of -tile from temporary files in <dir>\n"
     "\t-ordered       interpret infile as ordered\n"
     "\t               (i.e. points are in chronological order)\n"
+    "\t-owindow <n>   only use neighbours whose position in an ordered\n"
+    "\t               infile differs by at most <n> for triplets [none]\n"
+    "\t-window <n>    cluster incrementally in a sliding window of the\n"
+    "\t               last <n> points of an ordered stream [none]\n"
+    "\t-step <n>      number of points by which the window is moved\n"
+    "\t               [window/10]\n"
     "\t-oprefix <prefix>\n"
     "\t               write result not to stdout, but to <prefix>.csv\n"
     "\t               and (if -gnuplot is set) to <prefix>.gnuplot\n"
     "\t-gnuplot       print result as a gnuplot command\n"
     "\t-delim <char>  single char delimiter for csv input [' ']\n"
     "\t-skip <n>      number of lines skipped at head of infile [0]\n"
+    "\t-savedendro <file>\n"
+    "\t               save the dendrogram for a later 'recut'\n"
+    "\t-cache <dir>   store the results of all steps in <dir> and reuse\n"
+    "\t               them in later runs with the same input and parameters\n"
+    "\t-stats <file>  write run times and counters of all steps\n"
+    "\t               as JSON to <file>\n"
     "\t-v             be verbose\n"
     "\t-vv            be more verbose and write debug trace files\n"
     "Version:\n"
-    "\t1.4 from 2024-02-16";
+    "\t" TRIPLCLUST_VERSION " (not yet released)";
+
+//-------------------------------------------------------------------
+// Writes the clustering *cl_group* of *cloud* to <prefix>.csv and
+// (if *gnuplot* is set) to <prefix>.gnuplot.
+//-------------------------------------------------------------------
+void write_result(const PointCloud &cloud, const cluster_group &cl_group,
+                  const char *prefix, bool gnuplot) {
+  // redirect cout to outfile
+  std::streambuf *backup = std::cout.rdbuf();
+  std::ofstream of;
+  of.open((std::string(prefix) + ".csv").c_str());
+  // replace the stream buffer from cout with the stream buffer from the
+  // opened file, so that everythin printed to cout is printed to the file.
+  std::cout.rdbuf(of.rdbuf());
+  clusters_to_csv(cloud);
+  of.close();
+  if (gnuplot) {
+    of.open((std::string(prefix) + ".gnuplot").c_str());
+    clusters_to_gnuplot(cloud, cl_group);
+    of.close();
+  }
+  // restore cout's default stream buffer
+  std::cout.rdbuf(backup);
+}
 
 int main(int argc, char **argv) {
-  // parse commandline
+  // parse commandline; in recut mode, the first argument is "recut"
+  bool recut = (argc > 1 && 0 == strcmp(argv[1], "recut"));
+  if (recut) {
+    --argc;
+    ++argv;
+  }
   Opt opt_params;
   if (opt_params.parse_args(argc, argv) != 0) {
     std::cerr << usage << std::endl;
@@ -62,7 +156,7 @@ int main(int argc, char **argv) {
   }
   const char *infile_name = opt_params.get_ifname();
   const char *outfile_prefix = opt_params.get_ofprefix();
-  int opt_verbose = opt_params.get_verbosity();
+  const char *stats_file = opt_params.get_statsfile();
   bool opt_ordered = opt_params.get_ordered();
 
   // plausibility checks
@@ -70,117 +164,249 @@ int main(int argc, char **argv) {
     std::cerr << "[Error] no infile given!\n" << usage << std::endl;
     return 1;
   }
+  bool sweep = (!recut && (opt_params.get_n_kvalues() > 1 ||
+                           opt_params.get_n_nvalues() > 1 ||
+                           opt_params.get_n_avalues() > 1));
+  if (sweep && opt_params.get_dendrofile()) {
+    std::cerr << "[Error] -savedendro cannot be used with several values "
+              << "for -k, -n or -a" << std::endl;
+    return 1;
+  }
+  // a saved dendrogram would only contain the representatives
+  bool collapse = (opt_params.get_voxel() > 0 || opt_params.is_dedup());
+  if (collapse && (recut || opt_params.get_dendrofile())) {
+    std::cerr << "[Error] -voxel and -dedup cannot be used with recut or "
+              << "-savedendro" << std::endl;
+    return 1;
+  }
+  // with several results, gnuplot output requires files
+  bool multiple = (sweep || opt_params.get_n_thresholds() > 1);
+  if (multiple && opt_params.is_gnuplot() && !outfile_prefix) {
+    std::cerr << "[Error] -gnuplot with several values for -k, -n, -a or -t"
+              << " requires -oprefix" << std::endl;
+    return 1;
+  }
 
-  // load data
-  PointCloud cloud_xyz;
-  cloud_xyz.setOrdered(opt_ordered);
-  
-  try {
-    load_csv_file(infile_name, cloud_xyz, opt_params.get_delimiter(),
-                  opt_params.get_skip());
-  } catch (const std::invalid_argument &e) {
-    std::cerr << "[Error] in file'" << infile_name << "': " << e.what()
+  // out-of-core mode only supports a single result in the csv format
+  const char *outofcore_dir = opt_params.get_outofcoredir();
+  if (outofcore_dir &&
+      (recut || multiple || opt_params.is_gnuplot() ||
+       opt_params.get_dendrofile() || opt_params.get_cachedir() ||
+       opt_params.is_dryrun() || collapse ||
+       opt_params.get_dnn_sample() > 0)) {
+    std::cerr << "[Error] -outofcore cannot be used with recut, several "
+              << "values for -k, -n, -a or -t, -gnuplot, -savedendro, "
+              << "-cache, -dry-run, -voxel, -dedup or -dnn-sample"
               << std::endl;
-    return 2;
+    return 1;
   }
-#ifdef WEBDEMO
-  // maximum pointcloud size error for webdemo
-  catch (const std::length_error &e) {
-    std::cerr << "[Error] in file'" << infile_name << "': " << e.what()
-              << std::endl;
-    return 3;
+  if (outofcore_dir && opt_params.get_tile() <= 0) {
+    std::cerr << "[Error] -outofcore requires -tile" << std::endl;
+    return 1;
   }
-#endif
-  catch (const std::exception &e) {
-    std::cerr << "[Error] cannot read infile '" << infile_name << "'! "
-              << e.what() << std::endl;
-    return 2;
+
+  // the matrix file is only needed for clustering the whole cloud
+  if (opt_params.get_engine() == ENGINE_DISK) {
+    if (!opt_params.get_matrixdir()) {
+      std::cerr << "[Error] engine 'disk' requires -matrixdir" << std::endl;
+      return 1;
+    }
+    if (opt_params.get_tile() > 0) {
+      std::cerr << "[Error] engine 'disk' cannot be used with -tile"
+                << std::endl;
+      return 1;
+    }
   }
-  if (cloud_xyz.size() == 0) {
-    std::cerr << "[Error] empty cloud in file '" << infile_name << "'"
-              << std::endl
-              << "maybe you used the wrong delimiter" << std::endl;
-    return 2;
+
+  // isolated triplets are only removed when clustering the whole cloud
+  if (opt_params.get_isolated() > 0.0 || opt_params.is_isolated_t()) {
+    for (size_t i = 0; i < opt_params.get_n_thresholds(); ++i) {
+      if (opt_params.is_isolated_t() && opt_params.is_tauto(i)) {
+        std::cerr << "[Error] -isolated t requires a numeric -t"
+                  << std::endl;
+        return 1;
+      }
+    }
+    if (opt_params.get_tile() > 0 || opt_params.get_window() > 0) {
+      std::cerr << "[Error] -isolated cannot be used with -tile or -window"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  // the connected components only yield the clusters at fixed thresholds
+  if (opt_params.get_engine() == ENGINE_GRAPH) {
+    bool tauto = false;
+    for (size_t i = 0; i < opt_params.get_n_thresholds(); ++i) {
+      if (opt_params.is_tauto(i)) tauto = true;
+    }
+    if (tauto || opt_params.get_linkage() != SINGLE) {
+      std::cerr << "[Error] engine 'graph' requires a numeric -t and "
+                << "single linkage" << std::endl;
+      return 1;
+    }
+    if (opt_params.get_dendrofile() || opt_params.get_tile() > 0) {
+      std::cerr << "[Error] engine 'graph' cannot be used with -savedendro "
+                << "or -tile" << std::endl;
+      return 1;
+    }
+  }
+
+  if (opt_params.get_owindow() > 0 && !opt_ordered) {
+    std::cerr << "[Error] -owindow requires -ordered" << std::endl;
+    return 1;
   }
 
-  // compute characteristic length dnn if needed
-  if (opt_params.needs_dnn()) {
-    double dnn = std::sqrt(first_quartile(cloud_xyz));
-    if (opt_verbose > 0) {
-      std::cout << "[Info] computed dnn: " << dnn << std::endl;
+  // streaming mode only supports fixed single linkage clusters
+  if (opt_params.get_window() > 0) {
+    if (!opt_ordered) {
+      std::cerr << "[Error] -window requires -ordered" << std::endl;
+      return 1;
     }
-    opt_params.set_dnn(dnn);
-    if (dnn == 0.0) {
-      std::cerr << "[Error] dnn computed as zero. "
-                << "Suggestion: remove doublets, e.g. with 'sort -u'"
+    if (opt_params.get_window() < opt_params.get_k() + 1) {
+      std::cerr << "[Error] -window must hold at least k+1 points"
+                << std::endl;
+      return 1;
+    }
+    if (opt_params.get_step() > opt_params.get_window()) {
+      std::cerr << "[Error] -step must not be larger than -window"
+                << std::endl;
+      return 1;
+    }
+    if (opt_params.is_tauto() || opt_params.get_linkage() != SINGLE ||
+        opt_params.is_dmax()) {
+      std::cerr << "[Error] -window requires a numeric -t, single linkage "
+                << "and no -dmax" << std::endl;
+      return 1;
+    }
+    if (recut || multiple || opt_params.is_gnuplot() ||
+        opt_params.get_dendrofile() || opt_params.get_cachedir() ||
+        opt_params.is_dryrun() || opt_params.get_tile() > 0 ||
+        outofcore_dir || opt_params.get_owindow() > 0 ||
+        opt_params.get_knn_eps() > 0.0 || collapse ||
+        opt_params.get_dnn_sample() > 0) {
+      std::cerr << "[Error] -window cannot be used with recut, several "
+                << "values for -k, -n, -a or -t, -gnuplot, -savedendro, "
+                << "-cache, -dry-run, -tile, -outofcore, -owindow, "
+                << "-knn-eps, -voxel, -dedup or -dnn-sample" << std::endl;
+      return 1;
+    }
+  }
+
+  // run time statistics
+  Stats stats;
+  stats.start("total");
+
+  if (opt_params.get_window() > 0) {
+    int rc = run_stream(opt_params, stats);
+    if (rc != 0) {
+      return rc;
+    }
+    stats.stop("total");
+    if (stats_file && !stats.to_json(stats_file, infile_name)) {
+      return 2;
+    }
+    return 0;
+  }
+
+  if (outofcore_dir) {
+    int rc = run_outofcore(opt_params, stats);
+    if (rc != 0) {
+      return rc;
+    }
+    stats.stop("total");
+    if (stats_file && !stats.to_json(stats_file, infile_name)) {
+      return 2;
+    }
+    return 0;
+  }
+
+  PointCloud cloud_xyz;
+  std::vector<PipelineResult> results;
+  if (recut) {
+    // load cloud and dendrogram and only do step 4)
+    int rc = run_recut(infile_name, cloud_xyz, opt_params, results, stats);
+    if (rc != 0) {
+      return rc;
+    }
+  } else {
+    // load data
+    cloud_xyz.setOrdered(opt_ordered);
+
+    stats.start("load");
+    try {
+      load_csv_file(infile_name, cloud_xyz, opt_params.get_delimiter(),
+                    opt_params.get_skip());
+    } catch (const std::invalid_argument &e) {
+      std::cerr << "[Error] in file'" << infile_name << "': " << e.what()
+                << std::endl;
+      return 2;
+    }
+#ifdef WEBDEMO
+    // maximum pointcloud size error for webdemo
+    catch (const std::length_error &e) {
+      std::cerr << "[Error] in file'" << infile_name << "': " << e.what()
                 << std::endl;
       return 3;
     }
+#endif
+    catch (const std::exception &e) {
+      std::cerr << "[Error] cannot read infile '" << infile_name << "'! "
+                << e.what() << std::endl;
+      return 2;
+    }
+    stats.stop("load");
+    stats.set_count("points", cloud_xyz.size());
+    if (cloud_xyz.size() == 0) {
+      std::cerr << "[Error] empty cloud in file '" << infile_name << "'"
+                << std::endl
+                << "maybe you used the wrong delimiter" << std::endl;
+      return 2;
+    }
+
+    // Steps 1) to 4) of the algorithm
+    int rc = run_pipeline(cloud_xyz, opt_params, results, stats);
+    if (rc != 0 || opt_params.is_dryrun()) {
+      return rc;
+    }
   }
 
-  // Step 1) smoothing by position averaging of neighboring points
-  PointCloud cloud_xyz_smooth;
-  smoothen_cloud(cloud_xyz, cloud_xyz_smooth, opt_params.get_r());
-
-  if (opt_verbose > 1) {
-    bool rc;
-    rc = cloud_to_csv(cloud_xyz_smooth);
-    if (!rc)
-      std::cerr << "[Error] can't write debug_smoothed.csv" << std::endl;
-    rc = debug_gnuplot(cloud_xyz, cloud_xyz_smooth);
-    if (!rc)
-      std::cerr << "[Error] can't write debug_smoothed.gnuplot" << std::endl;
-  }
-
-  // Step 2) finding triplets of approximately collinear points
-  std::vector<triplet> triplets;
-  generate_triplets(cloud_xyz_smooth, triplets, opt_params.get_k(),
-                    opt_params.get_n(), opt_params.get_a());
-
-  // Step 3) single link hierarchical clustering of the triplets
-  cluster_group cl_group;
-  compute_hc(cloud_xyz_smooth, cl_group, triplets, opt_params.get_s(),
-             opt_params.get_t(), opt_params.is_tauto(), opt_params.get_dmax(),
-             opt_params.is_dmax(), opt_params.get_linkage(), opt_verbose);
-
-  // Step 4) pruning by removal of small clusters ...
-  cleanup_cluster_group(cl_group, opt_params.get_m(), opt_verbose);
-  cluster_triplets_to_points(triplets, cl_group);
-  // .. and (optionally) by splitting up clusters at gaps > dmax
-  if (opt_params.is_dmax()) {
-    cluster_group cleaned_up_cluster_group;
-    for (cluster_group::iterator cl = cl_group.begin(); cl != cl_group.end();
-         ++cl) {
-      max_step(cleaned_up_cluster_group, *cl, cloud_xyz, opt_params.get_dmax(),
-               opt_params.get_m() + 2);
-    }
-    cl_group = cleaned_up_cluster_group;
-  }
-
-  // store cluster labels in points
-  add_clusters(cloud_xyz, cl_group, opt_params.is_gnuplot());
-
-  if (outfile_prefix) {
-    // redirect cout to outfile if requested
-    std::streambuf *backup = std::cout.rdbuf();
-    std::ofstream of;
-    of.open((std::string(outfile_prefix) + ".csv").c_str());
-    // replace the stream buffer from cout with the stream buffer from the
-    // opened file, so that everythin printed to cout is printed to the file.
-    std::cout.rdbuf(of.rdbuf());
-    clusters_to_csv(cloud_xyz);
-    of.close();
-    if (opt_params.is_gnuplot()) {
-      of.open((std::string(outfile_prefix) + ".gnuplot").c_str());
-      clusters_to_gnuplot(cloud_xyz, cl_group);
-      of.close();
+  stats.start("output");
+  if (multiple) {
+    // one result per parameter combination, either as column or as file
+    std::vector<PointCloud> clouds(results.size(), cloud_xyz);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < results.size(); ++i) {
+      names.push_back(results[i].name);
+      add_clusters(clouds[i], results[i].clusters, opt_params.is_gnuplot());
+      if (outfile_prefix) {
+        std::string prefix = std::string(outfile_prefix) + results[i].suffix;
+        write_result(clouds[i], results[i].clusters, prefix.c_str(),
+                     opt_params.is_gnuplot());
+      }
+    }
+    if (!outfile_prefix) {
+      clusters_to_csv(clouds, names);
     }
-    // restore cout's default stream buffer
-    std::cout.rdbuf(backup);
-  } else if (opt_params.is_gnuplot()) {
-    clusters_to_gnuplot(cloud_xyz, cl_group);
   } else {
-    clusters_to_csv(cloud_xyz);
+    // store cluster labels in points
+    cluster_group &cl_group = results[0].clusters;
+    add_clusters(cloud_xyz, cl_group, opt_params.is_gnuplot());
+
+    if (outfile_prefix) {
+      write_result(cloud_xyz, cl_group, outfile_prefix,
+                   opt_params.is_gnuplot());
+    } else if (opt_params.is_gnuplot()) {
+      clusters_to_gnuplot(cloud_xyz, cl_group);
+    } else {
+      clusters_to_csv(cloud_xyz);
+    }
+  }
+  stats.stop("output");
+  stats.stop("total");
+
+  if (stats_file && !stats.to_json(stats_file, infile_name)) {
+    return 2;
   }
 
   return 0;
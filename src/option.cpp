@@ -7,17 +7,27 @@
 // License: see ../LICENSE
 //
 
+#include <algorithm>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
+#include "hclust/fastcluster.h"
 #include "option.h"
 
 // initialize default values
 Opt::Opt() {
   this->infile_name = NULL;
   this->outfile_prefix = NULL;
+  this->stats_file = NULL;
+  this->dendro_file = NULL;
+  this->cache_dir = NULL;
+  this->outofcore_dir = NULL;
+  this->matrix_dir = NULL;
   this->gnuplot = false;
   this->delimiter = ' ';
   this->skip = 0;
@@ -42,6 +52,26 @@ Opt::Opt() {
   this->dmax_dnn = false;
   this->ordered = false;
   this->link = SINGLE;
+  this->engine = ENGINE_AUTO;
+  this->membudget = 0.0;
+  this->dryrun = false;
+  this->dedup = false;
+  this->voxel = 0.0;
+  this->voxel_dnn = false;
+  this->tile = 0.0;
+  this->tile_dnn = false;
+  this->overlap = 20;
+  this->overlap_dnn = true;
+  this->window = 0;
+  this->step = 0;
+  this->owindow = 0;
+  this->knn_eps = 0.0;
+  this->dnn_sample = 0;
+  this->threads = 1;
+  this->threads_chunk = HCLUST_MIN_CHUNK;
+  this->isolated = 0.0;
+  this->isolated_t = false;
+  this->index = INDEX_KDTREE;
 
   this->m = 5;
 }
@@ -79,7 +109,12 @@ int Opt::parse_args(int argc, char** argv) {
       } else if (0 == strcmp(argv[i], "-k")) {
         ++i;
         if (i < argc) {
-          this->k = (int)stod(argv[i]);
+          // comma separated list for a parameter sweep
+          std::vector<double> values = this->parse_list(argv[i]);
+          this->k_values.clear();
+          for (size_t j = 0; j < values.size(); ++j)
+            this->k_values.push_back((size_t)(int)values[j]);
+          this->k = this->k_values[0];
         } else {
           return 1;
         }
@@ -88,27 +123,43 @@ int Opt::parse_args(int argc, char** argv) {
       } else if (0 == strcmp(argv[i], "-n")) {
         ++i;
         if (i < argc) {
-          this->n = (int)stod(argv[i]);
+          // comma separated list for a parameter sweep
+          std::vector<double> values = this->parse_list(argv[i]);
+          this->n_values.clear();
+          for (size_t j = 0; j < values.size(); ++j)
+            this->n_values.push_back((size_t)(int)values[j]);
+          this->n = this->n_values[0];
         } else {
           return 1;
         }
       } else if (0 == strcmp(argv[i], "-a")) {
         ++i;
         if (i < argc) {
-          this->a = stod(argv[i]);
+          // comma separated list for a parameter sweep
+          std::vector<double> values = this->parse_list(argv[i]);
+          this->a_values = values;
+          this->a = values[0];
         } else {
           return 1;
         }
       } else if (0 == strcmp(argv[i], "-t")) {
         ++i;
         if (i < argc) {
-          if (strcmp(argv[i], "auto") == 0 ||
-              strcmp(argv[i], "automatic") == 0) {
-            this->tauto = true;
-          } else {
-            this->t = stod(argv[i]);
-            this->tauto = false;
+          // comma separated list of thresholds
+          std::vector<std::string> values;
+          split(argv[i], values, ',');
+          if (values.empty()) return 1;
+          this->thresholds.clear();
+          for (size_t j = 0; j < values.size(); ++j) {
+            if (values[j] == "auto" || values[j] == "automatic") {
+              this->thresholds.push_back(std::pair<double, bool>(0.0, true));
+            } else {
+              this->thresholds.push_back(
+                  std::pair<double, bool>(stod(values[j].c_str()), false));
+            }
           }
+          this->t = this->thresholds[0].first;
+          this->tauto = this->thresholds[0].second;
         } else {
           return 1;
         }
@@ -160,6 +211,188 @@ int Opt::parse_args(int argc, char** argv) {
                     << std::endl;
           return 1;
         }
+      } else if (0 == strcmp(argv[i], "-engine")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        if (strcmp(argv[i], "auto") == 0) {
+          this->engine = ENGINE_AUTO;
+        } else if (strcmp(argv[i], "matrix") == 0) {
+          this->engine = ENGINE_MATRIX;
+        } else if (strcmp(argv[i], "matrixfree") == 0) {
+          this->engine = ENGINE_MATRIXFREE;
+        } else if (strcmp(argv[i], "disk") == 0) {
+          this->engine = ENGINE_DISK;
+        } else if (strcmp(argv[i], "graph") == 0) {
+          this->engine = ENGINE_GRAPH;
+        } else {
+          std::cerr << "[Error] " << argv[i] << " is not a valide option!"
+                    << std::endl;
+          return 1;
+        }
+      } else if (0 == strcmp(argv[i], "-membudget")) {
+        ++i;
+        if (i < argc) {
+          this->membudget = this->parse_bytes(argv[i]);
+        } else {
+          return 1;
+        }
+      } else if (0 == strcmp(argv[i], "-dry-run")) {
+        this->dryrun = true;
+      } else if (0 == strcmp(argv[i], "-dedup")) {
+        this->dedup = true;
+      } else if (0 == strcmp(argv[i], "-voxel")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        tmp = this->parse_argument(argv[i]);
+        if (tmp.first <= 0) {
+          std::cerr << "[Error] voxel size must be positive" << std::endl;
+          return 1;
+        }
+        this->voxel = tmp.first;
+        this->voxel_dnn = tmp.second;
+      } else if (0 == strcmp(argv[i], "-tile")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        tmp = this->parse_argument(argv[i]);
+        if (tmp.first <= 0) {
+          std::cerr << "[Error] tile size must be positive" << std::endl;
+          return 1;
+        }
+        this->tile = tmp.first;
+        this->tile_dnn = tmp.second;
+      } else if (0 == strcmp(argv[i], "-overlap")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        tmp = this->parse_argument(argv[i]);
+        if (tmp.first < 0) {
+          std::cerr << "[Error] overlap must not be negative" << std::endl;
+          return 1;
+        }
+        this->overlap = tmp.first;
+        this->overlap_dnn = tmp.second;
+      } else if (0 == strcmp(argv[i], "-window")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        int tmp = atoi(argv[i]);
+        if (tmp < 1) {
+          std::cerr << "[Error] window size must be positive" << std::endl;
+          return 1;
+        }
+        this->window = (size_t)tmp;
+      } else if (0 == strcmp(argv[i], "-step")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        int tmp = atoi(argv[i]);
+        if (tmp < 1) {
+          std::cerr << "[Error] step size must be positive" << std::endl;
+          return 1;
+        }
+        this->step = (size_t)tmp;
+      } else if (0 == strcmp(argv[i], "-owindow")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        int tmp = atoi(argv[i]);
+        if (tmp < 1) {
+          std::cerr << "[Error] index window must be positive" << std::endl;
+          return 1;
+        }
+        this->owindow = (size_t)tmp;
+      } else if (0 == strcmp(argv[i], "-knn-eps")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        this->knn_eps = stod(argv[i]);
+        if (this->knn_eps < 0.0) {
+          std::cerr << "[Error] knn-eps must not be negative" << std::endl;
+          return 1;
+        }
+      } else if (0 == strcmp(argv[i], "-dnn-sample")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        int tmp = atoi(argv[i]);
+        if (tmp < 2) {
+          std::cerr << "[Error] dnn sample size must be at least 2"
+                    << std::endl;
+          return 1;
+        }
+        this->dnn_sample = (size_t)tmp;
+      } else if (0 == strcmp(argv[i], "-isolated")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        if (strcmp(argv[i], "t") == 0) {
+          this->isolated_t = true;
+        } else {
+          this->isolated = stod(argv[i]);
+          if (this->isolated <= 0.0) {
+            std::cerr << "[Error] isolated distance must be positive"
+                      << std::endl;
+            return 1;
+          }
+        }
+      } else if (0 == strcmp(argv[i], "-threads")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        this->threads = atoi(argv[i]);
+        if (this->threads < 1) {
+          std::cerr << "[Error] number of threads must be at least 1"
+                    << std::endl;
+          return 1;
+        }
+#ifndef _OPENMP
+        if (this->threads > 1) {
+          std::cerr << "[Warning] -threads is ignored, because triplclust "
+                       "was compiled without OpenMP"
+                    << std::endl;
+          this->threads = 1;
+        }
+#endif
+      } else if (0 == strcmp(argv[i], "-threads-chunk")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        this->threads_chunk = atoi(argv[i]);
+        if (this->threads_chunk < 1) {
+          std::cerr << "[Error] threads-chunk must be at least 1" << std::endl;
+          return 1;
+        }
+      } else if (0 == strcmp(argv[i], "-index")) {
+        ++i;
+        if (i >= argc) {
+          return 1;
+        }
+        if (strcmp(argv[i], "auto") == 0) {
+          this->index = INDEX_AUTO;
+        } else if (strcmp(argv[i], "kdtree") == 0) {
+          this->index = INDEX_KDTREE;
+        } else if (strcmp(argv[i], "grid") == 0) {
+          this->index = INDEX_GRID;
+        } else {
+          std::cerr << "[Error] " << argv[i] << " is not a valide option!"
+                    << std::endl;
+          return 1;
+        }
       } else if (0 == strcmp(argv[i], "-skip")) {
         ++i;
         if (i < argc) {
@@ -183,6 +416,54 @@ int Opt::parse_args(int argc, char** argv) {
           return 1;
         }
         this->outfile_prefix = argv[++i];
+      } else if (0 == strcmp(argv[i], "-stats")) {
+        if (i + 1 == argc) {
+          std::cerr << "[Error] not enough parameters" << std::endl;
+          return 1;
+        } else if (argv[i + 1][0] == '-') {
+          std::cerr << "[Error] please enter statistics file name"
+                    << std::endl;
+          return 1;
+        }
+        this->stats_file = argv[++i];
+      } else if (0 == strcmp(argv[i], "-savedendro")) {
+        if (i + 1 == argc) {
+          std::cerr << "[Error] not enough parameters" << std::endl;
+          return 1;
+        } else if (argv[i + 1][0] == '-') {
+          std::cerr << "[Error] please enter dendrogram file name"
+                    << std::endl;
+          return 1;
+        }
+        this->dendro_file = argv[++i];
+      } else if (0 == strcmp(argv[i], "-cache")) {
+        if (i + 1 == argc) {
+          std::cerr << "[Error] not enough parameters" << std::endl;
+          return 1;
+        } else if (argv[i + 1][0] == '-') {
+          std::cerr << "[Error] please enter cache directory name"
+                    << std::endl;
+          return 1;
+        }
+        this->cache_dir = argv[++i];
+      } else if (0 == strcmp(argv[i], "-outofcore")) {
+        if (i + 1 == argc) {
+          std::cerr << "[Error] not enough parameters" << std::endl;
+          return 1;
+        } else if (argv[i + 1][0] == '-') {
+          std::cerr << "[Error] please enter directory name" << std::endl;
+          return 1;
+        }
+        this->outofcore_dir = argv[++i];
+      } else if (0 == strcmp(argv[i], "-matrixdir")) {
+        if (i + 1 == argc) {
+          std::cerr << "[Error] not enough parameters" << std::endl;
+          return 1;
+        } else if (argv[i + 1][0] == '-') {
+          std::cerr << "[Error] please enter directory name" << std::endl;
+          return 1;
+        }
+        this->matrix_dir = argv[++i];
       } else if (0 == strcmp(argv[i], "-gnuplot")) {
         this->gnuplot = true;
       } else if (argv[i][0] == '-') {
@@ -219,9 +500,48 @@ std::pair<double, bool> Opt::parse_argument(const char* str) {
   return std::pair<double, bool>(result, dnn);
 }
 
+//-------------------------------------------------------------------
+// parses the memory size *str* in bytes, which can have one of the
+// (binary) suffixes 'K', 'M', 'G' or 'T'. If *str* is not a valid
+// size, an invalid_argument exception is thrown.
+//-------------------------------------------------------------------
+double Opt::parse_bytes(const char* str) {
+  double result = 0.0;
+  char buff[2];
+  int count = sscanf(str, "%lf%1s", &result, buff);
+  if (count < 1 || result < 0) {
+    throw std::invalid_argument("not a memory size");
+  }
+  if (count == 2) {
+    const char *units = "KMGT";
+    const char *unit = strchr(units, toupper(buff[0]));
+    if (!unit || !buff[0]) throw std::invalid_argument("not a memory size");
+    for (const char *u = units; u <= unit; ++u) result *= 1024.0;
+  }
+  return result;
+}
+
+//-------------------------------------------------------------------
+// parses a comma separated list of numbers.
+// Throws std::invalid_argument if *str* contains no or invalid numbers.
+//-------------------------------------------------------------------
+std::vector<double> Opt::parse_list(const char *str) {
+  std::vector<std::string> values;
+  std::vector<double> result;
+  split(str, values, ',');
+  for (size_t i = 0; i < values.size(); ++i) {
+    result.push_back(stod(values[i].c_str()));
+  }
+  if (result.empty()) {
+    throw std::invalid_argument("empty list");
+  }
+  return result;
+}
+
 //-------------------------------------------------------------------
 // compute attributes which depend on dnn.
-// If r,s,dmax depend on dnn their new value will be computed.
+// If r,s,dmax,voxel,tile,overlap depend on dnn their new value will be
+// computed.
 //-------------------------------------------------------------------
 void Opt::set_dnn(double dnn) {
   if (this->rdnn) {
@@ -242,25 +562,104 @@ void Opt::set_dnn(double dnn) {
       std::cout << "[Info] computed max gap: " << this->dmax << std::endl;
     }
   }
+  if (this->voxel > 0 && this->voxel_dnn) {
+    this->voxel *= dnn;
+    if (this->verbose > 0) {
+      std::cout << "[Info] computed voxel size: " << this->voxel << std::endl;
+    }
+  }
+  if (this->tile > 0 && this->tile_dnn) {
+    this->tile *= dnn;
+    if (this->verbose > 0) {
+      std::cout << "[Info] computed tile size: " << this->tile << std::endl;
+    }
+  }
+  if (this->tile > 0 && this->overlap_dnn) {
+    this->overlap *= dnn;
+    if (this->verbose > 0) {
+      std::cout << "[Info] computed tile overlap: " << this->overlap
+                << std::endl;
+    }
+  }
 }
 
 // read access functions
 const char* Opt::get_ifname() { return this->infile_name; }
 const char* Opt::get_ofprefix() { return this->outfile_prefix; }
-bool Opt::needs_dnn() { return this->rdnn || this->sdnn || this->dmax_dnn; }
+const char* Opt::get_statsfile() { return this->stats_file; }
+const char* Opt::get_dendrofile() { return this->dendro_file; }
+const char* Opt::get_cachedir() { return this->cache_dir; }
+const char* Opt::get_outofcoredir() { return this->outofcore_dir; }
+const char* Opt::get_matrixdir() { return this->matrix_dir; }
+bool Opt::needs_dnn() {
+  return this->rdnn || this->sdnn || this->dmax_dnn ||
+         (this->voxel > 0 && this->voxel_dnn) ||
+         (this->tile > 0 && (this->tile_dnn || this->overlap_dnn));
+}
 bool Opt::is_gnuplot() { return this->gnuplot; }
 size_t Opt::get_skip() { return this->skip; }
 char Opt::get_delimiter() { return this->delimiter; }
 int Opt::get_verbosity() { return this->verbose; }
 double Opt::get_r() { return this->r; }
-size_t Opt::get_k() { return this->k; }
-size_t Opt::get_n() { return this->n; }
-double Opt::get_a() { return this->a; }
+size_t Opt::get_n_kvalues() {
+  return this->k_values.empty() ? 1 : this->k_values.size();
+}
+size_t Opt::get_n_nvalues() {
+  return this->n_values.empty() ? 1 : this->n_values.size();
+}
+size_t Opt::get_n_avalues() {
+  return this->a_values.empty() ? 1 : this->a_values.size();
+}
+size_t Opt::get_k(size_t i) {
+  return this->k_values.empty() ? this->k : this->k_values[i];
+}
+size_t Opt::get_n(size_t i) {
+  return this->n_values.empty() ? this->n : this->n_values[i];
+}
+double Opt::get_a(size_t i) {
+  return this->a_values.empty() ? this->a : this->a_values[i];
+}
 double Opt::get_s() { return this->s; }
-bool Opt::is_tauto() { return this->tauto; }
-double Opt::get_t() { return this->t; }
+size_t Opt::get_n_thresholds() {
+  return this->thresholds.empty() ? 1 : this->thresholds.size();
+}
+bool Opt::is_tauto(size_t i) {
+  return this->thresholds.empty() ? this->tauto : this->thresholds[i].second;
+}
+double Opt::get_t(size_t i) {
+  return this->thresholds.empty() ? this->t : this->thresholds[i].first;
+}
 bool Opt::is_dmax() { return this->isdmax; }
 double Opt::get_dmax() { return this->dmax; }
 Linkage Opt::get_linkage() { return this->link; }
+HcEngine Opt::get_engine() { return this->engine; }
+double Opt::get_membudget() { return this->membudget; }
+bool Opt::is_dryrun() { return this->dryrun; }
+bool Opt::is_dedup() { return this->dedup; }
+double Opt::get_voxel() { return this->voxel; }
+double Opt::get_tile() { return this->tile; }
+double Opt::get_overlap() { return this->overlap; }
+size_t Opt::get_window() { return this->window; }
+size_t Opt::get_step() {
+  // default: a tenth of the window
+  if (this->step == 0) return std::max(this->window / 10, (size_t)1);
+  return this->step;
+}
+size_t Opt::get_owindow() { return this->owindow; }
+double Opt::get_knn_eps() { return this->knn_eps; }
+size_t Opt::get_dnn_sample() { return this->dnn_sample; }
+int Opt::get_threads() { return this->threads; }
+int Opt::get_threads_chunk() { return this->threads_chunk; }
+bool Opt::is_isolated_t() { return this->isolated_t; }
+double Opt::get_isolated() {
+  if (!this->isolated_t) return this->isolated;
+  // largest numeric threshold
+  double t = 0.0;
+  for (size_t i = 0; i < this->get_n_thresholds(); ++i) {
+    if (!this->is_tauto(i)) t = std::max(t, this->get_t(i));
+  }
+  return t;
+}
+IndexType Opt::get_index() { return this->index; }
 size_t Opt::get_m() { return this->m; }
 bool Opt::get_ordered() {return this->ordered;}
@@ -11,6 +11,7 @@
 #define OPTION_H
 #include <cstddef>
 #include <utility>
+#include <vector>
 
 #include "util.h"
 
@@ -18,6 +19,16 @@
 class Opt {
  private:
   char *infile_name, *outfile_prefix;
+  // file for run time statistics
+  char *stats_file;
+  // file for saving the dendrogram
+  char *dendro_file;
+  // directory for caching the results of the steps
+  char *cache_dir;
+  // directory for the temporary files of the out-of-core mode
+  char *outofcore_dir;
+  // directory for the distance matrix file of the engine 'disk'
+  char *matrix_dir;
   // output as gnuplot
   bool gnuplot;
   // csv file delimiter
@@ -37,6 +48,9 @@ class Opt {
   size_t n;
   // 1 - cos alpha, where alpha is the angle between the two triplet branches
   double a;
+  // all values of k, n and a for a parameter sweep (k, n, a are the first)
+  std::vector<size_t> k_values, n_values;
+  std::vector<double> a_values;
 
   // distance scale factor in metric
   double s;
@@ -44,6 +58,8 @@ class Opt {
   // threshold for cdist in clustering
   double t;
   bool tauto;  // auto generate t
+  // all thresholds when several are given (t and tauto are the first)
+  std::vector<std::pair<double, bool> > thresholds;
   // maximum gap width
   double dmax;
   bool isdmax;    // dmax != none
@@ -51,11 +67,49 @@ class Opt {
   bool ordered;   // points are in chronological order
   // linkage method for clustering
   Linkage link;
+  // algorithm for computing the dendrogram
+  HcEngine engine;
+  // memory budget in bytes (zero means unlimited)
+  double membudget;
+  // only estimate memory without clustering
+  bool dryrun;
+  // collapse identical points of the cloud and the smoothed cloud
+  bool dedup;
+  // edge length of the voxels for downsampling (zero means none)
+  double voxel;
+  bool voxel_dnn;  // compute voxel with dnn
+  // edge length of the tiles (zero means no tiling) and their overlap
+  double tile;
+  bool tile_dnn;  // compute tile with dnn
+  double overlap;
+  bool overlap_dnn;  // compute overlap with dnn
+  // number of points in the sliding window (zero means no streaming)
+  // and number of points by which the window is moved
+  size_t window, step;
+  // max index difference of the triplet neighbours in ordered clouds
+  // (zero means no limit)
+  size_t owindow;
+  // approximation factor of the kNN search for the triplets
+  double knn_eps;
+  // spatial index for the neighbour searches
+  IndexType index;
+  // number of random points from which dnn is estimated (zero means all)
+  size_t dnn_sample;
+  // number of threads for the dendrogram computation
+  int threads;
+  // minimum number of active clusters per thread in the dendrogram
+  int threads_chunk;
+  // distance below which triplets are not isolated (zero means that
+  // isolated triplets are kept)
+  double isolated;
+  bool isolated_t;  // use the largest threshold
 
   // min number of triplets per cluster
   size_t m;
 
   std::pair<double, bool> parse_argument(const char *str);
+  double parse_bytes(const char *str);
+  std::vector<double> parse_list(const char *str);
 
  public:
   Opt();
@@ -67,22 +121,62 @@ class Opt {
   const char *get_ifname();
   // get outfile name
   const char *get_ofprefix();
+  // get statistics file name
+  const char *get_statsfile();
+  // get dendrogram file name
+  const char *get_dendrofile();
+  // get cache directory name
+  const char *get_cachedir();
+  // get directory name for out-of-core processing
+  const char *get_outofcoredir();
+  // get directory name for the distance matrix file
+  const char *get_matrixdir();
   bool needs_dnn();
   bool is_gnuplot();
   char get_delimiter();
   size_t get_skip();
   int get_verbosity();
   double get_r();
-  size_t get_k();
-  size_t get_n();
-  double get_a();
+  // number of values for the sweep over k, n, a and the i-th value
+  size_t get_n_kvalues();
+  size_t get_n_nvalues();
+  size_t get_n_avalues();
+  size_t get_k(size_t i = 0);
+  size_t get_n(size_t i = 0);
+  double get_a(size_t i = 0);
   double get_s();
-  bool is_tauto();
-  double get_t();
+  // number of thresholds and the i-th threshold
+  size_t get_n_thresholds();
+  bool is_tauto(size_t i = 0);
+  double get_t(size_t i = 0);
   bool is_dmax();
   double get_dmax();
   bool get_ordered();   //!
   Linkage get_linkage();
+  HcEngine get_engine();
+  double get_membudget();
+  bool is_dryrun();
+  bool is_dedup();
+  // voxel size (zero if the cloud is not downsampled)
+  double get_voxel();
+  // tile size (zero if the cloud is not split into tiles) and overlap
+  double get_tile();
+  double get_overlap();
+  // window size (zero if the whole cloud is clustered) and step size
+  size_t get_window();
+  size_t get_step();
+  // index window for the neighbours of ordered clouds (zero if unlimited)
+  size_t get_owindow();
+  // approximation factor of the triplet kNN search (zero if exact)
+  double get_knn_eps();
+  IndexType get_index();
+  // sample size for the dnn estimation (zero if all points are used)
+  size_t get_dnn_sample();
+  int get_threads();
+  int get_threads_chunk();
+  // distance for removing isolated triplets (zero if they are kept)
+  double get_isolated();
+  bool is_isolated_t();
   size_t get_m();
 };
 
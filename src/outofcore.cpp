@@ -0,0 +1,904 @@
+//
+// outofcore.cpp
+//     Clustering of point clouds that do not fit into memory. The points
+//     are spooled into tile files on disk and only one tile per thread
+//     is loaded at a time.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "cluster.h"
+#include "dnn.h"
+#include "extsort.h"
+#include "graph.h"
+#include "outofcore.h"
+#include "output.h"
+#include "pointcloud.h"
+#include "tiling.h"
+
+// memory for buffering points before they are appended to the tile files
+const size_t spool_buffer_size = 64 << 20;
+// maximum number of points per bucket for the dnn computation; with
+// -membudget, the buckets can be smaller (see bucket_dnn)
+const size_t dnn_bucket_points = 100000;
+// maximum number of distances from which dnn is computed
+const size_t dnn_max_samples = 1000000;
+// memory for sorting the triplets and labels of the whole cloud; with
+// -membudget, at most a quarter of the budget is used
+const size_t sort_buffer_size = 16 << 20;
+
+// size of a point record in a tile file (index and coordinates)
+const size_t record_size = sizeof(uint64_t) + 3 * sizeof(double);
+
+// the points of the infile as triples of doubles in a binary file
+struct SpoolFile {
+  std::string path;
+  size_t n;
+  bool is2d;
+  double lower[3], upper[3];  // bounding box
+};
+
+// cluster id of a point, ordered by point
+struct PointLabel {
+  uint64_t point, cluster;
+  friend bool operator<(const PointLabel &l1, const PointLabel &l2) {
+    if (l1.point != l2.point) return l1.point < l2.point;
+    return l1.cluster < l2.cluster;
+  }
+  friend bool operator==(const PointLabel &l1, const PointLabel &l2) {
+    return l1.point == l2.point && l1.cluster == l2.cluster;
+  }
+};
+
+// point of a cluster with its coordinates, ordered by cluster
+struct ClusterPoint {
+  uint64_t cluster, point;
+  double p[3];
+  friend bool operator<(const ClusterPoint &c1, const ClusterPoint &c2) {
+    if (c1.cluster != c2.cluster) return c1.cluster < c2.cluster;
+    return c1.point < c2.point;
+  }
+};
+
+// path of the file *name* in the directory *dir*
+std::string spool_path(const char *dir, const std::string &name) {
+  return std::string(dir) + "/" + name;
+}
+
+//-------------------------------------------------------------------
+// Reads the infile of *opt* point by point and writes the coordinates
+// to *spool*. Returns the exit code for the command line tool.
+//-------------------------------------------------------------------
+int spool_input(Opt &opt, SpoolFile &spool) {
+  const char *fname = opt.get_ifname();
+  FILE *out = fopen(spool.path.c_str(), "wb");
+  if (!out) {
+    std::cerr << "[Error] cannot write file '" << spool.path << "'"
+              << std::endl;
+    return 2;
+  }
+  spool.n = 0;
+  spool.is2d = false;
+  bool ok = true;
+  try {
+    CsvReader reader(fname, opt.get_delimiter(), opt.get_skip());
+    Point point;
+    while (ok && reader.next(point)) {
+      double p[3] = {point.x, point.y, point.z};
+      for (size_t d = 0; d < 3; ++d) {
+        if (spool.n == 0 || p[d] < spool.lower[d]) spool.lower[d] = p[d];
+        if (spool.n == 0 || p[d] > spool.upper[d]) spool.upper[d] = p[d];
+      }
+      ok = (fwrite(p, sizeof(double), 3, out) == 3);
+      spool.n++;
+    }
+    size_t count2d = reader.points2d();
+    if (count2d && count2d != spool.n) {
+      throw std::invalid_argument("Mixed 2d and 3d points.");
+    }
+    spool.is2d = (count2d > 0);
+  } catch (const std::invalid_argument &e) {
+    fclose(out);
+    std::cerr << "[Error] in file'" << fname << "': " << e.what()
+              << std::endl;
+    return 2;
+  } catch (const std::exception &e) {
+    fclose(out);
+    std::cerr << "[Error] cannot read infile '" << fname << "'! " << e.what()
+              << std::endl;
+    return 2;
+  }
+  if (fclose(out) != 0 || !ok) {
+    std::cerr << "[Error] cannot write file '" << spool.path << "'"
+              << std::endl;
+    return 2;
+  }
+  return 0;
+}
+
+// buffered writer appending point records to the tile files
+class TileWriter {
+ private:
+  const std::vector<std::string> &paths;
+  std::vector<std::vector<char> > buffers;
+  std::vector<bool> created;
+  size_t buffered;
+
+ public:
+  size_t written;  // total number of bytes written
+  TileWriter(const std::vector<std::string> &paths)
+      : paths(paths),
+        buffers(paths.size()),
+        created(paths.size(), false),
+        buffered(0),
+        written(0) {}
+  bool add(size_t tile, uint64_t index, const double p[3]);
+  bool flush();
+};
+
+// adds the point *p* with index *index* to the tile *tile*
+bool TileWriter::add(size_t tile, uint64_t index, const double p[3]) {
+  std::vector<char> &buffer = this->buffers[tile];
+  size_t pos = buffer.size();
+  buffer.resize(pos + record_size);
+  memcpy(&buffer[pos], &index, sizeof(index));
+  memcpy(&buffer[pos + sizeof(index)], p, 3 * sizeof(double));
+  this->buffered += record_size;
+  if (this->buffered > spool_buffer_size) return this->flush();
+  return true;
+}
+
+// appends all buffered records to the tile files
+bool TileWriter::flush() {
+  bool ok = true;
+  for (size_t t = 0; t < this->buffers.size(); ++t) {
+    std::vector<char> &buffer = this->buffers[t];
+    if (buffer.empty() && this->created[t]) continue;
+    FILE *out = fopen(this->paths[t].c_str(), this->created[t] ? "ab" : "wb");
+    if (!out) return false;
+    if (!buffer.empty() &&
+        fwrite(&buffer[0], 1, buffer.size(), out) != buffer.size())
+      ok = false;
+    if (fclose(out) != 0) ok = false;
+    this->created[t] = true;
+    this->written += buffer.size();
+    std::vector<char>().swap(buffer);
+  }
+  this->buffered = 0;
+  return ok;
+}
+
+//-------------------------------------------------------------------
+// Splits the points in *spool* into the non-empty cells of *grid*
+// (TileGrid or BucketGrid) extended by *overlap*. Each tile is written
+// to a file in *dir* with a name starting with *prefix*; the file names
+// are returned in *paths*, the grid cells in *cells*, the numbers of
+// points in *sizes* and the number of bytes written in *bytes*. Returns
+// false in case of I/O errors.
+//-------------------------------------------------------------------
+template <class Grid>
+bool partition_points(const SpoolFile &spool, const Grid &grid,
+                      double overlap, const char *dir, const char *prefix,
+                      std::vector<std::string> &paths,
+                      std::vector<size_t> &cells, std::vector<size_t> &sizes,
+                      size_t &bytes) {
+  double p[3];
+  paths.clear();
+  cells.clear();
+  sizes.clear();
+
+  // the tiles are the grid cells containing at least one point
+  std::map<size_t, size_t> cell_to_tile;
+  FILE *in = fopen(spool.path.c_str(), "rb");
+  if (!in) return false;
+  for (size_t i = 0; i < spool.n; ++i) {
+    if (fread(p, sizeof(double), 3, in) != 3) {
+      fclose(in);
+      return false;
+    }
+    size_t cell = grid.cell(p[0], p[1], p[2]);
+    if (cell_to_tile.find(cell) == cell_to_tile.end()) {
+      std::ostringstream name;
+      name << prefix << cells.size() << ".bin";
+      cell_to_tile[cell] = cells.size();
+      cells.push_back(cell);
+      paths.push_back(spool_path(dir, name.str()));
+    }
+  }
+
+  // write each point to all tiles whose extended cell contains it
+  TileWriter writer(paths);
+  std::vector<size_t> point_cells;
+  sizes.assign(cells.size(), 0);
+  rewind(in);
+  bool ok = true;
+  for (size_t i = 0; i < spool.n && ok; ++i) {
+    if (fread(p, sizeof(double), 3, in) != 3) {
+      ok = false;
+      break;
+    }
+    grid.cells(p, overlap, point_cells);
+    for (size_t j = 0; j < point_cells.size() && ok; ++j) {
+      std::map<size_t, size_t>::iterator it = cell_to_tile.find(point_cells[j]);
+      if (it == cell_to_tile.end()) continue;
+      sizes[it->second]++;
+      ok = writer.add(it->second, (uint64_t)i, p);
+    }
+  }
+  fclose(in);
+  if (ok) ok = writer.flush();
+  bytes = writer.written;
+  return ok;
+}
+
+//-------------------------------------------------------------------
+// Loads the points of the tile file *path* into *cloud* and their
+// indices in the whole cloud into *indices*. Returns false in case of
+// I/O errors.
+//-------------------------------------------------------------------
+bool load_tile(const std::string &path, PointCloud &cloud,
+               std::vector<size_t> &indices) {
+  char record[record_size];
+  uint64_t index;
+  double p[3];
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in) return false;
+  while (fread(record, 1, record_size, in) == record_size) {
+    memcpy(&index, record, sizeof(index));
+    memcpy(p, record + sizeof(index), 3 * sizeof(double));
+    cloud.push_back(Point(p[0], p[1], p[2], (size_t)index));
+    indices.push_back((size_t)index);
+  }
+  bool ok = !ferror(in);
+  fclose(in);
+  return ok;
+}
+
+// grid whose cells are separated by the cuts along each axis, so that
+// the cells can follow the distribution of the points
+struct BucketGrid {
+  std::vector<double> cuts[3];
+  // cell containing the point (x,y,z)
+  size_t cell(double x, double y, double z) const;
+  // cells whose boxes extended by *overlap* contain the point p
+  void cells(const double p[3], double overlap,
+             std::vector<size_t> &result) const;
+};
+
+// slab of the coordinate *x* along the axis *d* of *grid*
+static size_t bucket_slab(const BucketGrid &grid, double x, size_t d) {
+  return std::upper_bound(grid.cuts[d].begin(), grid.cuts[d].end(), x) -
+         grid.cuts[d].begin();
+}
+
+size_t BucketGrid::cell(double x, double y, double z) const {
+  return (bucket_slab(*this, z, 2) * (this->cuts[1].size() + 1) +
+          bucket_slab(*this, y, 1)) *
+             (this->cuts[0].size() + 1) +
+         bucket_slab(*this, x, 0);
+}
+
+void BucketGrid::cells(const double p[3], double overlap,
+                       std::vector<size_t> &result) const {
+  size_t lo[3], hi[3];
+  result.clear();
+  for (size_t d = 0; d < 3; ++d) {
+    lo[d] = bucket_slab(*this, p[d] - overlap, d);
+    hi[d] = bucket_slab(*this, p[d] + overlap, d);
+  }
+  for (size_t z = lo[2]; z <= hi[2]; ++z) {
+    for (size_t y = lo[1]; y <= hi[1]; ++y) {
+      for (size_t x = lo[0]; x <= hi[0]; ++x) {
+        result.push_back((z * (this->cuts[1].size() + 1) + y) *
+                             (this->cuts[0].size() + 1) +
+                         x);
+      }
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+// Computes the cuts of *grid* for about *bucket_points* points per
+// cell from a histogram of each axis of the points in *spool*. The axis
+// with the widest spread of the central 90% of the points per slab is
+// split further, until there are enough cells, so that flat clouds are
+// not cut along their thin axis. The cuts are at quantiles of the
+// histograms. Returns false in case of I/O errors.
+//-------------------------------------------------------------------
+bool make_bucket_grid(const SpoolFile &spool, size_t bucket_points,
+                      BucketGrid &grid) {
+  const size_t n_bins = 4096;
+  const size_t n_buckets = (spool.n + bucket_points - 1) / bucket_points;
+  for (size_t d = 0; d < 3; ++d) grid.cuts[d].clear();
+  if (n_buckets < 2) return true;
+
+  // histograms of the coordinates
+  std::vector<size_t> hist(3 * n_bins, 0);
+  double width[3];
+  for (size_t d = 0; d < 3; ++d) {
+    width[d] = (spool.upper[d] - spool.lower[d]) / n_bins;
+  }
+  FILE *in = fopen(spool.path.c_str(), "rb");
+  if (!in) return false;
+  double p[3];
+  for (size_t i = 0; i < spool.n; ++i) {
+    if (fread(p, sizeof(double), 3, in) != 3) {
+      fclose(in);
+      return false;
+    }
+    for (size_t d = 0; d < 3; ++d) {
+      size_t bin = 0;
+      if (width[d] > 0) {
+        bin = std::min((size_t)((p[d] - spool.lower[d]) / width[d]),
+                       n_bins - 1);
+      }
+      hist[d * n_bins + bin]++;
+    }
+  }
+  fclose(in);
+
+  // number of slabs per axis from the spread of the central 90%
+  double spread[3];
+  for (size_t d = 0; d < 3; ++d) {
+    size_t sum = 0, lo = 0, hi = 0;
+    for (size_t b = 0; b < n_bins; ++b) {
+      if (sum <= spool.n / 20) lo = b;
+      sum += hist[d * n_bins + b];
+      if (sum <= spool.n - spool.n / 20) hi = b;
+    }
+    spread[d] = (hi + 1 - lo) * width[d];
+  }
+  size_t slabs[3] = {1, 1, 1};
+  while (slabs[0] * slabs[1] * slabs[2] < n_buckets) {
+    size_t widest = 0;
+    for (size_t d = 1; d < 3; ++d) {
+      if (spread[d] / slabs[d] > spread[widest] / slabs[widest]) widest = d;
+    }
+    if (spread[widest] <= 0) break;
+    slabs[widest]++;
+  }
+
+  // cuts at the quantiles of the histograms
+  for (size_t d = 0; d < 3; ++d) {
+    size_t sum = 0, next = 1;
+    for (size_t b = 0; b + 1 < n_bins && next < slabs[d]; ++b) {
+      sum += hist[d * n_bins + b];
+      if (sum * slabs[d] >= next * spool.n) {
+        grid.cuts[d].push_back(spool.lower[d] + (b + 1) * width[d]);
+        while (next < slabs[d] && sum * slabs[d] >= next * spool.n) next++;
+      }
+    }
+  }
+  return true;
+}
+
+//-------------------------------------------------------------------
+// Computes the squared nearest neighbour distances of the points in
+// *spool* whose index is a multiple of *stride* bucket by bucket. The
+// buckets are the cells of *grid* extended by *overlap*, so that the
+// distances up to *overlap* are exact, and the distances of the points
+// in the core of a bucket are appended to *samples*. The neighbours are
+// searched with the spatial index of type *index* by *threads* threads.
+// Returns false in case of I/O errors.
+//-------------------------------------------------------------------
+bool bucket_distances(const SpoolFile &spool, const BucketGrid &grid,
+                      double overlap, const char *dir, size_t stride,
+                      IndexType index, int threads,
+                      std::vector<double> &samples, Stats &stats) {
+  std::vector<std::string> paths;
+  std::vector<size_t> cells, sizes;
+  size_t bytes = 0;
+  bool ok = partition_points(spool, grid, overlap, dir, "bucket", paths,
+                             cells, sizes, bytes);
+  stats.set_count("dnn_buckets", paths.size());
+  for (size_t b = 0; b < paths.size(); ++b) {
+    PointCloud cloud;
+    std::vector<size_t> indices;
+    std::vector<double> msd;
+    cloud.set2d(spool.is2d);
+    if (ok) ok = load_tile(paths[b], cloud, indices);
+    remove(paths[b].c_str());
+    if (!ok || cloud.size() < 2) continue;
+    compute_mean_square_distance(cloud, msd, 1, index, &stats, threads);
+    for (size_t i = 0; i < msd.size(); ++i) {
+      if (indices[i] % stride == 0 &&
+          grid.cell(cloud[i].x, cloud[i].y, cloud[i].z) == cells[b])
+        samples.push_back(msd[i]);
+    }
+  }
+  return ok;
+}
+
+//-------------------------------------------------------------------
+// Computes dnn of the points in *spool* bucket by bucket. The buckets
+// have about dnn_bucket_points points (see make_bucket_grid), or fewer
+// when the bucket clouds would exceed the memory budget *membudget*. The
+// distances up to the overlap of the buckets are exact, and all other
+// distances are at least as large as the overlap. When the first
+// quartile of the distances exceeds the overlap, the buckets are
+// computed again with the first quartile as overlap, after which it is
+// exact, because the distances can only decrease, so that the quartile
+// is within the overlap. As the first pass has no overlap, clouds with
+// several buckets need two passes. The nearest neighbours are searched
+// with the spatial index of type *index* by *threads* threads. Returns
+// false in case of I/O errors.
+//-------------------------------------------------------------------
+bool bucket_dnn(const SpoolFile &spool, const char *dir, IndexType index,
+                int threads, double membudget, double &dnn, Stats &stats) {
+  dnn = 0.0;
+  size_t bucket_points = dnn_bucket_points;
+  // the bucket cloud and the points in the spatial index, like the tiles
+  const double point_bytes = 2.0 * sizeof(Point);
+  if (membudget > 0 && membudget / point_bytes < bucket_points)
+    bucket_points = std::max((size_t)(membudget / point_bytes), (size_t)2);
+  BucketGrid grid;
+  if (!make_bucket_grid(spool, bucket_points, grid)) return false;
+
+  // squared distances of a regular sample of the points
+  size_t stride = spool.n / dnn_max_samples + 1;
+  double overlap = 0.0;
+  for (size_t pass = 0; pass < 2; ++pass) {
+    std::vector<double> samples;
+    if (!bucket_distances(spool, grid, overlap, dir, stride, index, threads,
+                          samples, stats))
+      return false;
+    if (samples.empty()) return true;
+    const size_t q1 = samples.size() / 4;
+    std::nth_element(samples.begin(), samples.begin() + q1, samples.end());
+    dnn = std::sqrt(samples[q1]);
+    if (stats.get_count("dnn_buckets") < 2 || dnn <= overlap) break;
+    // margin for the rounding of the bucket borders
+    overlap = 1.001 * dnn;
+  }
+  return true;
+}
+
+//-------------------------------------------------------------------
+// Merges the tile clusters that share a triplet like stitch_clusters,
+// but from the triplet occurrences *refs*, which are sorted externally.
+// Only the union-find *parent* over the *n_clusters* tile clusters is
+// held in memory; the owned triplets are written in their order to the
+// file *owned_path*. Returns false in case of I/O errors.
+//-------------------------------------------------------------------
+bool outofcore_stitch(ExternalSorter<TripletRef> &refs, size_t n_clusters,
+                      const std::string &owned_path,
+                      std::vector<size_t> &parent, Stats &stats) {
+  parent.resize(n_clusters);
+  for (size_t g = 0; g < n_clusters; ++g) parent[g] = g;
+  if (!refs.finish()) return false;
+  RecordWriter<TripletRef> owned(owned_path, sort_buffer_size /
+                                                 sizeof(TripletRef) / 16);
+  size_t n_shared = 0, n_merges = 0, n_owned = 0;
+  TripletRef prev, cur;
+  for (bool first = true; refs.next(cur); first = false, prev = cur) {
+    if (cur.owned) {
+      owned.add(cur);
+      n_owned++;
+    }
+    if (first || prev < cur) continue;
+    n_shared++;
+    size_t root_g = find_root(parent, prev.cluster);
+    size_t root_h = find_root(parent, cur.cluster);
+    if (root_g == root_h) continue;
+    parent[std::max(root_g, root_h)] = std::min(root_g, root_h);
+    n_merges++;
+  }
+  stats.set_count("clusters_before_stitching", n_clusters);
+  stats.set_count("stitch_shared_triplets", n_shared);
+  stats.set_count("stitch_merges", n_merges);
+  stats.set_count("triplets", n_owned);
+  return owned.close() && refs.good();
+}
+
+//-------------------------------------------------------------------
+// Numbers the stitched clusters of the owned triplets in the file
+// *owned_path* in the order of their first triplet like stitch_clusters
+// and removes the clusters with less than *m* triplets like
+// cleanup_cluster_group. The cluster ids of the points of the remaining
+// clusters are added to *labels*. *parent* is the union-find of
+// outofcore_stitch. Returns false in case of I/O errors.
+//-------------------------------------------------------------------
+bool outofcore_prune(const std::string &owned_path,
+                     std::vector<size_t> &parent, size_t m, int opt_verbose,
+                     ExternalSorter<PointLabel> &labels, Stats &stats) {
+  const size_t n_clusters = parent.size();
+  const size_t read_capacity = sort_buffer_size / sizeof(TripletRef) / 16;
+  // stitched clusters and their numbers of triplets
+  std::vector<size_t> cluster_of(n_clusters, n_clusters), sizes;
+  TripletRef ref;
+  RecordReader<TripletRef> in(owned_path, read_capacity);
+  while (in.next(ref)) {
+    size_t root = find_root(parent, ref.cluster);
+    if (cluster_of[root] == n_clusters) {
+      cluster_of[root] = sizes.size();
+      sizes.push_back(0);
+    }
+    sizes[cluster_of[root]]++;
+  }
+  if (!in.good()) return false;
+
+  // ids of the clusters with at least m triplets
+  std::vector<size_t> kept(sizes.size(), n_clusters);
+  size_t n_kept = 0;
+  for (size_t c = 0; c < sizes.size(); ++c) {
+    if (sizes[c] >= m) kept[c] = n_kept++;
+  }
+  stats.set_count("clusters_before_pruning", sizes.size());
+  stats.set_count("clusters_after_pruning", n_kept);
+  if (opt_verbose > 0) {
+    std::cout << "[Info] in pruning removed clusters: "
+              << sizes.size() - n_kept << std::endl;
+  }
+
+  // cluster ids of the triplet points
+  RecordReader<TripletRef> again(owned_path, read_capacity);
+  while (again.next(ref)) {
+    size_t id = kept[cluster_of[find_root(parent, ref.cluster)]];
+    if (id == n_clusters) continue;
+    PointLabel label;
+    label.cluster = id;
+    label.point = ref.a;
+    labels.add(label);
+    label.point = ref.b;
+    labels.add(label);
+    label.point = ref.c;
+    labels.add(label);
+  }
+  return again.good() && labels.finish();
+}
+
+//-------------------------------------------------------------------
+// Splits the clusters of the point *labels* at gaps > *dmax* like in
+// step 4) and returns the labels of the new clusters with at least
+// *min_size* points in *new_labels*. The coordinates of the cluster
+// points are read from *spool* in one pass and sorted by cluster with
+// temporary files in *dir*, so that only one cluster is held in memory.
+// Returns false in case of I/O errors.
+//-------------------------------------------------------------------
+bool outofcore_max_step(const SpoolFile &spool,
+                        ExternalSorter<PointLabel> &labels, double dmax,
+                        size_t min_size, const char *dir, size_t sort_bytes,
+                        ExternalSorter<PointLabel> &new_labels,
+                        size_t &n_new_clusters) {
+  // the points of each cluster with their coordinates
+  ExternalSorter<ClusterPoint> points(dir, "cluster", sort_bytes);
+  FILE *in = fopen(spool.path.c_str(), "rb");
+  if (!in) return false;
+  bool ok = true;
+  PointLabel label, prev;
+  bool has_label = labels.next(label);
+  ClusterPoint cp;
+  for (size_t i = 0; i < spool.n && has_label && ok; ++i) {
+    ok = (fread(cp.p, sizeof(double), 3, in) == 3);
+    for (bool first = true; ok && has_label && label.point == i;
+         first = false) {
+      // the triplets of a cluster yield the same label several times
+      if (first || !(label == prev)) {
+        cp.cluster = label.cluster;
+        cp.point = label.point;
+        points.add(cp);
+      }
+      prev = label;
+      has_label = labels.next(label);
+    }
+  }
+  fclose(in);
+  if (!ok || !labels.good() || !points.finish()) return false;
+
+  // Step 4) on each cluster with local point indices
+  n_new_clusters = 0;
+  bool has_point = points.next(cp);
+  while (has_point) {
+    const uint64_t cluster = cp.cluster;
+    PointCloud cloud;
+    cluster_t local;
+    cloud.set2d(spool.is2d);
+    for (; has_point && cp.cluster == cluster; has_point = points.next(cp)) {
+      local.push_back(cloud.size());
+      cloud.push_back(Point(cp.p[0], cp.p[1], cp.p[2], (size_t)cp.point));
+    }
+    cluster_group pieces;
+    max_step(pieces, local, cloud, dmax, min_size);
+    for (size_t j = 0; j < pieces.size(); ++j, ++n_new_clusters) {
+      for (size_t i = 0; i < pieces[j].size(); ++i) {
+        label.point = cloud[pieces[j][i]].index;
+        label.cluster = n_new_clusters;
+        new_labels.add(label);
+      }
+    }
+  }
+  return points.good() && new_labels.finish();
+}
+
+//-------------------------------------------------------------------
+// Writes the points of *spool* with the cluster ids of *labels* (sorted
+// by point) in the format of clusters_to_csv to stdout or, when *prefix*
+// is given, to <prefix>.csv. Returns false in case of I/O errors.
+//-------------------------------------------------------------------
+bool write_outofcore_result(const SpoolFile &spool,
+                            ExternalSorter<PointLabel> &labels,
+                            const char *prefix) {
+  FILE *in = fopen(spool.path.c_str(), "rb");
+  if (!in) return false;
+  // redirect cout to outfile
+  std::streambuf *backup = std::cout.rdbuf();
+  std::ofstream of;
+  if (prefix) {
+    of.open((std::string(prefix) + ".csv").c_str());
+    if (!of.is_open()) {
+      fclose(in);
+      return false;
+    }
+    std::cout.rdbuf(of.rdbuf());
+  }
+  std::cout << std::fixed
+            << "# Comment: curveID -1 represents noise\n# x, y, z, curveID\n";
+  bool ok = true;
+  double p[3];
+  PointLabel label;
+  bool has_label = labels.next(label);
+  for (size_t i = 0; i < spool.n; ++i) {
+    if (fread(p, sizeof(double), 3, in) != 3) {
+      ok = false;
+      break;
+    }
+    Point point(p[0], p[1], p[2]);
+    for (; has_label && label.point == i; has_label = labels.next(label)) {
+      point.cluster_ids.insert(label.cluster);
+    }
+    std::cout << point.x << "," << point.y << ",";
+    if (!spool.is2d) std::cout << point.z << ",";
+    print_cluster_ids(point);
+    // no std::endl, because flushing each line is slow for huge files
+    std::cout << "\n";
+  }
+  std::cout.flush();
+  fclose(in);
+  // restore cout's default stream buffer
+  std::cout.rdbuf(backup);
+  return ok && labels.good() && !(prefix && of.fail());
+}
+
+//-------------------------------------------------------------------
+// Runs all steps on the spooled points *spool*. See run_outofcore.
+//-------------------------------------------------------------------
+int outofcore_steps(Opt &opt, const SpoolFile &spool, Stats &stats) {
+  int opt_verbose = opt.get_verbosity();
+  const char *dir = opt.get_outofcoredir();
+
+  // characteristic length dnn from buckets
+  if (opt.needs_dnn()) {
+    double dnn;
+    stats.start("dnn");
+    bool ok = bucket_dnn(spool, dir, opt.get_index(), opt.get_threads(),
+                         opt.get_membudget(), dnn, stats);
+    stats.stop("dnn");
+    if (!ok) {
+      std::cerr << "[Error] cannot write to directory '" << dir << "'"
+                << std::endl;
+      return 2;
+    }
+    stats.set_value("dnn", dnn);
+    if (opt_verbose > 0) {
+      std::cout << "[Info] computed dnn: " << dnn << std::endl;
+    }
+    opt.set_dnn(dnn);
+    if (dnn == 0.0) {
+      std::cerr << "[Error] dnn computed as zero. "
+                << "Suggestion: remove doublets, e.g. with 'sort -u'"
+                << std::endl;
+      return 3;
+    }
+  }
+
+  // tile files
+  TileGrid grid;
+  try {
+    grid.init(spool.lower, spool.upper, opt.get_tile());
+  } catch (const std::invalid_argument &e) {
+    std::cerr << "[Error] " << e.what() << std::endl;
+    return 1;
+  }
+  std::vector<std::string> paths;
+  std::vector<size_t> cells, sizes;
+  size_t bytes = 0;
+  stats.start("tiling");
+  bool ok = partition_points(spool, grid, opt.get_overlap(), dir, "tile",
+                             paths, cells, sizes, bytes);
+  stats.stop("tiling");
+  if (!ok) {
+    for (size_t t = 0; t < paths.size(); ++t) remove(paths[t].c_str());
+    std::cerr << "[Error] cannot write to directory '" << dir << "'"
+              << std::endl;
+    return 2;
+  }
+  size_t n_tiles = paths.size(), n_points = 0, max_points = 0;
+  for (size_t t = 0; t < n_tiles; ++t) {
+    n_points += sizes[t];
+    max_points = std::max(max_points, sizes[t]);
+  }
+  stats.set_count("tiles", n_tiles);
+  stats.set_count("tile_points", n_points);
+  stats.set_count("tile_points_max", max_points);
+  stats.set_count("tile_bytes", bytes);
+  if (opt_verbose > 0) {
+    std::cout << "[Info] split " << spool.n << " points into " << n_tiles
+              << " tiles with " << n_points
+              << " points including overlap (at most " << max_points
+              << " per tile)" << std::endl;
+  }
+
+  // buffers of the external sorts
+  size_t sort_bytes = sort_buffer_size;
+  if (opt.get_membudget() > 0 && opt.get_membudget() / 4 < sort_bytes)
+    sort_bytes = (size_t)(opt.get_membudget() / 4);
+
+  // Steps 1) to 3) for each tile, loaded from its file; the triplets of
+  // each tile are passed to the external sort right away. The tile
+  // cluster ids depend on the order in which the tiles finish, but the
+  // stitched clusters are numbered by the order of their triplets.
+  TileParams param(opt);
+  std::vector<TileResult> tile_results(n_tiles);
+  std::vector<int> rc(n_tiles, 0);
+  ExternalSorter<TripletRef> refs(dir, "refs", sort_bytes);
+  size_t n_clusters = 0;
+  stats.start("tiles");
+#pragma omp parallel for num_threads(param.threads) schedule(dynamic) if (param.threads > 1)
+  for (int t = 0; t < (int)n_tiles; ++t) {
+    PointCloud tile_cloud;
+    std::vector<size_t> indices;
+    tile_cloud.setOrdered(opt.get_ordered());
+    tile_cloud.set2d(spool.is2d);
+    bool loaded = load_tile(paths[t], tile_cloud, indices);
+    remove(paths[t].c_str());
+    if (!loaded) {
+      rc[t] = 2;
+      continue;
+    }
+    rc[t] = process_tile(tile_cloud, indices, grid, cells[t], param,
+                         tile_results[t]);
+    std::vector<TripletRef> &tile_refs = tile_results[t].triplets;
+#pragma omp critical(outofcore_refs)
+    {
+      for (size_t i = 0; i < tile_refs.size(); ++i) {
+        tile_refs[i].cluster += n_clusters;
+        refs.add(tile_refs[i]);
+      }
+      n_clusters += tile_results[t].n_clusters;
+    }
+    std::vector<TripletRef>().swap(tile_refs);
+  }
+  stats.stop("tiles");
+  size_t n_tile_triplets = 0;
+  for (size_t t = 0; t < n_tiles; ++t) {
+    if (rc[t] == 2 && !tile_results[t].error.empty()) {
+      std::cerr << "[Error] " << tile_results[t].error << " in tile " << t
+                << std::endl;
+      return 2;
+    } else if (rc[t] == 2) {
+      std::cerr << "[Error] cannot read file '" << paths[t] << "'"
+                << std::endl;
+      return 2;
+    } else if (rc[t] == 4) {
+      print_tile_memory_error(tile_results[t], t, param);
+      return 4;
+    }
+    n_tile_triplets += tile_results[t].n_triplets;
+  }
+  stats.set_count("tile_triplets", n_tile_triplets);
+
+  // stitching of the clusters that continue across tile borders
+  stats.start("stitching");
+  std::vector<size_t> parent;
+  const std::string owned_path = spool_path(dir, "owned.bin");
+  ok = outofcore_stitch(refs, n_clusters, owned_path, parent, stats);
+  stats.stop("stitching");
+  stats.set_count("sort_runs", refs.run_files());
+  if (!ok) {
+    remove(owned_path.c_str());
+    std::cerr << "[Error] cannot write to directory '" << dir << "'"
+              << std::endl;
+    return 2;
+  }
+  if (opt_verbose > 0) {
+    std::cout << "[Info] stitched "
+              << stats.get_count("clusters_before_stitching")
+              << " tile clusters (" << stats.get_count("stitch_merges")
+              << " merges, " << stats.get_count("stitch_shared_triplets")
+              << " shared triplets)" << std::endl;
+  }
+
+  // Step 4) pruning by removal of small clusters ...
+  stats.start("pruning");
+  ExternalSorter<PointLabel> labels(dir, "labels", sort_bytes);
+  ok = outofcore_prune(owned_path, parent, opt.get_m(), opt_verbose, labels,
+                       stats);
+  remove(owned_path.c_str());
+  std::vector<size_t>().swap(parent);
+  size_t n_result = stats.get_count("clusters_after_pruning");
+  // .. and (optionally) by splitting up clusters at gaps > dmax
+  ExternalSorter<PointLabel> split_labels(dir, "split", sort_bytes);
+  if (ok && opt.is_dmax()) {
+    ok = outofcore_max_step(spool, labels, opt.get_dmax(), opt.get_m() + 2,
+                            dir, sort_bytes, split_labels, n_result);
+  }
+  stats.stop("pruning");
+  if (!ok) {
+    std::cerr << "[Error] cannot write to directory '" << dir << "'"
+              << std::endl;
+    return 2;
+  }
+  stats.set_count("clusters", n_result);
+
+  stats.start("output");
+  if (!write_outofcore_result(spool, opt.is_dmax() ? split_labels : labels,
+                              opt.get_ofprefix())) {
+    std::cerr << "[Error] cannot write result" << std::endl;
+    return 2;
+  }
+  stats.stop("output");
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Runs the algorithm on the infile of *opt* without loading all points
+// into memory. The points are spooled into a binary file in the
+// directory of option -outofcore, dnn is computed from spatial buckets
+// of this file, and the tiles of option -tile are written to files,
+// which are clustered independently and stitched (see run_tiled). The
+// result is written to stdout or to <prefix>.csv. Returns the exit
+// code for the command line tool.
+//-------------------------------------------------------------------
+int run_outofcore(Opt &opt, Stats &stats) {
+  const char *dir = opt.get_outofcoredir();
+#ifdef _WIN32
+  _mkdir(dir);
+#else
+  mkdir(dir, 0777);
+#endif
+  if (opt.get_engine() == ENGINE_MATRIXFREE && opt.get_linkage() != SINGLE) {
+    std::cerr << "[Error] engine 'matrixfree' requires single linkage"
+              << std::endl;
+    return 1;
+  }
+
+  SpoolFile spool;
+  spool.path = spool_path(dir, "points.bin");
+  stats.start("load");
+  int rc = spool_input(opt, spool);
+  stats.stop("load");
+  if (rc == 0 && spool.n == 0) {
+    std::cerr << "[Error] empty cloud in file '" << opt.get_ifname() << "'"
+              << std::endl
+              << "maybe you used the wrong delimiter" << std::endl;
+    rc = 2;
+  }
+  if (rc == 0) {
+    stats.set_count("points", spool.n);
+    rc = outofcore_steps(opt, spool, stats);
+  }
+  remove(spool.path.c_str());
+  return rc;
+}
@@ -0,0 +1,24 @@
+//
+// outofcore.h
+//     Clustering of point clouds that do not fit into memory. The points
+//     are spooled into tile files on disk and only one tile per thread
+//     is loaded at a time.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef OUTOFCORE_H
+#define OUTOFCORE_H
+
+#include "option.h"
+#include "stats.h"
+
+// runs the algorithm on the infile of *opt* with the tiles of option
+// -tile, using the directory of option -outofcore for the temporary
+// files, and writes the result to stdout or <prefix>.csv. Returns the
+// exit code for the command line tool.
+int run_outofcore(Opt &opt, Stats &stats);
+
+#endif
@@ -256,6 +256,22 @@ void clusters_to_gnuplot(const PointCloud &cloud,
             << pointstream.str() << "pause mouse keypress\n";
 }
 
+// prints the cluster ids of *p* separated by ';' (-1 for noise) to *out*
+void print_cluster_ids(const Point &p, std::ostream &out) {
+  if (p.cluster_ids.empty()) {
+    // Noise
+    out << "-1";
+  } else {
+    for (std::set<size_t>::const_iterator it = p.cluster_ids.begin();
+         it != p.cluster_ids.end(); ++it) {
+      if (it != p.cluster_ids.begin()) {
+        out << ";";
+      }
+      out << *it;
+    }
+  }
+}
+
 //-------------------------------------------------------------------
 // saves the PointCloud *cloud* with clusters as csv file.
 // The csv file has following form:
@@ -271,18 +287,35 @@ void clusters_to_csv(const PointCloud &cloud) {
   for (PointCloud::const_iterator it = cloud.begin(); it != cloud.end(); ++it) {
     std::cout << it->x << "," << it->y << ",";
     if (!is2d) std::cout << it->z << ",";
-    if (it->cluster_ids.empty()) {
-      // Noise
-      std::cout << "-1\n";
-    } else {
-      for (std::set<size_t>::const_iterator it2 = it->cluster_ids.begin();
-           it2 != it->cluster_ids.end(); ++it2) {
-        if (it2 != it->cluster_ids.begin()) {
-          std::cout << ";";
-        }
-        std::cout << *it2;
-      }
-      std::cout << std::endl;
+    print_cluster_ids(*it);
+    std::cout << std::endl;
+  }
+}
+
+//-------------------------------------------------------------------
+// prints the clusterings of the same points in *clouds* as csv with
+// one curveID column per clustering to stdout. *names* contains the
+// column names.
+//-------------------------------------------------------------------
+void clusters_to_csv(const std::vector<PointCloud> &clouds,
+                     const std::vector<std::string> &names) {
+  if (clouds.empty()) return;
+  const PointCloud &cloud = clouds[0];
+  bool is2d = cloud.is2d();
+  std::cout << std::fixed
+            << "# Comment: curveID -1 represents noise\n# x, y, z";
+  for (size_t j = 0; j < names.size(); ++j) {
+    std::cout << ", curveID(" << names[j] << ")";
+  }
+  std::cout << "\n";
+
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    std::cout << cloud[i].x << "," << cloud[i].y;
+    if (!is2d) std::cout << "," << cloud[i].z;
+    for (size_t j = 0; j < clouds.size(); ++j) {
+      std::cout << ",";
+      print_cluster_ids(clouds[j][i]);
     }
+    std::cout << std::endl;
   }
 }
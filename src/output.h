@@ -9,6 +9,10 @@
 
 #ifndef OUTPUT_H
 #define OUTPUT_H
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include "cluster.h"
 #include "pointcloud.h"
 
@@ -21,7 +25,13 @@ bool debug_gnuplot(const PointCloud &cloud, const PointCloud &cloud_smooth,
 // prints gnuplot script to stdout.
 void clusters_to_gnuplot(const PointCloud &cloud,
                          const std::vector<cluster_t> &clusters);
+// prints the cluster ids of *p* separated by ';' (-1 for noise).
+void print_cluster_ids(const Point &p, std::ostream &out = std::cout);
 // saves the PointCloud *cloud* with clusters *cluster* as csv file.
 void clusters_to_csv(const PointCloud &cloud);
+// saves several clusterings of the same points as csv with one
+// curveID column per clustering.
+void clusters_to_csv(const std::vector<PointCloud> &clouds,
+                     const std::vector<std::string> &names);
 
 #endif
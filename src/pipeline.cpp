@@ -0,0 +1,683 @@
+//
+// pipeline.cpp
+//     Steps 1) to 4) of the TriplClust algorithm as a single function.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cache.h"
+#include "collapse.h"
+#include "dendrofile.h"
+#include "dnn.h"
+#include "graph.h"
+#include "output.h"
+#include "pipeline.h"
+#include "tiling.h"
+#include "triplet.h"
+
+// names of the engines for messages
+const char *engine_name(HcEngine engine) {
+  if (engine == ENGINE_MATRIX) return "matrix";
+  if (engine == ENGINE_MATRIXFREE) return "matrixfree";
+  if (engine == ENGINE_DISK) return "disk";
+  if (engine == ENGINE_GRAPH) return "graph";
+  return "auto";
+}
+
+// appends the parameter *param* with the value *value* to the result
+// name *name* (e.g. "k=12,t=5") and file name suffix *suffix* ("_k12_t5")
+void add_param_name(PipelineResult &result, const char *param, double value,
+                    bool is_auto = false) {
+  std::ostringstream oss;
+  if (is_auto)
+    oss << "auto";
+  else
+    oss << value;
+  if (!result.name.empty()) result.name += ",";
+  result.name += std::string(param) + "=" + oss.str();
+  result.suffix += "_" + std::string(param) + oss.str();
+}
+
+// reports that the result of *step* has been loaded from the cache
+void cache_hit(const char *step, Opt &opt, Stats &stats) {
+  stats.count("cache_hits");
+  if (opt.get_verbosity() > 0) {
+    std::cout << "[Info] loaded " << step << " from cache" << std::endl;
+  }
+}
+
+// reports whether a result could be stored in the cache
+void cache_store(bool ok, Stats &stats) {
+  stats.count("cache_misses");
+  if (!ok) {
+    std::cerr << "[Error] could not write to cache directory" << std::endl;
+  }
+}
+
+//-------------------------------------------------------------------
+// Memory preflight: estimates the peak memory during the clustering of
+// *n_triplets* triplets and chooses the *engine* that fits into the
+// memory budget, which can be a matrix file in the directory -matrixdir
+// for other linkages than single, or the connected components for
+// single linkage when only fixed thresholds are given and the dendrogram
+// is not saved. *suffix* is appended to the names of
+// the statistics in *stats*. Returns the exit code for the command line
+// tool.
+//-------------------------------------------------------------------
+int choose_engine(const PointCloud &cloud, size_t n_triplets, Opt &opt,
+                  const std::string &suffix, HcEngine &engine,
+                  Stats &stats) {
+  Linkage linkage = opt.get_linkage();
+  double membudget = opt.get_membudget();
+  // original and smoothed cloud and the triplets
+  double mem_base = 2.0 * cloud.size() * sizeof(Point) +
+                    (double)n_triplets * sizeof(triplet);
+  double mem_matrix =
+      mem_base + estimate_hc_memory(n_triplets, linkage, ENGINE_MATRIX);
+  double mem_matrixfree =
+      mem_base + estimate_hc_memory(n_triplets, linkage, ENGINE_MATRIXFREE);
+  double mem_disk =
+      mem_base + estimate_hc_memory(n_triplets, linkage, ENGINE_DISK);
+  double mem_graph =
+      mem_base + estimate_hc_memory(n_triplets, linkage, ENGINE_GRAPH);
+  engine = opt.get_engine();
+  if (engine == ENGINE_AUTO) {
+    engine = ENGINE_MATRIX;
+    if (membudget > 0 && mem_matrix > membudget) {
+      bool fixed_t = !opt.get_dendrofile();
+      for (size_t i = 0; i < opt.get_n_thresholds(); ++i) {
+        if (opt.is_tauto(i)) fixed_t = false;
+      }
+      if (linkage == SINGLE && fixed_t)
+        engine = ENGINE_GRAPH;
+      else if (linkage == SINGLE)
+        engine = ENGINE_MATRIXFREE;
+      else if (opt.get_matrixdir())
+        engine = ENGINE_DISK;
+    }
+  }
+  if (engine == ENGINE_MATRIXFREE && linkage != SINGLE) {
+    std::cerr << "[Error] engine 'matrixfree' requires single linkage"
+              << std::endl;
+    return 1;
+  }
+  double mem_estimate = mem_matrix;
+  if (engine == ENGINE_MATRIXFREE) mem_estimate = mem_matrixfree;
+  if (engine == ENGINE_DISK) mem_estimate = mem_disk;
+  if (engine == ENGINE_GRAPH) mem_estimate = mem_graph;
+  stats.set_value("estimated_memory" + suffix, mem_estimate);
+  if (opt.get_verbosity() > 0 || opt.is_dryrun()) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(0) << mem_estimate;
+    std::cout << "[Info] estimated memory for clustering " << n_triplets
+              << " triplets: " << oss.str() << " bytes (engine '"
+              << engine_name(engine) << "')" << std::endl;
+  }
+  if (membudget > 0 && mem_estimate > membudget) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(0) << "[Error] estimated memory "
+        << mem_estimate << " bytes for clustering exceeds memory budget "
+        << membudget << " bytes";
+    std::cerr << oss.str() << std::endl;
+    if (linkage != SINGLE && !opt.get_matrixdir()) {
+      std::cerr << "Suggestion: use single linkage, which can be computed "
+                << "without distance matrix, or -matrixdir for storing "
+                << "the distance matrix in a file" << std::endl;
+    }
+    return 4;
+  }
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Removes the *triplets* of *cloud* without any other triplet at a
+// distance < -isolated, which are singletons in every clustering cut at
+// a distance up to -isolated. They are only kept when they stand for at
+// least m identical triplets, i.e. when the *weights* of the smoothed
+// points (if given) at their mid point are at least m. *suffix* is
+// appended to the names of the statistics in *stats*.
+//-------------------------------------------------------------------
+void remove_isolated(const PointCloud &cloud, std::vector<triplet> &triplets,
+                     Opt &opt, const std::vector<size_t> *weights,
+                     const std::string &suffix, Stats &stats) {
+  stats.start("isolated");
+  std::vector<bool> isolated;
+  find_isolated_triplets(cloud, triplets, opt.get_s(), opt.get_isolated(),
+                         isolated, opt.get_index());
+  std::vector<triplet> kept;
+  kept.reserve(triplets.size());
+  for (size_t i = 0; i < triplets.size(); ++i) {
+    if (!isolated[i] ||
+        (weights && (*weights)[triplets[i].point_index_b] >= opt.get_m())) {
+      kept.push_back(triplets[i]);
+    }
+  }
+  size_t n_removed = triplets.size() - kept.size();
+  triplets.swap(kept);
+  stats.stop("isolated");
+  stats.set_count("isolated_triplets" + suffix, n_removed);
+  if (opt.get_verbosity() > 0) {
+    std::cout << "[Info] removed " << n_removed << " isolated triplets"
+              << std::endl;
+  }
+}
+
+//-------------------------------------------------------------------
+// Step 4): cuts the *dendrogram* of the *triplets* at each threshold
+// in *opt* and prunes the clusters. Without dendrogram (engine 'graph'),
+// the single linkage clusters at each threshold are computed as the
+// connected components of the triplets of *cloud* instead. The results
+// are appended to *results*, and their names are *param* extended by
+// the threshold.
+// When the triplets consist of representatives with the points
+// *members* of *cloud*, the clusters are expanded to these points, and
+// *multiplicities* are the numbers of identical triplets they stand for.
+//-------------------------------------------------------------------
+void cut_and_prune(const PointCloud &cloud,
+                   const std::vector<triplet> &triplets,
+                   const Dendrogram *dendrogram, Opt &opt,
+                   const PipelineResult &param,
+                   std::vector<PipelineResult> &results, Stats &stats,
+                   const std::vector<cluster_t> *members = NULL,
+                   const std::vector<size_t> *multiplicities = NULL) {
+  int opt_verbose = opt.get_verbosity();
+
+  size_t n_thresholds = opt.get_n_thresholds();
+  for (size_t i = 0; i < n_thresholds; ++i) {
+    results.push_back(param);
+    PipelineResult &result = results.back();
+    if (n_thresholds > 1) {
+      add_param_name(result, "t", opt.get_t(i), opt.is_tauto(i));
+    }
+    cluster_group &cl_group = result.clusters;
+    // with several results, the counters get the parameters as suffix
+    const std::string &suffix = result.suffix;
+
+    stats.start("clustering");
+    if (dendrogram) {
+      cut_dendrogram(*dendrogram, cl_group, opt.get_t(i), opt.is_tauto(i),
+                     opt_verbose, NULL, multiplicities);
+    } else {
+      threshold_components(cloud, cl_group, triplets, opt.get_s(),
+                           opt.get_t(i), opt.get_index(), &stats);
+    }
+    stats.stop("clustering");
+    stats.set_count("clusters_before_pruning" + suffix, cl_group.size());
+
+    // Step 4) pruning by removal of small clusters ...
+    stats.start("pruning");
+    cleanup_cluster_group(cl_group, opt.get_m(), opt_verbose,
+                          multiplicities);
+    stats.set_count("clusters_after_pruning" + suffix, cl_group.size());
+    cluster_triplets_to_points(triplets, cl_group);
+    if (members) expand_clusters(*members, cl_group);
+    // .. and (optionally) by splitting up clusters at gaps > dmax
+    if (opt.is_dmax()) {
+      cluster_group cleaned_up_cluster_group;
+      size_t n_moved = 0;
+      for (cluster_group::iterator cl = cl_group.begin();
+           cl != cl_group.end(); ++cl) {
+        size_t n_before = cleaned_up_cluster_group.size();
+        max_step(cleaned_up_cluster_group, *cl, cloud, opt.get_dmax(),
+                 opt.get_m() + 2);
+        // the points outside the largest piece have been moved to
+        // another cluster or dropped
+        size_t n_kept = 0;
+        for (size_t k = n_before; k < cleaned_up_cluster_group.size(); ++k) {
+          n_kept = std::max(n_kept, cleaned_up_cluster_group[k].size());
+        }
+        n_moved += cl->size() - n_kept;
+      }
+      cl_group = cleaned_up_cluster_group;
+      stats.set_count("max_step_points_moved" + suffix, n_moved);
+    }
+    stats.stop("pruning");
+    stats.set_count("clusters" + suffix, cl_group.size());
+  }
+}
+
+//-------------------------------------------------------------------
+// Steps 3) and 4): clusters the *triplets* of *cloud* with *engine*
+// and prunes the clusters for each threshold in *opt*. The engine
+// 'graph' skips the dendrogram and the cache. The results are
+// appended to *results*, and their names are *param* extended by the
+// threshold. When *cache* is given, the dendrogram is looked up there
+// with a key derived from *triplets_key*. When a dendrogram file is
+// given in *opt*, the dendrogram is saved together with *cloud* and
+// *dnn*. *members* and *multiplicities* describe the representatives as
+// in cut_and_prune. Returns the exit code for the command line tool.
+//-------------------------------------------------------------------
+int cluster_triplets(const PointCloud &cloud,
+                     const std::vector<triplet> &triplets, Opt &opt,
+                     HcEngine engine, double dnn, const PipelineResult &param,
+                     std::vector<PipelineResult> &results, Stats &stats,
+                     const StageCache *cache, const CacheKey &triplets_key,
+                     const std::vector<cluster_t> *members = NULL,
+                     const std::vector<size_t> *multiplicities = NULL) {
+  if (engine == ENGINE_GRAPH) {
+    // Steps 3) and 4) at once
+    cut_and_prune(cloud, triplets, NULL, opt, param, results, stats, members,
+                  multiplicities);
+    return 0;
+  }
+
+  // Step 3) single link hierarchical clustering of the triplets; the
+  // dendrogram is computed once and cut at all thresholds
+  Dendrogram dendrogram;
+  CacheKey key = triplets_key;
+  key.add("dendrogram").add(opt.get_s()).add((size_t)opt.get_linkage());
+  // isolated triplets with a weight of at least m are kept
+  if (opt.get_isolated() > 0.0 && opt.get_m() > 1)
+    key.add("isolated").add(opt.get_isolated()).add(opt.get_m());
+  if (cache && cache->load_dendrogram(key, dendrogram) &&
+      dendrogram.n == triplets.size()) {
+    cache_hit("dendrogram", opt, stats);
+  } else {
+    stats.start("clustering");
+    try {
+      compute_dendrogram(cloud, dendrogram, triplets, opt.get_s(),
+                         opt.get_linkage(), engine, opt.get_verbosity(),
+                         &stats, opt.get_matrixdir(), opt.get_threads(),
+                         opt.get_threads_chunk());
+    } catch (const std::runtime_error &e) {
+      std::cerr << "[Error] " << e.what() << std::endl;
+      return 2;
+    } catch (const std::bad_alloc &e) {
+      std::cerr << "[Error] not enough memory for clustering "
+                << triplets.size() << " triplets" << std::endl
+                << "Suggestion: use -membudget for choosing an engine "
+                << "that fits into memory" << std::endl;
+      return 4;
+    }
+    stats.stop("clustering");
+    if (cache) cache_store(cache->save_dendrogram(key, dendrogram), stats);
+  }
+
+  if (opt.get_dendrofile()) {
+    stats.start("save_dendrogram");
+    bool ok = save_dendrogram(opt.get_dendrofile(), cloud, triplets,
+                              dendrogram, dnn);
+    stats.stop("save_dendrogram");
+    if (!ok) return 2;
+  }
+
+  // Step 4)
+  cut_and_prune(cloud, triplets, &dendrogram, opt, param, results, stats,
+                members, multiplicities);
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Loads *cloud* and the dendrogram from the file *fname* written with
+// the option -savedendro and runs step 4) for the thresholds in *opt*.
+// Returns the exit code for the command line tool.
+//-------------------------------------------------------------------
+int run_recut(const char *fname, PointCloud &cloud, Opt &opt,
+              std::vector<PipelineResult> &results, Stats &stats) {
+  std::vector<triplet> triplets;
+  Dendrogram dendrogram;
+  double dnn;
+  results.clear();
+
+  stats.start("load");
+  try {
+    load_dendrogram(fname, cloud, triplets, dendrogram, dnn);
+  } catch (const std::exception &e) {
+    std::cerr << "[Error] cannot read dendrogram file '" << fname << "'! "
+              << e.what() << std::endl;
+    return 2;
+  }
+  stats.stop("load");
+  stats.set_count("points", cloud.size());
+  stats.set_count("triplets", triplets.size());
+  stats.set_value("dnn", dnn);
+  opt.set_dnn(dnn);
+
+  cut_and_prune(cloud, triplets, &dendrogram, opt, PipelineResult(), results,
+                stats);
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Step 1): smoothing of *cloud* into *cloud_smooth*, which is looked
+// up in *cache* (if given) with a key derived from *key*. *weights*
+// are the weights of weighted representatives in *cloud* (or NULL).
+// When *unique* is given, the identical points of *cloud_smooth* are
+// collapsed into it, weighted with their number.
+//-------------------------------------------------------------------
+void smoothing(const PointCloud &cloud, const std::vector<size_t> *weights,
+               PointCloud &cloud_smooth, CollapsedCloud *unique, Opt &opt,
+               Stats &stats, const StageCache *cache, const CacheKey &key) {
+  if (cache && cache->load_cloud(key, cloud_smooth) &&
+      cloud_smooth.size() == cloud.size()) {
+    cache_hit("smoothed cloud", opt, stats);
+  } else {
+    cloud_smooth.clear();
+    stats.start("smoothing");
+    smoothen_cloud(cloud, cloud_smooth, opt.get_r(), opt.get_index(),
+                   weights, &stats);
+    stats.stop("smoothing");
+    if (cache) cache_store(cache->save_cloud(key, cloud_smooth), stats);
+  }
+  if (unique) {
+    stats.start("dedup");
+    collapse_duplicates(cloud_smooth, *unique);
+    stats.stop("dedup");
+    stats.set_count("smoothed_duplicates",
+                    cloud_smooth.size() - unique->cloud.size());
+  }
+
+  if (opt.get_verbosity() > 1) {
+    bool rc;
+    rc = cloud_to_csv(cloud_smooth);
+    if (!rc)
+      std::cerr << "[Error] can't write debug_smoothed.csv" << std::endl;
+    rc = debug_gnuplot(cloud, cloud_smooth);
+    if (!rc)
+      std::cerr << "[Error] can't write debug_smoothed.gnuplot" << std::endl;
+  }
+}
+
+//-------------------------------------------------------------------
+// Runs steps 1) to 4) of the algorithm on *cloud*, whose points are
+// weighted with *weights* in the smoothing (unless NULL). *opt* must
+// already be scaled with *dnn*. The results are looked up in *cache*
+// (if given) with keys derived from *cloud_key*. Returns the exit code
+// for the command line tool.
+//-------------------------------------------------------------------
+int run_steps(const PointCloud &cloud, const std::vector<size_t> *weights,
+              Opt &opt, double dnn, std::vector<PipelineResult> &results,
+              Stats &stats, const StageCache *cache,
+              const CacheKey &cloud_key) {
+  int opt_verbose = opt.get_verbosity();
+
+  // with -tile, steps 1) to 4) are done for each tile separately
+  if (opt.get_tile() > 0) {
+    results.push_back(PipelineResult());
+    return run_tiled(cloud, opt, results.back().clusters, stats, weights);
+  }
+
+  // Step 1) smoothing by position averaging of neighboring points; with
+  // a cache, this is only done when triplets need to be computed or when
+  // the identical smoothed points are collapsed with -dedup, so that the
+  // triplets are only computed for one of them
+  PointCloud cloud_smooth;
+  CollapsedCloud smooth_unique;
+  CollapsedCloud *unique = opt.is_dedup() ? &smooth_unique : NULL;
+  const PointCloud &triplet_cloud =
+      unique ? smooth_unique.cloud : cloud_smooth;
+  const std::vector<size_t> *triplet_weights =
+      unique ? &smooth_unique.weights : NULL;
+  bool smoothed = false;
+  // the index type is part of the keys, because it can change the order
+  // of neighbours with the same distance
+  CacheKey smooth_key = cloud_key;
+  smooth_key.add("smoothing").add(opt.get_r()).add((size_t)opt.get_index());
+  if (!cache || opt_verbose > 1 || unique) {
+    smoothing(cloud, weights, cloud_smooth, unique, opt, stats, cache,
+              smooth_key);
+    smoothed = true;
+  }
+
+  // Step 2) finding triplets of approximately collinear points; in a
+  // parameter sweep, the kd-tree is built once, the candidates are
+  // computed once for each k with the largest a, and the triplets for
+  // each combination of n and a are selected thereof
+  size_t n_k = opt.get_n_kvalues(), n_n = opt.get_n_nvalues(),
+         n_a = opt.get_n_avalues();
+  bool sweep = (n_k > 1 || n_n > 1 || n_a > 1);
+  TripletCandidates *candidates = NULL;
+  double amax = 0.0;
+  for (size_t ia = 0; ia < n_a; ++ia) amax = std::max(amax, opt.get_a(ia));
+
+  int rc = 0;
+  for (size_t ik = 0; ik < n_k && rc == 0; ++ik) {
+    bool candidates_generated = false;
+    for (size_t in = 0; in < n_n && rc == 0; ++in) {
+      for (size_t ia = 0; ia < n_a && rc == 0; ++ia) {
+        PipelineResult param;
+        if (n_k > 1) add_param_name(param, "k", opt.get_k(ik));
+        if (n_n > 1) add_param_name(param, "n", opt.get_n(in));
+        if (n_a > 1) add_param_name(param, "a", opt.get_a(ia));
+
+        std::vector<triplet> triplets;
+        CacheKey triplets_key = smooth_key;
+        triplets_key.add("triplets").add(opt.get_k(ik)).add(opt.get_n(in))
+            .add(opt.get_a(ia)).add((size_t)opt.get_index());
+        if (opt.get_owindow() > 0)
+          triplets_key.add("owindow").add(opt.get_owindow());
+        if (opt.get_knn_eps() > 0.0)
+          triplets_key.add("knn_eps").add(opt.get_knn_eps());
+        if (cache && cache->load_triplets(triplets_key, triplets)) {
+          cache_hit("triplets", opt, stats);
+        } else {
+          if (!smoothed) {
+            smoothing(cloud, weights, cloud_smooth, unique, opt, stats,
+                      cache, smooth_key);
+            smoothed = true;
+          }
+          stats.start("triplets");
+          if (sweep) {
+            if (!candidates_generated) {
+              if (!candidates)
+                candidates = new TripletCandidates(
+                    triplet_cloud, opt.get_index(), triplet_weights, &stats);
+              candidates->generate(opt.get_k(ik), amax, opt.get_owindow(),
+                                   opt.get_knn_eps(), &stats);
+              candidates_generated = true;
+            }
+            candidates->select(opt.get_n(in), opt.get_a(ia), triplets);
+          } else {
+            generate_triplets(triplet_cloud, triplets, opt.get_k(),
+                              opt.get_n(), opt.get_a(), opt.get_owindow(),
+                              opt.get_knn_eps(), opt.get_index(),
+                              triplet_weights, &stats);
+          }
+          stats.stop("triplets");
+          if (cache) {
+            cache_store(cache->save_triplets(triplets_key, triplets), stats);
+          }
+        }
+        if (sweep) {
+          stats.set_count("triplets" + param.suffix, triplets.size());
+          if (opt_verbose > 0) {
+            std::cout << "[Info] " << param.name << ": " << triplets.size()
+                      << " triplets" << std::endl;
+          }
+        } else if (cache) {
+          stats.set_count("triplets", triplets.size());
+        }
+
+        // triplets that cannot reach a cluster of m triplets
+        if (opt.get_isolated() > 0.0 && opt.get_m() > 1) {
+          remove_isolated(triplet_cloud, triplets, opt, triplet_weights,
+                          param.suffix, stats);
+        }
+
+        // memory preflight
+        HcEngine engine;
+        rc = choose_engine(cloud, triplets.size(), opt, param.suffix, engine,
+                           stats);
+        if (rc != 0 || opt.is_dryrun()) continue;
+
+        // Steps 3) and 4); each triplet of a distinct smoothed point
+        // stands for one triplet of each of its identical points
+        std::vector<size_t> multiplicities;
+        if (unique) {
+          multiplicities.reserve(triplets.size());
+          for (size_t i = 0; i < triplets.size(); ++i) {
+            multiplicities.push_back(
+                smooth_unique.weights[triplets[i].point_index_b]);
+          }
+        }
+        rc = cluster_triplets(cloud, triplets, opt, engine, dnn, param,
+                              results, stats, cache, triplets_key,
+                              unique ? &smooth_unique.members : NULL,
+                              unique ? &multiplicities : NULL);
+      }
+    }
+  }
+  delete candidates;
+  return rc;
+}
+
+//-------------------------------------------------------------------
+// Computes dnn and runs steps 1) to 4) of the algorithm on *cloud* or,
+// with -voxel or -dedup, on its voxel representatives or its distinct
+// points. Returns the exit code for the command line tool.
+//-------------------------------------------------------------------
+int run_pipeline(const PointCloud &cloud, Opt &opt,
+                 std::vector<PipelineResult> &results, Stats &stats) {
+  int opt_verbose = opt.get_verbosity();
+  results.clear();
+
+  // tiles are clustered with a single parameter combination only
+  bool tiled = (opt.get_tile() > 0);
+  if (tiled && (opt.get_n_kvalues() > 1 || opt.get_n_nvalues() > 1 ||
+                opt.get_n_avalues() > 1 || opt.get_n_thresholds() > 1)) {
+    std::cerr << "[Error] -tile cannot be used with several values "
+              << "for -k, -n, -a or -t" << std::endl;
+    return 1;
+  }
+  if (tiled && (opt.get_dendrofile() || opt.get_cachedir() ||
+                opt.is_dryrun())) {
+    std::cerr << "[Error] -tile cannot be used with -savedendro, -cache "
+              << "or -dry-run" << std::endl;
+    return 1;
+  }
+
+  // with -cache, the result of each step is looked up in the cache
+  // directory with a key of the input cloud and the parameters of all
+  // steps up to this step
+  StageCache *cache = NULL;
+  CacheKey cloud_key;
+  if (opt.get_cachedir()) {
+    cache = new StageCache(opt.get_cachedir());
+    cloud_key.add(cloud);
+  }
+
+  // with -dedup, identical points are collapsed into one point as with
+  // "sort -u", so that they neither make dnn zero nor fill the
+  // neighbourhoods, and they get the labels of their representative
+  CollapsedCloud unique;
+  if (opt.is_dedup()) {
+    stats.start("dedup");
+    collapse_duplicates(cloud, unique);
+    stats.stop("dedup");
+    stats.set_count("duplicates", cloud.size() - unique.cloud.size());
+    if (opt_verbose > 0) {
+      std::cout << "[Info] collapsed " << cloud.size() << " points into "
+                << unique.cloud.size() << " distinct points" << std::endl;
+    }
+    cloud_key.add("dedup");
+  }
+  const PointCloud &points = opt.is_dedup() ? unique.cloud : cloud;
+
+  // compute characteristic length dnn if needed (it is also stored
+  // in the dendrogram file for -dmax in recut mode); with -dnn-sample,
+  // it is estimated from a random sample of the points, which yields
+  // the same value when the sample contains all points
+  double dnn = 0.0;
+  if (opt.needs_dnn() || opt.get_dendrofile()) {
+    CacheKey key = cloud_key;
+    key.add("dnn").add((size_t)opt.get_index());
+    bool sampled = (opt.get_dnn_sample() > 0);
+    size_t n_samples = std::min(opt.get_dnn_sample(), points.size());
+    if (n_samples < points.size()) key.add("sample").add(n_samples);
+    double lower = 0.0, upper = 0.0;
+    bool computed = false;
+    if (cache && cache->load_dnn(key, dnn)) {
+      cache_hit("dnn", opt, stats);
+    } else {
+      stats.start("dnn");
+      if (sampled) {
+        dnn = std::sqrt(sampled_first_quartile(points, n_samples,
+                                               lower, upper,
+                                               opt.get_index(), &stats,
+                                               opt.get_threads()));
+        lower = std::sqrt(lower);
+        upper = std::sqrt(upper);
+        stats.set_value("dnn_lower", lower);
+        stats.set_value("dnn_upper", upper);
+      } else {
+        dnn = std::sqrt(first_quartile(points, opt.get_index(), &stats,
+                                       opt.get_threads()));
+      }
+      stats.stop("dnn");
+      computed = true;
+      if (cache) cache_store(cache->save_dnn(key, dnn), stats);
+    }
+    stats.set_value("dnn", dnn);
+    if (opt_verbose > 0) {
+      if (sampled && computed) {
+        std::cout << "[Info] estimated dnn from " << n_samples
+                  << " points: " << dnn << " (95% confidence interval ["
+                  << lower << ", " << upper << "])" << std::endl;
+      } else {
+        std::cout << "[Info] computed dnn: " << dnn << std::endl;
+      }
+    }
+    opt.set_dnn(dnn);
+    if (dnn == 0.0 && opt.needs_dnn()) {
+      std::cerr << "[Error] dnn computed as zero.";
+      if (!opt.is_dedup())
+        std::cerr << " Suggestion: collapse doublets with -dedup";
+      std::cerr << std::endl;
+      delete cache;
+      return 3;
+    }
+#ifdef TRIPLCLUST_FLOAT
+    // single precision coordinates with a large offset (e.g. geographic
+    // coordinates) cannot resolve distances well below dnn
+    if (max_abs_coordinate(cloud) * FLT_EPSILON > 0.01 * dnn) {
+      std::cerr << "[Warning] coordinates too large for single precision; "
+                << "use triplclust instead of triplclust-float" << std::endl;
+    }
+#endif
+  }
+
+  // optional voxel downsampling: steps 1) to 4) are done on one weighted
+  // representative per voxel, and the clusters are propagated back to
+  // all points of the voxels
+  int rc;
+  if (opt.get_voxel() > 0) {
+    CollapsedCloud voxels;
+    stats.start("voxel");
+    voxel_downsample(cloud, opt.get_voxel(), voxels);
+    stats.stop("voxel");
+    stats.set_count("voxels", voxels.cloud.size());
+    if (opt_verbose > 0) {
+      std::cout << "[Info] collapsed " << cloud.size() << " points into "
+                << voxels.cloud.size() << " voxels" << std::endl;
+    }
+    cloud_key.add("voxel").add(opt.get_voxel());
+    rc = run_steps(voxels.cloud, &voxels.weights, opt, dnn, results, stats,
+                   cache, cloud_key);
+    for (size_t i = 0; i < results.size(); ++i) {
+      expand_clusters(voxels.members, results[i].clusters);
+    }
+  } else if (opt.is_dedup()) {
+    rc = run_steps(unique.cloud, NULL, opt, dnn, results, stats, cache,
+                   cloud_key);
+    for (size_t i = 0; i < results.size(); ++i) {
+      expand_clusters(unique.members, results[i].clusters);
+    }
+  } else {
+    rc = run_steps(cloud, NULL, opt, dnn, results, stats, cache, cloud_key);
+  }
+  delete cache;
+  return rc;
+}
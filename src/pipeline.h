@@ -0,0 +1,59 @@
+//
+// pipeline.h
+//     Steps 1) to 4) of the TriplClust algorithm as a single function.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <vector>
+
+#include "cluster.h"
+#include "option.h"
+#include "pointcloud.h"
+#include "stats.h"
+
+// names of the engines for messages
+const char *engine_name(HcEngine engine);
+
+// result of the pipeline for one combination of parameters
+struct PipelineResult {
+  // parameters with several values, e.g. "k=12,t=5", and as file
+  // name suffix, e.g. "_k12_t5" (both empty for a single result)
+  std::string name;
+  std::string suffix;
+  // clusters of point indices
+  cluster_group clusters;
+};
+
+//-------------------------------------------------------------------
+// Runs smoothing, triplet generation, clustering and pruning on
+// *cloud* with the parameters *opt*. When lists of values are given
+// for k, n, a (parameter sweep) or t, the results for all combinations
+// are stored in *results*. The neighbor search is done only once for
+// the largest k and a, and the dendrogram is computed only once for
+// all thresholds t. When *opt* needs dnn, it is computed and set in
+// *opt*. With a voxel size in *opt*, the steps are run on one weighted
+// representative per voxel and the clusters in *results* are propagated
+// back to all points of *cloud*. Error messages are printed to stderr
+// and the return value is the exit code for the command line tool
+// (0 = success). In dry-run mode, *results* stays empty.
+//-------------------------------------------------------------------
+int run_pipeline(const PointCloud &cloud, Opt &opt,
+                 std::vector<PipelineResult> &results, Stats &stats);
+
+//-------------------------------------------------------------------
+// Loads *cloud* and the dendrogram from the file *fname* written with
+// the option -savedendro, cuts it at the thresholds in *opt* and prunes
+// the clusters (-m, -dmax) without recomputing the earlier steps. The
+// results and the return value are as for run_pipeline.
+//-------------------------------------------------------------------
+int run_recut(const char *fname, PointCloud &cloud, Opt &opt,
+              std::vector<PipelineResult> &results, Stats &stats);
+
+#endif
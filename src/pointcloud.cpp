@@ -16,26 +16,30 @@
 
 #include "kdtree/kdtree.hpp"
 #include "pointcloud.h"
+#include "spatialindex.h"
+#include "stats.h"
 #include "util.h"
 
 // a single 3D point
-Point::Point(const std::vector<double> &point) {
-  if (point.size() != 3) {
-    throw std::invalid_argument("Point::Point(): point must be of dimension 3");
+Point::Point(const std::vector<coord_t> &point) {
+  if (point.size() != 2 && point.size() != 3) {
+    throw std::invalid_argument(
+        "Point::Point(): point must be of dimension 2 or 3");
   }
   this->x = point[0];
   this->y = point[1];
-  this->z = point[2];
+  this->z = (point.size() == 3) ? point[2] : 0.0;
 }
 
-Point::Point(const std::vector<double> &point,
+Point::Point(const std::vector<coord_t> &point,
              const std::set<size_t> &cluster_ids) {
-  if (point.size() != 3) {
-    throw std::invalid_argument("Point::Point(): point must be of dimension 3");
+  if (point.size() != 2 && point.size() != 3) {
+    throw std::invalid_argument(
+        "Point::Point(): point must be of dimension 2 or 3");
   }
   this->x = point[0];
   this->y = point[1];
-  this->z = point[2];
+  this->z = (point.size() == 3) ? point[2] : 0.0;
   this->cluster_ids = cluster_ids;
 }
 
@@ -61,12 +65,13 @@ Point::Point(double x, double y, double z, size_t index) {
 }
 
 
-// representation of 3D point as std::vector.
-std::vector<double> Point::as_vector() const {
-  std::vector<double> point(3);
+// representation of the point as std::vector with *dimension* (2 or 3)
+// coordinates.
+std::vector<coord_t> Point::as_vector(size_t dimension) const {
+  std::vector<coord_t> point(dimension);
   point[0] = this->x;
   point[1] = this->y;
-  point[2] = this->z;
+  if (dimension > 2) point[2] = this->z;
   return point;
 }
 
@@ -128,57 +133,58 @@ Point operator*(double c, Point x) {
   return v;
 }
 
-PointCloud::PointCloud() { this->points2d = false; }
+PointCloud::PointCloud() {
+  this->points2d = false;
+  this->ordered = false;
+}
 
 void PointCloud::set2d(bool is2d) { this->points2d = is2d; }
 
 bool PointCloud::is2d() const { return this->points2d; }
 
+// 2D clouds are searched in the xy plane, so that the kd-trees do not
+// split along the constant z axis
+size_t PointCloud::dimension() const { return this->points2d ? 2 : 3; }
+
 
 void PointCloud::setOrdered(bool ordered) {this->ordered=ordered;}
  
 bool PointCloud::isOrdered() const { return this->ordered; }
 
 
-// Split string *input* into substrings by *delimiter*. The result is
-// returned in *result*
-void split(const std::string &input, std::vector<std::string> &result,
-           const char delimiter) {
-  std::stringstream ss(input);
-  std::string element;
-
-  while (std::getline(ss, element, delimiter)) {
-    result.push_back(element);
-  }
-}
-
 //-------------------------------------------------------------------
-// Load csv file.
-// The csv file is split by *delimiter* and saved in *cloud*.
-// Lines starting with '#' are ignored.
-// If there are more than 3 columns all other are ignored and
-// if there are two columns the PointCloud is set to 2D.
-// Throws invalid_argument exception in case of problems.
+// Opens the csv file *fname* with columns separated by *delimiter* and
+// skips the first *skip* lines. Throws std::exception if the file
+// cannot be opened.
 //-------------------------------------------------------------------
-void load_csv_file(const char *fname, PointCloud &cloud, const char delimiter,
-                   size_t skip) {
-  std::ifstream infile(fname);
+CsvReader::CsvReader(const char *fname, const char delimiter, size_t skip)
+    : infile(fname),
+      delimiter(delimiter),
+      count(0),
+      skiped(0),
+      countpoints(0),
+      count2d(0) {
   std::string line;
-  std::vector<std::string> items;
-  size_t count = 0, count2d = 0, skiped = 0, countpoints = 0;
-  //size_t countOrdered = 0; //!
   if (infile.fail()) throw std::exception();
   for (size_t i = 0; i < skip; ++i) {
     // skip the header
     std::getline(infile, line, '\n');
     skiped++;
   }
+}
+
+//-------------------------------------------------------------------
+// Reads the next point into *point*.
+// Lines starting with '#' are ignored.
+// If there are more than 3 columns all other are ignored and
+// if there are two columns z is set to zero.
+// Returns false at the end of the file and throws invalid_argument
+// exception in case of problems.
+//-------------------------------------------------------------------
+bool CsvReader::next(Point &point) {
+  std::string line;
+  std::vector<std::string> items;
   while (!infile.eof()) {
-#ifdef WEBDEMO
-    if (countpoints > 1000)
-      throw std::length_error("Number of points limited to 1000 in demo mode");
-#endif
-    //std::getline(infile, line, '\n');
     std::getline(infile, line, '\n');
     count++;
 
@@ -188,7 +194,6 @@ void load_csv_file(const char *fname, PointCloud &cloud, const char delimiter,
       continue;
 
     countpoints++;
-    Point point;
     split(line, items, delimiter);
     if (items.size() < 2) {
       std::ostringstream oss;
@@ -208,18 +213,42 @@ void load_csv_file(const char *fname, PointCloud &cloud, const char delimiter,
       column++;
       point.z = stod(items[2].c_str());
       point.index = countpoints-1;
-      cloud.push_back(point);
     } catch (const std::invalid_argument &e) {
       std::ostringstream oss;
       oss << "row " << count + skiped << " column " << column << ": "
           << e.what();
       throw std::invalid_argument(oss.str());
     }
+    return true;
+  }
+  return false;
+}
 
-    items.clear();
+size_t CsvReader::points() const { return this->countpoints; }
+size_t CsvReader::points2d() const { return this->count2d; }
+
+//-------------------------------------------------------------------
+// Load csv file.
+// The csv file is split by *delimiter* and saved in *cloud*.
+// Lines starting with '#' are ignored.
+// If there are more than 3 columns all other are ignored and
+// if there are two columns the PointCloud is set to 2D.
+// Throws invalid_argument exception in case of problems.
+//-------------------------------------------------------------------
+void load_csv_file(const char *fname, PointCloud &cloud, const char delimiter,
+                   size_t skip) {
+  CsvReader reader(fname, delimiter, skip);
+  Point point;
+  while (reader.next(point)) {
+#ifdef WEBDEMO
+    if (reader.points() > 1000)
+      throw std::length_error("Number of points limited to 1000 in demo mode");
+#endif
+    cloud.push_back(point);
   }
 
   // check if the cloud is 2d or if a problem occurred
+  size_t count2d = reader.points2d();
   if (count2d && count2d != cloud.size()) {
     throw std::invalid_argument("Mixed 2d and 3d points.");
   } else if (count2d) {
@@ -227,16 +256,40 @@ void load_csv_file(const char *fname, PointCloud &cloud, const char delimiter,
   }
 }
 
+//-------------------------------------------------------------------
+// Returns the largest absolute value of the coordinates of all points
+// in *cloud*. This limits the resolution of single precision
+// coordinates.
+//-------------------------------------------------------------------
+double max_abs_coordinate(const PointCloud &cloud) {
+  double result = 0.0;
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    result = std::max(result, std::fabs((double)cloud[i].x));
+    result = std::max(result, std::fabs((double)cloud[i].y));
+    result = std::max(result, std::fabs((double)cloud[i].z));
+  }
+  return result;
+}
+
+// order of KdNodes by their index
+bool node_index_less(const Kdtree::KdNode &a, const Kdtree::KdNode &b) {
+  return a.index < b.index;
+}
+
 //-------------------------------------------------------------------
 // Smoothing of the PointCloud *cloud*.
 // For every point the nearest neighbours in the radius *r* is searched
 // and the centroid of this neighbours is computed. The result is
 // returned in *result_cloud* and contains these centroids. The
 // centroids are duplicated in the result cloud, so it has the same
-// size and order as *cloud*.
+// size and order as *cloud*. The neighbours are searched with the
+// spatial index of type *index*. When *weights* is given, the points
+// represent *weights* points each and the centroids are weighted
+// accordingly. When *stats* is given, the index build time is recorded.
 //-------------------------------------------------------------------
 void smoothen_cloud(const PointCloud &cloud, PointCloud &result_cloud,
-                    double r) {
+                    double r, IndexType index,
+                    const std::vector<size_t> *weights, Stats *stats) {
   Kdtree::KdNodeVector nodes;
 
   // If the smooth-radius is zero return the unsmoothed pointcloud
@@ -245,19 +298,43 @@ void smoothen_cloud(const PointCloud &cloud, PointCloud &result_cloud,
     return;
   }
 
-  // build kdtree
+  // build spatial index
+  const size_t dimension = cloud.dimension();
   for (size_t i = 0; i < cloud.size(); ++i) {
-    nodes.push_back(cloud[i].as_vector());
+    nodes.push_back(
+        Kdtree::KdNode(cloud[i].as_vector(dimension), NULL, (int)i));
   }
-  Kdtree::KdTree kdtree(&nodes);
+  SpatialIndex *spatial_index = build_spatial_index(&nodes, index, 0, r, stats);
 
   for (size_t i = 0; i < cloud.size(); ++i) {
     size_t result_size;
     Point new_point, point = cloud[i];
     Kdtree::KdNodeVector result;
 
-    kdtree.range_nearest_neighbors(point.as_vector(), r, &result);
+    spatial_index->range_nearest_neighbors(point.as_vector(dimension), r,
+                                           &result);
     result_size = result.size();
+    // the sum must not depend on the order of the neighbours in the index
+    std::sort(result.begin(), result.end(), node_index_less);
+
+    if (weights) {
+      // compute the centroid with weighted mean
+      double sum_x = 0.0, sum_y = 0.0, sum_z = 0.0, sum_w = 0.0;
+      for (Kdtree::KdNodeVector::iterator it = result.begin();
+           it != result.end(); ++it) {
+        double w = (double)(*weights)[it->index];
+        sum_x += w * it->point[0];
+        sum_y += w * it->point[1];
+        if (dimension > 2) sum_z += w * it->point[2];
+        sum_w += w;
+      }
+      new_point.x = sum_x / sum_w;
+      new_point.y = sum_y / sum_w;
+      new_point.z = (dimension > 2) ? sum_z / sum_w : 0.0;
+      new_point.index = point.index;
+      result_cloud.push_back(new_point);
+      continue;
+    }
 
     // compute the centroid with mean
     std::vector<double> x_list;
@@ -268,7 +345,7 @@ void smoothen_cloud(const PointCloud &cloud, PointCloud &result_cloud,
          ++it) {
       x_list.push_back(it->point[0]);
       y_list.push_back(it->point[1]);
-      z_list.push_back(it->point[2]);
+      if (dimension > 2) z_list.push_back(it->point[2]);
     }
 
     new_point.x =
@@ -278,10 +355,14 @@ void smoothen_cloud(const PointCloud &cloud, PointCloud &result_cloud,
         std::accumulate(y_list.begin(), y_list.end(), 0.0) / result_size;
 
     new_point.z =
-        std::accumulate(z_list.begin(), z_list.end(), 0.0) / result_size;
+        (dimension > 2)
+            ? std::accumulate(z_list.begin(), z_list.end(), 0.0) / result_size
+            : 0.0;
 
     new_point.index = point.index;
     result_cloud.push_back(new_point);
   }
+  delete spatial_index;
+  result_cloud.set2d(cloud.is2d());
   result_cloud.setOrdered(cloud.isOrdered());
 }
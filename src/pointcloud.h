@@ -9,6 +9,7 @@
 
 #ifndef POINTCLOUD_H
 #define POINTCLOUD_H
+#include <cmath>
 #include <cstddef>
 #include <fstream>
 #include <iostream>
@@ -16,24 +17,37 @@
 #include <set>
 #include <vector>
 
+#include "util.h"
+
+class Stats;
+
+// floating point type of the coordinates (single precision when compiled
+// with -DTRIPLCLUST_FLOAT, i.e. the target triplclust-float)
+#ifdef TRIPLCLUST_FLOAT
+typedef float coord_t;
+#else
+typedef double coord_t;
+#endif
+
 // 3D point class.
 class Point {
  public:
-  double x;
-  double y;
-  double z;
+  coord_t x;
+  coord_t y;
+  coord_t z;
   std::set<size_t> cluster_ids;
   size_t index;    // only used for chronological order
 
   Point(){};
-  Point(const std::vector<double>& point);
-  Point(const std::vector<double>& point, const std::set<size_t>& cluster_ids);
+  Point(const std::vector<coord_t>& point);
+  Point(const std::vector<coord_t>& point, const std::set<size_t>& cluster_ids);
   Point(double x, double y, double z);
   Point(double x, double y, double z, const std::set<size_t>& cluster_ids);
   Point(double x, double y, double z, size_t index);
 
-  // representation of 3D point as std::vector
-  std::vector<double> as_vector() const;
+  // representation of the point as std::vector; for *dimension* 2,
+  // the z coordinate is omitted
+  std::vector<coord_t> as_vector(size_t dimension = 3) const;
   // Euclidean norm
   double norm() const;
   // squared norm
@@ -56,6 +70,82 @@ class Point {
 Point operator*(Point x, double c);
 Point operator*(double c, Point x);
 
+// Point with the *D* coordinates of a cloud of dimension D (see
+// PointCloud::dimension) and without cluster ids and index, so that the
+// triplet geometry of 2D clouds is computed without the z axis. The
+// arithmetic is the same as for Point.
+template <size_t D>
+class PointD {
+ public:
+  coord_t c[D];
+
+  PointD() {}
+  // the first D coordinates of *p*
+  explicit PointD(const Point &p) {
+    const coord_t xyz[3] = {p.x, p.y, p.z};
+    for (size_t k = 0; k < D; ++k) this->c[k] = xyz[k];
+  }
+  // the D coordinates in *x*
+  explicit PointD(const coord_t *x) {
+    for (size_t k = 0; k < D; ++k) this->c[k] = x[k];
+  }
+  // the first D coordinates of *p*, padded with zeros
+  template <size_t E>
+  explicit PointD(const PointD<E> &p) {
+    for (size_t k = 0; k < D; ++k) this->c[k] = (k < E) ? p.c[k] : 0;
+  }
+
+  coord_t &operator[](size_t k) { return this->c[k]; }
+  const coord_t &operator[](size_t k) const { return this->c[k]; }
+  // representation as std::vector with the first *dimension* coordinates
+  std::vector<coord_t> as_vector(size_t dimension = D) const {
+    std::vector<coord_t> point(dimension, 0);
+    for (size_t k = 0; k < dimension && k < D; ++k) point[k] = this->c[k];
+    return point;
+  }
+  // squared norm
+  double squared_norm() const { return (*this) * (*this); }
+  // Euclidean norm
+  double norm() const { return std::sqrt(this->squared_norm()); }
+
+  // vector addition
+  PointD operator+(const PointD &p) const {
+    PointD ret;
+    for (size_t k = 0; k < D; ++k) ret.c[k] = this->c[k] + p.c[k];
+    return ret;
+  }
+  // vector subtraction
+  PointD operator-(const PointD &p) const {
+    PointD ret;
+    for (size_t k = 0; k < D; ++k) ret.c[k] = this->c[k] - p.c[k];
+    return ret;
+  }
+  // scalar product
+  double operator*(const PointD &p) const {
+    coord_t sum = this->c[0] * p.c[0];
+    for (size_t k = 1; k < D; ++k) sum += this->c[k] * p.c[k];
+    return sum;
+  }
+  // scalar division
+  PointD operator/(double c) const {
+    PointD ret;
+    for (size_t k = 0; k < D; ++k) ret.c[k] = this->c[k] / c;
+    return ret;
+  }
+};
+
+// scalar multiplication
+template <size_t D>
+PointD<D> operator*(const PointD<D> &x, double c) {
+  PointD<D> ret;
+  for (size_t k = 0; k < D; ++k) ret.c[k] = c * x.c[k];
+  return ret;
+}
+template <size_t D>
+PointD<D> operator*(double c, const PointD<D> &x) {
+  return x * c;
+}
+
 // The Pointcloud is a vector of points
 class PointCloud : public std::vector<Point> {
  private:
@@ -65,17 +155,45 @@ class PointCloud : public std::vector<Point> {
  public:
   bool is2d() const;
   void set2d(bool is2d);
+  // number of coordinates in the kd-trees (2 for 2D clouds, else 3)
+  size_t dimension() const;
   bool isOrdered() const;   //!
   void setOrdered(bool isOrdered);  //!
   PointCloud();
 };
 
 
+// Reader for the points of a csv file one by one, so that files
+// larger than the memory can be processed.
+class CsvReader {
+ private:
+  std::ifstream infile;
+  char delimiter;
+  size_t count, skiped, countpoints, count2d;
+  // not copyable
+  CsvReader(const CsvReader &);
+  CsvReader &operator=(const CsvReader &);
+
+ public:
+  CsvReader(const char *fname, const char delimiter, size_t skip = 0);
+  // reads the next point; returns false at the end of the file
+  bool next(Point &point);
+  // number of points read so far and how many of them are 2D
+  size_t points() const;
+  size_t points2d() const;
+};
+
 // Load csv file.
 void load_csv_file(const char* fname, PointCloud& cloud, const char delimiter,
                    size_t skip = 0);
+// largest absolute value of the coordinates in *cloud*
+double max_abs_coordinate(const PointCloud& cloud);
+
 // Smoothing of the PointCloud *cloud*. The result is returned in *result_cloud*
+// (with *weights*, the points are weighted representatives)
 void smoothen_cloud(const PointCloud& cloud, PointCloud& result_cloud,
-                    double radius);
+                    double radius, IndexType index = INDEX_KDTREE,
+                    const std::vector<size_t>* weights = NULL,
+                    Stats* stats = NULL);
 
 #endif
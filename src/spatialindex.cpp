@@ -0,0 +1,374 @@
+//
+// spatialindex.cpp
+//     Common interface of the kd-tree and the uniform grid for the
+//     neighbour searches, and the choice between them.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#include "gridindex.h"
+#include "spatialindex.h"
+#include "stats.h"
+
+// the grid has at most this many cells per node
+const double max_cells_per_node = 2.0;
+
+// for kNN searches with k neighbours, the non-empty cells should contain
+// k/knn_cell_fraction nodes on average, but at least one
+const double knn_cell_fraction = 4.0;
+
+// INDEX_AUTO chooses the kd-tree when a node shares its grid cell with
+// more than this many nodes on average (in kNN searches per neighbour)
+const double max_auto_range_load = 256.0;
+const double max_auto_knn_load = 8.0;
+
+//-------------------------------------------------------------------
+// kd-tree
+//-------------------------------------------------------------------
+KdTreeIndex::KdTreeIndex(const Kdtree::KdNodeVector *nodes)
+    : kdtree(nodes) {}
+
+Kdtree::KdTree *KdTreeIndex::get_kdtree() { return &this->kdtree; }
+
+void KdTreeIndex::k_nearest_neighbors(const Kdtree::CoordPoint &point,
+                                      size_t k, Kdtree::KdNodeVector *result,
+                                      std::vector<double> *distances) {
+  distances->clear();
+  this->kdtree.k_nearest_neighbors(point, k, result, distances);
+}
+
+void KdTreeIndex::range_nearest_neighbors(const Kdtree::CoordPoint &point,
+                                          double r,
+                                          Kdtree::KdNodeVector *result) {
+  this->kdtree.range_nearest_neighbors(point, r, result);
+}
+
+//-------------------------------------------------------------------
+// bounding box of *nodes* in the first *dimension* coordinates
+//-------------------------------------------------------------------
+void bounding_box(const Kdtree::KdNodeVector &nodes, size_t dimension,
+                  double *lo, double *hi) {
+  for (size_t d = 0; d < dimension; ++d) {
+    lo[d] = hi[d] = nodes[0].point[d];
+  }
+  for (size_t i = 1; i < nodes.size(); ++i) {
+    for (size_t d = 0; d < dimension; ++d) {
+      lo[d] = std::min(lo[d], (double)nodes[i].point[d]);
+      hi[d] = std::max(hi[d], (double)nodes[i].point[d]);
+    }
+  }
+}
+
+// number of cells along each axis of the bounding box *lo*, *hi*
+double grid_cells(const double *lo, const double *hi, size_t dimension,
+                  double cellsize, long *dims) {
+  double n_cells = 1.0;
+  for (size_t d = 0; d < dimension; ++d) {
+    dims[d] = (long)std::floor((hi[d] - lo[d]) / cellsize) + 1;
+    n_cells *= (double)dims[d];
+  }
+  return n_cells;
+}
+
+// smallest cell size not smaller than *cellsize*, for which the grid
+// over the bounding box has at most max_cells_per_node cells per node
+double limit_cellsize(const double *lo, const double *hi, size_t dimension,
+                      size_t n_nodes, double cellsize) {
+  long dims[3];
+  double max_cells = max_cells_per_node * n_nodes + 1.0;
+  if (!(cellsize > 0.0)) {
+    double extent = 0.0;
+    for (size_t d = 0; d < dimension; ++d)
+      extent = std::max(extent, hi[d] - lo[d]);
+    cellsize = (extent > 0.0) ? extent : 1.0;
+  }
+  double n_cells = grid_cells(lo, hi, dimension, cellsize, dims);
+  while (n_cells > max_cells) {
+    cellsize *= std::max(std::pow(n_cells / max_cells, 1.0 / dimension),
+                         1.01);
+    n_cells = grid_cells(lo, hi, dimension, cellsize, dims);
+  }
+  return cellsize;
+}
+
+//-------------------------------------------------------------------
+// Builds the grid with edge length *cellsize* over the bounding box of
+// *nodes*. When the grid would have too many cells, the cell size is
+// increased. The nodes are sorted by their cell with a counting sort.
+//-------------------------------------------------------------------
+CellGrid::CellGrid(const Kdtree::KdNodeVector *nodes, double cellsize) {
+  double hi[3];
+  this->dimension = (*nodes)[0].point.size();
+  bounding_box(*nodes, this->dimension, this->origin, hi);
+  for (size_t d = this->dimension; d < 3; ++d) {
+    this->origin[d] = hi[d] = 0.0;
+  }
+  this->cellsize = limit_cellsize(this->origin, hi, this->dimension,
+                                  nodes->size(), cellsize);
+  double n_cells =
+      grid_cells(this->origin, hi, this->dimension, this->cellsize, this->dims);
+  for (size_t d = this->dimension; d < 3; ++d) this->dims[d] = 1;
+
+  // counting sort of the nodes by their cell
+  std::vector<size_t> cell_of(nodes->size());
+  this->cell_start.assign((size_t)n_cells + 1, 0);
+  long cell[3] = {0, 0, 0};
+  for (size_t i = 0; i < nodes->size(); ++i) {
+    for (size_t d = 0; d < this->dimension; ++d)
+      cell[d] = this->cell_coordinate((*nodes)[i].point[d], d);
+    cell_of[i] = this->cell_number(cell);
+    this->cell_start[cell_of[i] + 1]++;
+  }
+  for (size_t c = 1; c < this->cell_start.size(); ++c) {
+    this->cell_start[c] += this->cell_start[c - 1];
+  }
+  std::vector<size_t> next(this->cell_start.begin(),
+                           this->cell_start.end() - 1);
+  this->nodes.resize(nodes->size());
+  this->input_position.resize(nodes->size());
+  this->coords.resize(nodes->size() * this->dimension);
+  for (size_t i = 0; i < nodes->size(); ++i) {
+    size_t pos = next[cell_of[i]]++;
+    this->nodes[pos] = (*nodes)[i];
+    this->input_position[pos] = i;
+    for (size_t d = 0; d < this->dimension; ++d)
+      this->coords[pos * this->dimension + d] = (*nodes)[i].point[d];
+  }
+}
+
+double CellGrid::get_cellsize() const { return this->cellsize; }
+
+// cell coordinate of *x* along axis *d*, clamped to the grid
+long CellGrid::cell_coordinate(double x, size_t d) const {
+  long c = (long)std::floor((x - this->origin[d]) / this->cellsize);
+  return std::max(0L, std::min(c, this->dims[d] - 1));
+}
+
+// position of *cell* in the dense array of cells
+size_t CellGrid::cell_number(const long *cell) const {
+  return (size_t)((cell[2] * this->dims[1] + cell[1]) * this->dims[0] +
+                  cell[0]);
+}
+
+// squared distance between the sorted node *i* and *point*
+double CellGrid::squared_distance(size_t i,
+                                  const Kdtree::CoordPoint &point) const {
+  const Kdtree::CoordPoint::value_type *c = &this->coords[i * this->dimension];
+  double sum = 0.0;
+  for (size_t d = 0; d < this->dimension; ++d) {
+    double diff = c[d] - point[d];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+// cells of a CellGrid for ring_search
+class CellGridRings {
+ private:
+  const CellGrid &grid;
+  const Kdtree::CoordPoint &point;
+  long max_ring;
+
+ public:
+  long center[3];
+  CellGridRings(const CellGrid &grid, const Kdtree::CoordPoint &point)
+      : grid(grid), point(point), max_ring(0) {
+    this->center[0] = this->center[1] = this->center[2] = 0;
+    for (size_t d = 0; d < grid.dimension; ++d) {
+      // clamping can only move the cell of an outside point closer
+      this->center[d] = grid.cell_coordinate(point[d], d);
+      this->max_ring = std::max(
+          this->max_ring, std::max(this->center[d],
+                                   grid.dims[d] - 1 - this->center[d]));
+    }
+  }
+  bool finished(long ring) const { return ring > this->max_ring; }
+  bool visit_beyond(long, NeighbourHeap &) { return false; }
+  void visit(const long *cell, NeighbourHeap &heap) {
+    size_t c = this->grid.cell_number(cell);
+    for (size_t i = this->grid.cell_start[c]; i < this->grid.cell_start[c + 1];
+         ++i) {
+      heap.offer(this->grid.squared_distance(i, this->point),
+                 this->grid.input_position[i], i);
+    }
+  }
+};
+
+//-------------------------------------------------------------------
+// k nearest neighbour search with ring_search (like the GridIndex of
+// the streaming window) around the cell of *point* within the grid.
+// Ties are broken by the position in the input nodes, so that they do
+// not depend on the cell size.
+//-------------------------------------------------------------------
+void CellGrid::k_nearest_neighbors(const Kdtree::CoordPoint &point, size_t k,
+                                   Kdtree::KdNodeVector *result,
+                                   std::vector<double> *distances) {
+  result->clear();
+  distances->clear();
+  if (k == 0) return;
+  k = std::min(k, this->nodes.size());
+
+  NeighbourHeap heap(k);
+  CellGridRings rings(*this, point);
+  long lo[3] = {0, 0, 0};
+  long hi[3] = {this->dims[0] - 1, this->dims[1] - 1, this->dims[2] - 1};
+  ring_search(rings, rings.center, lo, hi, this->cellsize, heap);
+
+  // copy over result sorted by distance
+  std::vector<size_t> positions;
+  heap.extract(positions, *distances);
+  result->resize(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i) {
+    (*result)[i] = this->nodes[positions[i]];
+  }
+}
+
+//-------------------------------------------------------------------
+// Range search over all cells overlapping the bounding box of the ball.
+//-------------------------------------------------------------------
+void CellGrid::range_nearest_neighbors(const Kdtree::CoordPoint &point,
+                                       double r,
+                                       Kdtree::KdNodeVector *result) {
+  result->clear();
+  const double r2 = r * r;
+  long lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+  for (size_t d = 0; d < this->dimension; ++d) {
+    lo[d] = this->cell_coordinate(point[d] - r, d);
+    hi[d] = this->cell_coordinate(point[d] + r, d);
+  }
+  long cell[3];
+  for (cell[2] = lo[2]; cell[2] <= hi[2]; ++cell[2]) {
+    for (cell[1] = lo[1]; cell[1] <= hi[1]; ++cell[1]) {
+      cell[0] = lo[0];
+      // the cells of a row are adjacent
+      size_t first = this->cell_start[this->cell_number(cell)];
+      cell[0] = hi[0];
+      size_t last = this->cell_start[this->cell_number(cell) + 1];
+      for (size_t i = first; i < last; ++i) {
+        if (this->squared_distance(i, point) <= r2)
+          result->push_back(this->nodes[i]);
+      }
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+// Occupancy of the grid with edge length *cellsize* over the bounding
+// box *lo*, *hi*. Returns the mean number of nodes in the non-empty
+// cells in *mean_load*, and the mean number of nodes in the cell of a
+// node, which is the effort for scanning a cell, in *node_load*.
+//-------------------------------------------------------------------
+void cell_occupancy(const Kdtree::KdNodeVector &nodes, size_t dimension,
+                    const double *lo, const double *hi, double cellsize,
+                    double *mean_load, double *node_load) {
+  long dims[3];
+  grid_cells(lo, hi, dimension, cellsize, dims);
+  std::vector<size_t> cells(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    size_t c = 0;
+    for (size_t d = dimension; d > 0; --d) {
+      long x = (long)std::floor((nodes[i].point[d - 1] - lo[d - 1]) / cellsize);
+      c = c * dims[d - 1] + std::max(0L, std::min(x, dims[d - 1] - 1));
+    }
+    cells[i] = c;
+  }
+  std::sort(cells.begin(), cells.end());
+  size_t occupied = 0;
+  double sum_squares = 0.0;
+  for (size_t i = 0, j = 0; i < cells.size(); i = j) {
+    while (j < cells.size() && cells[j] == cells[i]) ++j;
+    occupied++;
+    sum_squares += (double)(j - i) * (j - i);
+  }
+  *mean_load = (double)nodes.size() / occupied;
+  *node_load = sum_squares / nodes.size();
+}
+
+//-------------------------------------------------------------------
+// Returns the edge length of the grid cells for kNN searches with *k*
+// neighbours. Starting from the cell size for uniformly distributed
+// points, the cell size is reduced until the non-empty cells contain
+// about k/knn_cell_fraction nodes on average, because points on curves
+// only fill a small fraction of the cells.
+//-------------------------------------------------------------------
+double knn_cellsize(const Kdtree::KdNodeVector &nodes, size_t k) {
+  double lo[3], hi[3];
+  size_t dimension = nodes[0].point.size();
+  size_t n = nodes.size();
+  bounding_box(nodes, dimension, lo, hi);
+  double volume = 1.0;
+  for (size_t d = 0; d < dimension; ++d)
+    volume *= std::max(hi[d] - lo[d], 1.0e-12);
+  double load = std::max(1.0, k / knn_cell_fraction);
+  double cellsize = limit_cellsize(
+      lo, hi, dimension, n, std::pow(volume * load / n, 1.0 / dimension));
+
+  for (int iteration = 0; iteration < 4; ++iteration) {
+    double mean_load, node_load;
+    cell_occupancy(nodes, dimension, lo, hi, cellsize, &mean_load,
+                   &node_load);
+    if (mean_load < 2.0 * load) break;
+    // points on curves: the load shrinks linearly with the cell size
+    double smaller = cellsize * std::max(load / mean_load, 0.25);
+    if (limit_cellsize(lo, hi, dimension, n, smaller) > smaller) break;
+    cellsize = smaller;
+  }
+  return cellsize;
+}
+
+//-------------------------------------------------------------------
+// Builds the spatial index of type *type* over *nodes*. For kNN
+// searches (*r* zero), the grid cell size is chosen by knn_cellsize,
+// for range searches it is *r*. INDEX_AUTO chooses the grid unless the
+// points are so unevenly distributed over their bounding box, that a
+// node shares its cell with too many nodes on average, i.e. with more
+// than max_auto_range_load nodes, or with more than max_auto_knn_load
+// nodes per neighbour. When *stats* is given, the build time is recorded as
+// "kdtree_build" or "grid_build", and the choice of INDEX_AUTO as the
+// value "grid_cell_load".
+//-------------------------------------------------------------------
+SpatialIndex *build_spatial_index(const Kdtree::KdNodeVector *nodes,
+                                  IndexType type, size_t k, double r,
+                                  Stats *stats) {
+  double cellsize = 0.0;
+  if (type != INDEX_KDTREE) {
+    double lo[3], hi[3];
+    size_t dimension = (*nodes)[0].point.size();
+    if (stats) stats->start("grid_build");
+    bounding_box(*nodes, dimension, lo, hi);
+    if (r > 0.0) {
+      cellsize = limit_cellsize(lo, hi, dimension, nodes->size(), r);
+    } else {
+      cellsize = knn_cellsize(*nodes, k);
+    }
+    if (type == INDEX_AUTO) {
+      double mean_load, node_load;
+      cell_occupancy(*nodes, dimension, lo, hi, cellsize, &mean_load,
+                     &node_load);
+      double max_load = (r > 0.0) ? max_auto_range_load
+                                  : max_auto_knn_load * (k + 1);
+      type = (node_load > max_load) ? INDEX_KDTREE : INDEX_GRID;
+      if (stats) stats->set_value("grid_cell_load", node_load);
+    }
+    if (stats) stats->stop("grid_build");
+  }
+
+  SpatialIndex *index = NULL;
+  if (type == INDEX_GRID) {
+    if (stats) stats->start("grid_build");
+    index = new CellGrid(nodes, cellsize);
+    if (stats) stats->stop("grid_build");
+  } else {
+    if (stats) stats->start("kdtree_build");
+    index = new KdTreeIndex(nodes);
+    if (stats) stats->stop("kdtree_build");
+  }
+  return index;
+}
@@ -0,0 +1,95 @@
+//
+// spatialindex.h
+//     Common interface of the kd-tree and the uniform grid for the
+//     neighbour searches, and the choice between them.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+#include "kdtree/kdtree.hpp"
+#include "util.h"
+
+class Stats;
+
+// Neighbour searches with the same interface as Kdtree::KdTree, i.e.
+// squared Euklidean distances and results as copies of the KdNodes.
+class SpatialIndex {
+ public:
+  virtual ~SpatialIndex() {}
+  // the kd-tree for searches that only the kd-tree supports (or NULL)
+  virtual Kdtree::KdTree *get_kdtree() { return NULL; }
+  // the *k* nearest neighbors of *point* sorted by distance
+  virtual void k_nearest_neighbors(const Kdtree::CoordPoint &point, size_t k,
+                                   Kdtree::KdNodeVector *result,
+                                   std::vector<double> *distances) = 0;
+  // all nodes with distance <= *r* from *point* (in no particular order)
+  virtual void range_nearest_neighbors(const Kdtree::CoordPoint &point,
+                                       double r,
+                                       Kdtree::KdNodeVector *result) = 0;
+};
+
+// kd-tree as SpatialIndex
+class KdTreeIndex : public SpatialIndex {
+ private:
+  Kdtree::KdTree kdtree;
+
+ public:
+  KdTreeIndex(const Kdtree::KdNodeVector *nodes);
+  Kdtree::KdTree *get_kdtree();
+  void k_nearest_neighbors(const Kdtree::CoordPoint &point, size_t k,
+                           Kdtree::KdNodeVector *result,
+                           std::vector<double> *distances);
+  void range_nearest_neighbors(const Kdtree::CoordPoint &point, double r,
+                               Kdtree::KdNodeVector *result);
+};
+
+// Static uniform grid (cell list) over the bounding box of the nodes.
+// The nodes are sorted by their cell, so that the nodes of a cell are
+// adjacent in memory, and the cells are found by their position in a
+// dense array.
+class CellGrid : public SpatialIndex {
+ private:
+  size_t dimension;
+  double cellsize;
+  double origin[3];
+  long dims[3];
+  Kdtree::KdNodeVector nodes;            // sorted by cell
+  std::vector<size_t> input_position;    // position of the sorted nodes
+                                         // in the input nodes
+  Kdtree::CoordPoint coords;             // coordinates of the sorted nodes
+  std::vector<size_t> cell_start;        // nodes of cell i are in
+                                         // [cell_start[i], cell_start[i+1])
+  long cell_coordinate(double x, size_t d) const;
+  size_t cell_number(const long *cell) const;
+  double squared_distance(size_t i, const Kdtree::CoordPoint &point) const;
+  friend class CellGridRings;
+
+ public:
+  CellGrid(const Kdtree::KdNodeVector *nodes, double cellsize);
+  double get_cellsize() const;
+  void k_nearest_neighbors(const Kdtree::CoordPoint &point, size_t k,
+                           Kdtree::KdNodeVector *result,
+                           std::vector<double> *distances);
+  void range_nearest_neighbors(const Kdtree::CoordPoint &point, double r,
+                               Kdtree::KdNodeVector *result);
+};
+
+// edge length of the grid cells for kNN searches with *k* neighbours
+double knn_cellsize(const Kdtree::KdNodeVector &nodes, size_t k);
+
+// builds the spatial index of type *type* over *nodes* for kNN searches
+// with *k* neighbours (when *r* is zero) or for range searches with
+// radius *r*; INDEX_AUTO chooses the type from the point distribution
+SpatialIndex *build_spatial_index(const Kdtree::KdNodeVector *nodes,
+                                  IndexType type, size_t k, double r,
+                                  Stats *stats = NULL);
+
+#endif
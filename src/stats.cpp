@@ -0,0 +1,151 @@
+//
+// stats.cpp
+//     Class for collecting run times and counters of the algorithm steps.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "stats.h"
+#include "util.h"
+
+// returns the timer *name* or NULL if it does not exist
+Stats::Timer *Stats::find_timer(const std::string &name) {
+  for (size_t i = 0; i < this->timers.size(); ++i) {
+    if (this->timers[i].name == name) return &this->timers[i];
+  }
+  return NULL;
+}
+
+// starts the timer *name*. If the timer has already been used,
+// the new time span is added to the previous ones.
+void Stats::start(const std::string &name) {
+  Timer *t = this->find_timer(name);
+  if (!t) {
+    Timer new_timer;
+    new_timer.name = name;
+    new_timer.wall = new_timer.cpu = 0.0;
+    new_timer.calls = 0;
+    this->timers.push_back(new_timer);
+    t = &this->timers.back();
+  }
+  t->running = true;
+  t->wall_start = wall_time();
+  t->cpu_start = cpu_time();
+}
+
+// returns the accumulated times of the timer *name*
+bool Stats::get_time(const std::string &name, double &wall,
+                     double &cpu) const {
+  wall = cpu = 0.0;
+  for (size_t i = 0; i < this->timers.size(); ++i) {
+    if (this->timers[i].name == name) {
+      wall = this->timers[i].wall;
+      cpu = this->timers[i].cpu;
+      return true;
+    }
+  }
+  return false;
+}
+
+// stops the timer *name*
+void Stats::stop(const std::string &name) {
+  Timer *t = this->find_timer(name);
+  if (!t || !t->running) return;
+  t->wall += wall_time() - t->wall_start;
+  t->cpu += cpu_time() - t->cpu_start;
+  t->calls++;
+  t->running = false;
+}
+
+// adds *n* to the counter *name*
+void Stats::count(const std::string &name, size_t n) {
+  for (size_t i = 0; i < this->counts.size(); ++i) {
+    if (this->counts[i].first == name) {
+      this->counts[i].second += n;
+      return;
+    }
+  }
+  this->counts.push_back(std::pair<std::string, size_t>(name, n));
+}
+
+// sets the counter *name* to *n*
+void Stats::set_count(const std::string &name, size_t n) {
+  for (size_t i = 0; i < this->counts.size(); ++i) {
+    if (this->counts[i].first == name) {
+      this->counts[i].second = n;
+      return;
+    }
+  }
+  this->counts.push_back(std::pair<std::string, size_t>(name, n));
+}
+
+// returns the counter *name* or zero if it does not exist
+size_t Stats::get_count(const std::string &name) const {
+  for (size_t i = 0; i < this->counts.size(); ++i) {
+    if (this->counts[i].first == name) return this->counts[i].second;
+  }
+  return 0;
+}
+
+// sets the numeric value *name* to *value*
+void Stats::set_value(const std::string &name, double value) {
+  for (size_t i = 0; i < this->values.size(); ++i) {
+    if (this->values[i].first == name) {
+      this->values[i].second = value;
+      return;
+    }
+  }
+  this->values.push_back(std::pair<std::string, double>(name, value));
+}
+
+//-------------------------------------------------------------------
+// Writes all timers (in seconds), counters and values as a JSON
+// object to *os*. When *infile_name* is given, it is included.
+//-------------------------------------------------------------------
+void Stats::to_json(std::ostream &os, const char *infile_name) const {
+  std::streamsize old_precision = os.precision(10);
+  os << "{\n  \"version\": \"" << TRIPLCLUST_VERSION << "\",\n";
+  if (infile_name) {
+    os << "  \"infile\": \"" << json_escape(infile_name) << "\",\n";
+  }
+  os << "  \"timings\": {";
+  for (size_t i = 0; i < this->timers.size(); ++i) {
+    const Timer &t = this->timers[i];
+    os << (i ? ",\n" : "\n") << "    \"" << json_escape(t.name)
+       << "\": {\"wall\": " << t.wall << ", \"cpu\": " << t.cpu
+       << ", \"calls\": " << t.calls << "}";
+  }
+  os << "\n  },\n  \"counts\": {";
+  for (size_t i = 0; i < this->counts.size(); ++i) {
+    os << (i ? ",\n" : "\n") << "    \"" << json_escape(this->counts[i].first)
+       << "\": " << this->counts[i].second;
+  }
+  os << "\n  },\n  \"values\": {";
+  for (size_t i = 0; i < this->values.size(); ++i) {
+    os << (i ? ",\n" : "\n") << "    \"" << json_escape(this->values[i].first)
+       << "\": " << this->values[i].second;
+  }
+  os << "\n  }\n}\n";
+  os.precision(old_precision);
+}
+
+//-------------------------------------------------------------------
+// Writes all timers, counters and values as JSON to the file *fname*.
+// Returns false if the file cannot be written.
+//-------------------------------------------------------------------
+bool Stats::to_json(const char *fname, const char *infile_name) const {
+  std::ofstream of(fname);
+  if (!of.is_open()) {
+    std::cerr << "[Error] could not write file '" << fname << "'\n";
+    return false;
+  }
+  this->to_json(of, infile_name);
+  of.close();
+  return true;
+}
@@ -0,0 +1,57 @@
+//
+// stats.h
+//     Class for collecting run times and counters of the algorithm steps.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Collects wall and CPU times of named steps, counters and values.
+// Timers with the same name accumulate, and all entries are reported
+// in the order of their first occurrence.
+class Stats {
+ private:
+  struct Timer {
+    std::string name;
+    double wall, cpu;              // accumulated times
+    double wall_start, cpu_start;  // start times of running timer
+    size_t calls;
+    bool running;
+  };
+  std::vector<Timer> timers;
+  std::vector<std::pair<std::string, size_t> > counts;
+  std::vector<std::pair<std::string, double> > values;
+
+  Timer *find_timer(const std::string &name);
+
+ public:
+  // starts and stops the timer *name*
+  void start(const std::string &name);
+  void stop(const std::string &name);
+  // adds *n* to the counter *name*
+  void count(const std::string &name, size_t n = 1);
+  // sets the counter *name* to *n*
+  void set_count(const std::string &name, size_t n);
+  // returns the counter *name* (zero if not set)
+  size_t get_count(const std::string &name) const;
+  // sets the numeric value *name* to *value*
+  void set_value(const std::string &name, double value);
+  // returns the accumulated times of the timer *name* in *wall* and
+  // *cpu* (false and zero if not used)
+  bool get_time(const std::string &name, double &wall, double &cpu) const;
+
+  // writes all timers, counters and values as JSON
+  void to_json(std::ostream &os, const char *infile_name = NULL) const;
+  bool to_json(const char *fname, const char *infile_name = NULL) const;
+};
+
+#endif
@@ -0,0 +1,1142 @@
+//
+// stream.cpp
+//     Incremental clustering of chronologically ordered point streams
+//     in a sliding window.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "directionbins.h"
+#include "dnn.h"
+#include "gridindex.h"
+#include "kdtree/kdtree.hpp"
+#include "output.h"
+#include "pointcloud.h"
+#include "spatialindex.h"
+#include "stream.h"
+#include "triplet.h"
+
+// maximum number of grid cells in which a kNN ball is registered;
+// larger balls are kept in a list that is always searched
+const double max_ball_cells = 343;
+// radius in multiples of s*t within which all triplets are close
+// candidates; beyond, only triplets with similar directions can be close
+const double near_triplets = 4.0;
+
+// squared distance between *p* and *q*
+double squared_distance(const Point &p, const Point &q) {
+  return (p - q).squared_norm();
+}
+
+//-------------------------------------------------------------------
+// Triplets in the sliding window and their single linkage clusters
+// at the threshold t, i.e. the connected components of the graph with
+// edges between triplets with a distance < t. Each component is held
+// together by a spanning forest, so that a removed triplet only
+// requires a search for replacement edges when it splits the forest.
+//-------------------------------------------------------------------
+
+//-------------------------------------------------------------------
+// Index of the live triplets for finding the candidates that can be
+// closer than t to a triplet, which uses the lower bounds of ClosePairs:
+// the distance is at least |tan(angle)| and at least |c|*sin(angle/2)/s
+// for the difference c of the centers. The triplets with centers within
+// near_triplets*s*t are found in a grid of the centers with this edge
+// length. Farther triplets can only be close when the angle is below
+// 2*asin(1/near_triplets); they are found in the direction cells of
+// DirectionBins (see direction_cell) within this angle, which have a
+// grid of the centers of their members, so that only the ball of radius
+// s*t/sin(phi/2) needs to be searched for the minimum angle phi of the
+// cell.
+//-------------------------------------------------------------------
+
+// live triplets whose directions are in the same cell
+struct DirectionCell {
+  double axis[3];     // direction of the first member
+  double radius;      // max angle between a member and the axis so far
+  double min_cos;     // cosine of the max angle to the axis for far triplets
+  GridIndex centers;  // centers of the members
+  DirectionCell(double cellsize, bool is2d) : centers(cellsize, is2d) {}
+};
+
+class TripletIndex {
+ private:
+  double s, t;
+  double near_radius;     // near_triplets * s * t
+  double max_far_angle;   // 2 * asin(1/near_triplets)
+  size_t resolution;      // of the direction cells
+  GridIndex near;
+  std::map<size_t, DirectionCell> cells;
+  bool is2d;
+  std::vector<size_t> cell_of;  // direction cell of each slot
+
+ public:
+  TripletIndex(double s, double t, bool is2d);
+  // adds the triplet *tr* in the slot *slot*
+  void insert(size_t slot, const triplet &tr);
+  // removes the triplet *tr* in the slot *slot*
+  void remove(size_t slot, const triplet &tr);
+  // slots of all triplets that can be closer than t to *tr*, some of
+  // them several times
+  void candidates(const triplet &tr, std::vector<size_t> &result) const;
+};
+
+// margin for the rounding errors of angles and distances
+const double rounding_margin = 1.0e-6;
+
+TripletIndex::TripletIndex(double s, double t, bool is2d)
+    : s(s),
+      t(t),
+      near_radius(near_triplets * s * t),
+      max_far_angle(2.0 * std::asin(1.0 / near_triplets) + rounding_margin),
+      near(near_triplets * s * t, is2d),
+      is2d(is2d) {
+  // cells spanning about a quarter of the max angle of far triplets
+  const double pi = std::acos(-1.0);
+  this->resolution = (size_t)std::ceil(4.0 * pi / this->max_far_angle);
+}
+
+// center of the triplet *tr* as a point for the grids
+static Point triplet_center(const triplet &tr) {
+  return Point(tr.center[0], tr.center[1], tr.center[2]);
+}
+
+void TripletIndex::insert(size_t slot, const triplet &tr) {
+  const Point center = triplet_center(tr);
+  this->near.insert(slot, center);
+  const size_t c = direction_cell(tr.direction, this->resolution);
+  std::map<size_t, DirectionCell>::iterator it = this->cells.find(c);
+  const double u[3] = {tr.direction[0], tr.direction[1], tr.direction[2]};
+  if (it == this->cells.end()) {
+    it = this->cells
+             .insert(std::make_pair(c, DirectionCell(this->near_radius,
+                                                     this->is2d)))
+             .first;
+    for (size_t d = 0; d < 3; ++d) it->second.axis[d] = u[d];
+    it->second.radius = -1.0;
+  }
+  DirectionCell &cell = it->second;
+  double angle = line_angle(cell.axis, u);
+  if (angle > cell.radius) {
+    const double pi = std::acos(-1.0);
+    cell.radius = angle;
+    cell.min_cos = std::cos(std::min(
+        this->max_far_angle + cell.radius + rounding_margin, 0.5 * pi));
+  }
+  cell.centers.insert(slot, center);
+  if (slot >= this->cell_of.size()) this->cell_of.resize(slot + 1);
+  this->cell_of[slot] = c;
+}
+
+void TripletIndex::remove(size_t slot, const triplet &tr) {
+  const Point center = triplet_center(tr);
+  this->near.remove(slot, center);
+  std::map<size_t, DirectionCell>::iterator it =
+      this->cells.find(this->cell_of[slot]);
+  if (it == this->cells.end()) return;
+  it->second.centers.remove(slot, center);
+  if (it->second.centers.size() == 0) this->cells.erase(it);
+}
+
+void TripletIndex::candidates(const triplet &tr,
+                              std::vector<size_t> &result) const {
+  const Point center = triplet_center(tr);
+  this->near.range(center, this->near_radius, result);
+  // far triplets from the cells with a small angle
+  const double u[3] = {tr.direction[0], tr.direction[1], tr.direction[2]};
+  const double infinity = std::numeric_limits<double>::infinity();
+  std::vector<size_t> far;
+  std::map<size_t, DirectionCell>::const_iterator it;
+  for (it = this->cells.begin(); it != this->cells.end(); ++it) {
+    const DirectionCell &cell = it->second;
+    const double anglecos = std::fabs(u[0] * cell.axis[0] +
+                                      u[1] * cell.axis[1] +
+                                      u[2] * cell.axis[2]);
+    if (anglecos < cell.min_cos) continue;
+    const double phi =
+        line_angle(u, cell.axis) - cell.radius - rounding_margin;
+    double r = infinity;
+    if (phi > 0.0) {
+      r = (1.0 + rounding_margin) * this->s * this->t / std::sin(0.5 * phi);
+      // all close members are near triplets
+      if (r < this->near_radius) continue;
+    }
+    cell.centers.range(center, r, far);
+    result.insert(result.end(), far.begin(), far.end());
+  }
+}
+
+// triplet in the sliding window with its edges in the spanning forest
+struct StreamTriplet {
+  triplet tr;                // point indices are global indices
+  size_t component;          // id of the component
+  std::vector<size_t> edges; // neighbours in the spanning forest
+  bool alive;
+};
+
+// component of the slots without triplet
+const size_t no_component = (size_t)-1;
+
+class StreamClustering {
+ private:
+  size_t dimension;
+  double s, t;
+  // squared cosine of the largest angle with |tan(angle)| < t
+  double min_cos2;
+  // squared center distance s*t
+  double max_dist2;
+  std::vector<StreamTriplet> triplets;
+  // components, directions and centers (with *dimension* coordinates)
+  // of the triplets in compact arrays for the search of close triplets
+  // (no_component for free slots)
+  std::vector<size_t> labels;
+  std::vector<double> directions, centers;
+  std::vector<size_t> free_slots;
+  // candidates for close triplets; NULL when all triplets are
+  // candidates, because t is too large or s*t is zero
+  TripletIndex *index;
+  // triplets of the components by their ids
+  std::map<size_t, std::vector<size_t> > components;
+  size_t next_id;
+  // marks for the search of the pieces of a component and of the
+  // tested candidates, and the pieces of the triplets during a repair
+  std::vector<size_t> stamp, tested, piece_of;
+  size_t current_stamp, current_test;
+  // not copyable
+  StreamClustering(const StreamClustering &);
+  StreamClustering &operator=(const StreamClustering &);
+  void link(size_t i, size_t j);
+  bool close(size_t i, size_t j);
+  template <size_t D>
+  bool close_d(size_t i, size_t j);
+  void candidates(size_t i, std::vector<size_t> &result);
+  void repair(size_t id);
+
+ public:
+  size_t evaluations;  // number of distance computations
+  size_t repairs;      // number of components split by a removal
+  StreamClustering(size_t dimension, double s, double t);
+  ~StreamClustering();
+  const triplet &get(size_t i) const;
+  size_t component(size_t i) const;
+  size_t component_size(size_t id) const;
+  size_t n_components() const;
+  // adds the triplet *tr* and returns its slot
+  size_t add(const triplet &tr);
+  // removes the triplets in the slots *slots*
+  void remove(const std::vector<size_t> &slots);
+};
+
+StreamClustering::StreamClustering(size_t dimension, double s, double t)
+    : dimension(dimension),
+      s(s),
+      t(t),
+      index(NULL),
+      next_id(0),
+      current_stamp(0),
+      current_test(0),
+      evaluations(0),
+      repairs(0) {
+  // slightly smaller, so that rounding cannot reject a close pair;
+  // perpendicular triplets have the distance 1e8 regardless of the angle
+  this->min_cos2 = (t > 1.0e+8) ? 0.0 : (1.0 - 1.0e-9) / (1.0 + t * t);
+  this->max_dist2 = (t > 1.0e+8) ? std::numeric_limits<double>::infinity()
+                                 : (1.0 + 1.0e-6) * (s * t) * (s * t);
+  if (t <= 1.0e+8 && s * t > 0.0)
+    this->index = new TripletIndex(s, t, dimension == 2);
+}
+
+StreamClustering::~StreamClustering() { delete this->index; }
+
+const triplet &StreamClustering::get(size_t i) const {
+  return this->triplets[i].tr;
+}
+
+size_t StreamClustering::component(size_t i) const {
+  return this->triplets[i].component;
+}
+
+size_t StreamClustering::component_size(size_t id) const {
+  std::map<size_t, std::vector<size_t> >::const_iterator it =
+      this->components.find(id);
+  return (it == this->components.end()) ? 0 : it->second.size();
+}
+
+size_t StreamClustering::n_components() const {
+  return this->components.size();
+}
+
+//-------------------------------------------------------------------
+// Returns true when the triplets *i* and *j* have a distance < t. Most
+// pairs are rejected without computing the distance by the lower bounds
+// of ClosePairs: the distance is at least |tan(angle)| and at least
+// |c|*sin(angle/2)/s for the difference c of the centers. The triplets
+// are in a cloud of dimension *D*.
+//-------------------------------------------------------------------
+template <size_t D>
+bool StreamClustering::close_d(size_t i, size_t j) {
+  const double *di = &this->directions[D * i];
+  const double *dj = &this->directions[D * j];
+  double anglecos = di[0] * dj[0];
+  for (size_t k = 1; k < D; ++k) anglecos += di[k] * dj[k];
+  if (anglecos * anglecos < this->min_cos2) return false;
+  const double *ci = &this->centers[D * i];
+  const double *cj = &this->centers[D * j];
+  double dist2 = 0.0;
+  for (size_t k = 0; k < D; ++k) {
+    const double dk = ci[k] - cj[k];
+    dist2 += dk * dk;
+  }
+  if (dist2 * (0.5 * (1.0 - std::fabs(anglecos)) - 1.0e-12) >
+      this->max_dist2)
+    return false;
+  this->evaluations++;
+  const ScaleTripletMetric<D> metric(this->s);
+  return metric(this->triplets[i].tr, this->triplets[j].tr) < this->t;
+}
+
+// close_d for the dimension of the triplets
+bool StreamClustering::close(size_t i, size_t j) {
+  if (this->dimension == 2) return this->close_d<2>(i, j);
+  return this->close_d<3>(i, j);
+}
+
+// adds the edge between *i* and *j* to the spanning forest
+void StreamClustering::link(size_t i, size_t j) {
+  this->triplets[i].edges.push_back(j);
+  this->triplets[j].edges.push_back(i);
+}
+
+// slots of the live triplets that can be closer than t to the triplet
+// *i*, each of them once, without *i* itself
+void StreamClustering::candidates(size_t i, std::vector<size_t> &result) {
+  if (!this->index) {
+    result.clear();
+    for (size_t u = 0; u < this->labels.size(); ++u) {
+      if (this->labels[u] != no_component && u != i) result.push_back(u);
+    }
+    return;
+  }
+  std::vector<size_t> found;
+  this->index->candidates(this->triplets[i].tr, found);
+  this->current_test++;
+  this->tested[i] = this->current_test;
+  result.clear();
+  for (size_t k = 0; k < found.size(); ++k) {
+    const size_t u = found[k];
+    if (this->tested[u] == this->current_test) continue;
+    this->tested[u] = this->current_test;
+    result.push_back(u);
+  }
+}
+
+//-------------------------------------------------------------------
+// Adds *tr* to the component of each triplet with a distance < t. All
+// these components are merged into the largest one. At most one edge
+// per component is added to the spanning forest, so that the distance
+// only needs to be computed to the triplets of other components.
+//-------------------------------------------------------------------
+size_t StreamClustering::add(const triplet &tr) {
+  size_t slot;
+  if (this->free_slots.empty()) {
+    slot = this->triplets.size();
+    this->triplets.push_back(StreamTriplet());
+    this->stamp.push_back(0);
+    this->tested.push_back(0);
+    this->piece_of.push_back(0);
+    this->labels.push_back(no_component);
+    this->directions.resize(this->dimension * this->triplets.size());
+    this->centers.resize(this->dimension * this->triplets.size());
+  } else {
+    slot = this->free_slots.back();
+    this->free_slots.pop_back();
+  }
+  StreamTriplet &st = this->triplets[slot];
+  st.tr = tr;
+  st.edges.clear();
+  st.alive = true;
+  for (size_t k = 0; k < this->dimension; ++k) {
+    this->directions[this->dimension * slot + k] = tr.direction[k];
+    this->centers[this->dimension * slot + k] = tr.center[k];
+  }
+
+  // components with a triplet closer than t
+  std::map<size_t, size_t> linked;
+  std::vector<size_t> candidates;
+  this->candidates(slot, candidates);
+  if (this->index) this->index->insert(slot, tr);
+  for (size_t k = 0; k < candidates.size(); ++k) {
+    const size_t u = candidates[k], label = this->labels[u];
+    if (!linked.empty() && linked.find(label) != linked.end()) continue;
+    if (this->close(u, slot)) linked[label] = u;
+  }
+  if (linked.empty()) {
+    st.component = this->next_id++;
+    this->labels[slot] = st.component;
+    this->components[st.component].push_back(slot);
+    return slot;
+  }
+
+  // merge into the largest component
+  size_t target = linked.begin()->first;
+  std::map<size_t, size_t>::iterator it;
+  for (it = linked.begin(); it != linked.end(); ++it) {
+    if (this->component_size(it->first) > this->component_size(target))
+      target = it->first;
+  }
+  std::vector<size_t> &members = this->components[target];
+  for (it = linked.begin(); it != linked.end(); ++it) {
+    this->link(slot, it->second);
+    if (it->first == target) continue;
+    std::vector<size_t> &merged = this->components[it->first];
+    for (size_t i = 0; i < merged.size(); ++i) {
+      this->triplets[merged[i]].component = target;
+      this->labels[merged[i]] = target;
+      members.push_back(merged[i]);
+    }
+    this->components.erase(it->first);
+  }
+  this->triplets[slot].component = target;
+  this->labels[slot] = target;
+  members.push_back(slot);
+  return slot;
+}
+
+//-------------------------------------------------------------------
+// Removes the triplets *slots* from the spanning forest and repairs
+// the components that contained them.
+//-------------------------------------------------------------------
+void StreamClustering::remove(const std::vector<size_t> &slots) {
+  std::set<size_t> affected;
+  for (size_t i = 0; i < slots.size(); ++i) {
+    StreamTriplet &st = this->triplets[slots[i]];
+    if (!st.alive) continue;
+    for (size_t j = 0; j < st.edges.size(); ++j) {
+      std::vector<size_t> &edges = this->triplets[st.edges[j]].edges;
+      edges.erase(std::find(edges.begin(), edges.end(), slots[i]));
+    }
+    st.edges.clear();
+    st.alive = false;
+    this->labels[slots[i]] = no_component;
+    if (this->index) this->index->remove(slots[i], st.tr);
+    affected.insert(st.component);
+    this->free_slots.push_back(slots[i]);
+  }
+  for (std::set<size_t>::iterator it = affected.begin(); it != affected.end();
+       ++it) {
+    this->repair(*it);
+  }
+}
+
+//-------------------------------------------------------------------
+// Splits the spanning forest of the component *id* into its connected
+// pieces and reconnects them with edges < t where possible. The largest
+// of the resulting components keeps the id, the others get new ids.
+//-------------------------------------------------------------------
+void StreamClustering::repair(size_t id) {
+  std::vector<size_t> &members = this->components[id];
+  std::vector<std::vector<size_t> > pieces;
+  this->current_stamp++;
+  for (size_t i = 0; i < members.size(); ++i) {
+    size_t start = members[i];
+    if (!this->triplets[start].alive ||
+        this->stamp[start] == this->current_stamp)
+      continue;
+    // breadth first search in the spanning forest
+    pieces.push_back(std::vector<size_t>(1, start));
+    std::vector<size_t> &piece = pieces.back();
+    this->stamp[start] = this->current_stamp;
+    for (size_t j = 0; j < piece.size(); ++j) {
+      const std::vector<size_t> &edges = this->triplets[piece[j]].edges;
+      for (size_t e = 0; e < edges.size(); ++e) {
+        if (this->stamp[edges[e]] == this->current_stamp) continue;
+        this->stamp[edges[e]] = this->current_stamp;
+        piece.push_back(edges[e]);
+      }
+    }
+  }
+  if (pieces.empty()) {
+    this->components.erase(id);
+    return;
+  } else if (pieces.size() == 1) {
+    members.swap(pieces[0]);
+    return;
+  }
+
+  // replacement edges between the pieces; each edge between two pieces
+  // has an end outside the largest piece, so that only the candidates
+  // of the triplets of the other pieces need to be tested
+  this->repairs++;
+  std::vector<size_t> parent(pieces.size());
+  size_t largest_piece = 0;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    parent[i] = i;
+    for (size_t j = 0; j < pieces[i].size(); ++j)
+      this->piece_of[pieces[i][j]] = i;
+    if (pieces[i].size() > pieces[largest_piece].size()) largest_piece = i;
+  }
+  size_t n_groups = pieces.size();
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < pieces.size() && n_groups > 1; ++i) {
+    if (i == largest_piece) continue;
+    for (size_t x = 0; x < pieces[i].size() && n_groups > 1; ++x) {
+      this->candidates(pieces[i][x], candidates);
+      for (size_t k = 0; k < candidates.size() && n_groups > 1; ++k) {
+        const size_t y = candidates[k];
+        if (this->labels[y] != id) continue;
+        size_t root_i = find_root(parent, i);
+        size_t root_j = find_root(parent, this->piece_of[y]);
+        if (root_i == root_j) continue;
+        if (this->close(pieces[i][x], y)) {
+          this->link(pieces[i][x], y);
+          parent[std::max(root_i, root_j)] = std::min(root_i, root_j);
+          n_groups--;
+        }
+      }
+    }
+  }
+
+  // new components from the connected pieces
+  std::map<size_t, std::vector<size_t> > groups;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    std::vector<size_t> &group = groups[find_root(parent, i)];
+    group.insert(group.end(), pieces[i].begin(), pieces[i].end());
+  }
+  std::map<size_t, std::vector<size_t> >::iterator largest = groups.begin();
+  for (std::map<size_t, std::vector<size_t> >::iterator it = groups.begin();
+       it != groups.end(); ++it) {
+    if (it->second.size() > largest->second.size()) largest = it;
+  }
+  members.swap(largest->second);
+  for (std::map<size_t, std::vector<size_t> >::iterator it = groups.begin();
+       it != groups.end(); ++it) {
+    if (it == largest) continue;
+    size_t new_id = this->next_id++;
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      this->triplets[it->second[i]].component = new_id;
+      this->labels[it->second[i]] = new_id;
+    }
+    this->components[new_id].swap(it->second);
+  }
+}
+
+//-------------------------------------------------------------------
+// kNN balls of the points in the window, registered in all grid cells
+// that they overlap. They are used for finding the points whose
+// nearest neighbours can be changed by a new or moved point.
+//-------------------------------------------------------------------
+
+// grid cells overlapped by the kNN ball of a point
+struct Ball {
+  long lo[3], hi[3];
+  bool large;       // registered in the list of large balls
+  bool registered;
+  Ball() : large(false), registered(false) {}
+};
+
+class BallIndex {
+ private:
+  double cellsize;
+  bool is2d;
+  std::map<GridCell, std::vector<size_t> > cells;
+  std::vector<size_t> large;
+
+ public:
+  BallIndex(double cellsize, bool is2d) : cellsize(cellsize), is2d(is2d) {}
+  // cells overlapped by the ball with *center* and *radius*
+  Ball cover(const Point &center, double radius) const;
+  void insert(size_t id, const Point &center, double radius, Ball &ball);
+  void remove(size_t id, Ball &ball);
+  // moves the registration of *ball* to the ball with *center* and
+  // *radius*, unless it overlaps the same cells
+  void update(size_t id, const Point &center, double radius, Ball &ball);
+  // identifiers of all balls that might contain *p*
+  void query(const Point &p, std::vector<size_t> &result) const;
+};
+
+Ball BallIndex::cover(const Point &center, double radius) const {
+  Ball ball;
+  double c[3] = {center.x, center.y, center.z};
+  double n_cells = 1.0;
+  const size_t dimension = this->is2d ? 2 : 3;
+  ball.large = (radius == std::numeric_limits<double>::infinity());
+  for (size_t d = 0; d < 3; ++d) ball.lo[d] = ball.hi[d] = 0;
+  for (size_t d = 0; d < dimension && !ball.large; ++d) {
+    ball.lo[d] = grid_coordinate(c[d] - radius, this->cellsize);
+    ball.hi[d] = grid_coordinate(c[d] + radius, this->cellsize);
+    n_cells *= (double)(ball.hi[d] - ball.lo[d] + 1);
+  }
+  ball.large = ball.large || n_cells > max_ball_cells;
+  return ball;
+}
+
+void BallIndex::insert(size_t id, const Point &center, double radius,
+                       Ball &ball) {
+  ball = this->cover(center, radius);
+  ball.registered = true;
+  if (ball.large) {
+    this->large.push_back(id);
+    return;
+  }
+  GridCell cell;
+  for (cell.z = ball.lo[2]; cell.z <= ball.hi[2]; ++cell.z) {
+    for (cell.y = ball.lo[1]; cell.y <= ball.hi[1]; ++cell.y) {
+      for (cell.x = ball.lo[0]; cell.x <= ball.hi[0]; ++cell.x) {
+        this->cells[cell].push_back(id);
+      }
+    }
+  }
+}
+
+// removes *id* from *list*
+void erase_id(std::vector<size_t> &list, size_t id) {
+  std::vector<size_t>::iterator it = std::find(list.begin(), list.end(), id);
+  if (it != list.end()) {
+    *it = list.back();
+    list.pop_back();
+  }
+}
+
+void BallIndex::remove(size_t id, Ball &ball) {
+  if (!ball.registered) return;
+  ball.registered = false;
+  if (ball.large) {
+    erase_id(this->large, id);
+    return;
+  }
+  GridCell cell;
+  for (cell.z = ball.lo[2]; cell.z <= ball.hi[2]; ++cell.z) {
+    for (cell.y = ball.lo[1]; cell.y <= ball.hi[1]; ++cell.y) {
+      for (cell.x = ball.lo[0]; cell.x <= ball.hi[0]; ++cell.x) {
+        std::map<GridCell, std::vector<size_t> >::iterator it =
+            this->cells.find(cell);
+        if (it == this->cells.end()) continue;
+        erase_id(it->second, id);
+        if (it->second.empty()) this->cells.erase(it);
+      }
+    }
+  }
+}
+
+void BallIndex::update(size_t id, const Point &center, double radius,
+                       Ball &ball) {
+  Ball moved = this->cover(center, radius);
+  if (ball.registered && moved.large == ball.large &&
+      (ball.large || (std::equal(ball.lo, ball.lo + 3, moved.lo) &&
+                      std::equal(ball.hi, ball.hi + 3, moved.hi))))
+    return;
+  this->remove(id, ball);
+  this->insert(id, center, radius, ball);
+}
+
+void BallIndex::query(const Point &p, std::vector<size_t> &result) const {
+  result = this->large;
+  GridCell cell;
+  cell.x = grid_coordinate(p.x, this->cellsize);
+  cell.y = grid_coordinate(p.y, this->cellsize);
+  cell.z = grid_coordinate(p.z, this->cellsize);
+  std::map<GridCell, std::vector<size_t> >::const_iterator it =
+      this->cells.find(cell);
+  if (it != this->cells.end()) {
+    result.insert(result.end(), it->second.begin(), it->second.end());
+  }
+}
+
+//-------------------------------------------------------------------
+// The sliding window with the smoothed points, their triplets and the
+// clustering of these triplets. The points are stored in slots
+// (global index modulo the window size).
+//-------------------------------------------------------------------
+
+// a point in the sliding window
+struct StreamPoint {
+  double radius;                 // squared distance of the k-th neighbour
+  std::vector<size_t> triplets;  // triplets containing the point
+  std::vector<size_t> mids;      // triplets with the point as mid point
+  Ball ball;
+};
+
+class StreamWindow {
+ private:
+  double r, a;
+  size_t k, n, m;
+  bool is2d;
+  size_t capacity;
+  PointCloud raw, smoothed;
+  std::vector<StreamPoint> points;
+  size_t first, last;  // global indices of the points in the window
+  GridIndex raw_grid, smooth_grid;
+  BallIndex balls;
+  StreamClustering clustering;
+  std::ostream &out;
+  Stats &stats;
+  size_t slot(size_t g) const { return g % this->capacity; }
+  void smoothen(size_t s, Point &result) const;
+  void update_triplets(size_t s, std::vector<size_t> &removed,
+                       std::vector<triplet> &added);
+  void drop_reference(size_t g, size_t t, bool mid);
+  void publish(size_t g);
+
+ public:
+  StreamWindow(Opt &opt, size_t capacity, double cellsize, bool is2d,
+               std::ostream &out, Stats &stats);
+  // moves the window by the points *incoming*; the points leaving the
+  // window are written to *out*
+  void step(const std::vector<Point> &incoming);
+  // writes all points that are still in the window to *out*
+  void publish_all();
+  size_t n_triplets() const;
+  size_t n_clusters() const;
+};
+
+StreamWindow::StreamWindow(Opt &opt, size_t capacity, double cellsize,
+                           bool is2d, std::ostream &out, Stats &stats)
+    : r(opt.get_r()),
+      a(opt.get_a()),
+      k(opt.get_k()),
+      n(opt.get_n()),
+      m(opt.get_m()),
+      is2d(is2d),
+      capacity(capacity),
+      points(capacity),
+      first(0),
+      last(0),
+      raw_grid(opt.get_r() > 0 ? opt.get_r() : cellsize, is2d),
+      smooth_grid(cellsize, is2d),
+      balls(cellsize, is2d),
+      clustering(is2d ? 2 : 3, opt.get_s(), opt.get_t()),
+      out(out),
+      stats(stats) {
+  this->raw.resize(capacity);
+  this->smoothed.resize(capacity);
+  this->smoothed.setOrdered(true);
+  this->smoothed.set2d(is2d);
+}
+
+size_t StreamWindow::n_triplets() const {
+  size_t result = 0;
+  for (size_t g = this->first; g < this->last; ++g) {
+    result += this->points[this->slot(g)].mids.size();
+  }
+  return result;
+}
+
+size_t StreamWindow::n_clusters() const {
+  return this->clustering.n_components();
+}
+
+// centroid of the raw points within r around the point in slot *s*
+void StreamWindow::smoothen(size_t s, Point &result) const {
+  const Point &p = this->raw[s];
+  result.x = p.x;
+  result.y = p.y;
+  result.z = p.z;
+  if (this->r == 0) return;
+  std::vector<size_t> ids;
+  this->raw_grid.range(p, this->r, ids);
+  // summation in a fixed order, so that unchanged neighbourhoods yield
+  // exactly the same position
+  std::sort(ids.begin(), ids.end());
+  double x = 0.0, y = 0.0, z = 0.0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    x += this->raw[ids[i]].x;
+    y += this->raw[ids[i]].y;
+    z += this->raw[ids[i]].z;
+  }
+  result.x = x / ids.size();
+  result.y = y / ids.size();
+  result.z = z / ids.size();
+}
+
+// true when the triplets *t1* and *t2* have the same points and geometry
+bool same_triplet(const triplet &t1, const triplet &t2) {
+  return t1.point_index_a == t2.point_index_a &&
+         t1.point_index_b == t2.point_index_b &&
+         t1.point_index_c == t2.point_index_c &&
+         t1.center[0] == t2.center[0] && t1.center[1] == t2.center[1] &&
+         t1.center[2] == t2.center[2] &&
+         t1.direction[0] == t2.direction[0] &&
+         t1.direction[1] == t2.direction[1] &&
+         t1.direction[2] == t2.direction[2];
+}
+
+//-------------------------------------------------------------------
+// Recomputes the nearest neighbours and the triplets of the point in
+// slot *s* like generate_triplets. Its triplets that are no longer
+// generated are appended to *removed*, the new ones to *added*. The
+// grid breaks ties in distance by the point index like the CellGrid of
+// "-index grid", so that a window of the whole cloud yields the same
+// triplets as generate_triplets with INDEX_GRID, but not necessarily
+// as with the kd-tree.
+//-------------------------------------------------------------------
+void StreamWindow::update_triplets(size_t s, std::vector<size_t> &removed,
+                                   std::vector<triplet> &added) {
+  StreamPoint &sp = this->points[s];
+  std::vector<size_t> ids;
+  std::vector<double> distances;
+  this->smooth_grid.knn(this->smoothed[s], this->k, ids, distances);
+  sp.radius = (ids.size() < this->k) ? std::numeric_limits<double>::infinity()
+                                     : distances.back();
+  this->balls.update(s, this->smoothed[s], std::sqrt(sp.radius), sp.ball);
+
+  // neighbourhood as a small cloud with the mid point at position 0,
+  // because the indices of KdNode are int and relative to the window
+  PointCloud local;
+  local.setOrdered(true);
+  local.set2d(this->is2d);
+  std::vector<size_t> positions(ids.size());
+  Kdtree::KdNodeVector result;
+  local.push_back(this->smoothed[s]);
+  local[0].index = this->smoothed[s].index - this->first;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const Point &p = this->smoothed[ids[i]];
+    positions[i] = i + 1;
+    local.push_back(p);
+    local.back().index = p.index - this->first;
+    result.push_back(
+        Kdtree::KdNode(p.as_vector(this->smoothed.dimension()), &positions[i],
+                       (int)local.back().index));
+  }
+  std::vector<triplet> candidates;
+  size_t n_tested =
+      find_triplet_candidates(local, 0, result, distances, this->a, candidates);
+  this->stats.count("triplet_candidates_tested", n_tested);
+  std::sort(candidates.begin(), candidates.end());
+  if (candidates.size() > this->n) candidates.resize(this->n);
+
+  // keep the unchanged triplets
+  std::vector<size_t> kept;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    triplet &tr = candidates[i];
+    tr.point_index_a = this->smoothed[ids[tr.point_index_a - 1]].index;
+    tr.point_index_b = this->smoothed[s].index;
+    tr.point_index_c = this->smoothed[ids[tr.point_index_c - 1]].index;
+    bool found = false;
+    for (size_t j = 0; j < sp.mids.size() && !found; ++j) {
+      if (same_triplet(this->clustering.get(sp.mids[j]), tr)) {
+        kept.push_back(sp.mids[j]);
+        found = true;
+      }
+    }
+    if (!found) added.push_back(tr);
+  }
+  for (size_t j = 0; j < sp.mids.size(); ++j) {
+    if (std::find(kept.begin(), kept.end(), sp.mids[j]) == kept.end())
+      removed.push_back(sp.mids[j]);
+  }
+  this->stats.count("stream_triplets_kept", kept.size());
+}
+
+// removes the reference to triplet *t* from the point *g*, when it is
+// still in the window
+void StreamWindow::drop_reference(size_t g, size_t t, bool mid) {
+  if (g < this->first || g >= this->last) return;
+  StreamPoint &sp = this->points[this->slot(g)];
+  erase_id(sp.triplets, t);
+  if (mid) erase_id(sp.mids, t);
+}
+
+// writes the point *g* with the ids of its clusters in the csv format
+void StreamWindow::publish(size_t g) {
+  const size_t s = this->slot(g);
+  const StreamPoint &sp = this->points[s];
+  Point point(this->raw[s].x, this->raw[s].y, this->raw[s].z);
+  for (size_t i = 0; i < sp.triplets.size(); ++i) {
+    size_t id = this->clustering.component(sp.triplets[i]);
+    if (this->clustering.component_size(id) >= this->m)
+      point.cluster_ids.insert(id);
+  }
+  this->out << point.x << "," << point.y << ",";
+  if (!this->is2d) this->out << point.z << ",";
+  print_cluster_ids(point, this->out);
+  this->out << "\n";
+}
+
+void StreamWindow::publish_all() {
+  for (size_t g = this->first; g < this->last; ++g) this->publish(g);
+  this->out.flush();
+}
+
+//-------------------------------------------------------------------
+// Moves the window by the points *incoming*. The oldest points are
+// written out and expired, the new points are inserted, and then only
+// the affected parts are recomputed: the smoothed positions of the
+// points within r of an inserted or expired point, the triplets of the
+// points whose kNN ball contains a changed smoothed position, and the
+// clusters of the changed triplets.
+//-------------------------------------------------------------------
+void StreamWindow::step(const std::vector<Point> &incoming) {
+  std::vector<Point> raw_changed, changed;
+  std::vector<size_t> removed, new_slots;
+  std::vector<triplet> added;
+
+  // expiry of the oldest points after writing their labels
+  size_t n_window = this->last - this->first + incoming.size();
+  size_t n_expire = (n_window > this->capacity) ? n_window - this->capacity : 0;
+  this->stats.start("smoothing");
+  for (size_t g = this->first; g < this->first + n_expire; ++g) {
+    const size_t s = this->slot(g);
+    StreamPoint &sp = this->points[s];
+    this->publish(g);
+    this->raw_grid.remove(s, this->raw[s]);
+    raw_changed.push_back(this->raw[s]);
+    this->smooth_grid.remove(s, this->smoothed[s]);
+    changed.push_back(this->smoothed[s]);
+    this->balls.remove(s, sp.ball);
+    removed.insert(removed.end(), sp.mids.begin(), sp.mids.end());
+    sp.mids.clear();
+    sp.triplets.clear();
+  }
+  this->out.flush();
+  this->first += n_expire;
+
+  // insertion of the new points
+  for (size_t i = 0; i < incoming.size(); ++i) {
+    const size_t g = this->last++, s = this->slot(g);
+    this->raw[s] = incoming[i];
+    this->raw[s].index = g;
+    this->points[s] = StreamPoint();
+    this->points[s].radius = std::numeric_limits<double>::infinity();
+    this->raw_grid.insert(s, this->raw[s]);
+    raw_changed.push_back(this->raw[s]);
+    new_slots.push_back(s);
+  }
+
+  // smoothed positions of the new points and of the points near changes
+  std::set<size_t> resmooth(new_slots.begin(), new_slots.end());
+  if (this->r > 0) {
+    std::vector<size_t> ids;
+    for (size_t i = 0; i < raw_changed.size(); ++i) {
+      this->raw_grid.range(raw_changed[i], this->r, ids);
+      resmooth.insert(ids.begin(), ids.end());
+    }
+  }
+  std::set<size_t> dirty(new_slots.begin(), new_slots.end());
+  for (std::set<size_t>::iterator it = resmooth.begin(); it != resmooth.end();
+       ++it) {
+    const size_t s = *it;
+    Point p;
+    this->smoothen(s, p);
+    p.index = this->raw[s].index;
+    if (dirty.find(s) == dirty.end()) {
+      Point &old = this->smoothed[s];
+      if (p.x == old.x && p.y == old.y && p.z == old.z) continue;
+      this->smooth_grid.remove(s, old);
+      changed.push_back(old);
+    }
+    this->smoothed[s] = p;
+    this->smoothed[s].index = p.index;
+    this->smooth_grid.insert(s, p);
+    changed.push_back(p);
+  }
+  this->stats.stop("smoothing");
+  this->stats.count("stream_points_resmoothed", resmooth.size());
+
+  // triplets of the points whose neighbourhood has changed
+  this->stats.start("triplets");
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < changed.size(); ++i) {
+    this->balls.query(changed[i], candidates);
+    for (size_t j = 0; j < candidates.size(); ++j) {
+      const size_t s = candidates[j];
+      if (squared_distance(this->smoothed[s], changed[i]) <=
+          this->points[s].radius)
+        dirty.insert(s);
+    }
+  }
+  this->stats.count("stream_points_dirty", dirty.size());
+  for (std::set<size_t>::iterator it = dirty.begin(); it != dirty.end();
+       ++it) {
+    this->update_triplets(*it, removed, added);
+  }
+  this->stats.stop("triplets");
+
+  // clustering of the changed triplets
+  this->stats.start("clustering");
+  size_t evaluations = this->clustering.evaluations;
+  size_t repairs = this->clustering.repairs;
+  for (size_t i = 0; i < removed.size(); ++i) {
+    const triplet &tr = this->clustering.get(removed[i]);
+    this->drop_reference(tr.point_index_a, removed[i], false);
+    this->drop_reference(tr.point_index_b, removed[i], true);
+    this->drop_reference(tr.point_index_c, removed[i], false);
+  }
+  this->clustering.remove(removed);
+  for (size_t i = 0; i < added.size(); ++i) {
+    const triplet &tr = added[i];
+    size_t t = this->clustering.add(tr);
+    this->points[this->slot(tr.point_index_a)].triplets.push_back(t);
+    this->points[this->slot(tr.point_index_b)].triplets.push_back(t);
+    this->points[this->slot(tr.point_index_c)].triplets.push_back(t);
+    this->points[this->slot(tr.point_index_b)].mids.push_back(t);
+  }
+  this->stats.stop("clustering");
+  this->stats.count("distance_evaluations",
+                    this->clustering.evaluations - evaluations);
+  this->stats.count("stream_repairs", this->clustering.repairs - repairs);
+  this->stats.count("stream_triplets_removed", removed.size());
+  this->stats.count("stream_triplets_added", added.size());
+}
+
+//-------------------------------------------------------------------
+// Median distance of the points in *cloud* to their *k*-th nearest
+// neighbour, searched with the spatial index of type *index*. It is the
+// typical radius of the kNN balls, which can be much larger than
+// sqrt(k)*dnn when the density along the curves varies.
+//-------------------------------------------------------------------
+double median_knn_radius(const PointCloud &cloud, size_t k,
+                         IndexType index, Stats *stats) {
+  Kdtree::KdNodeVector nodes;
+  const size_t dimension = cloud.dimension();
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    nodes.push_back(cloud[i].as_vector(dimension));
+  }
+  SpatialIndex *spatial_index =
+      build_spatial_index(&nodes, index, k + 1, 0.0, stats);
+  std::vector<double> radii(cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    Kdtree::KdNodeVector result;
+    std::vector<double> squared_distances;
+    // k + 1 neighbours, because the first one is the point itself
+    spatial_index->k_nearest_neighbors(nodes[i].point, k + 1, &result,
+                                       &squared_distances);
+    radii[i] = squared_distances.back();
+  }
+  delete spatial_index;
+  std::nth_element(radii.begin(), radii.begin() + radii.size() / 2,
+                   radii.end());
+  return std::sqrt(radii[radii.size() / 2]);
+}
+
+//-------------------------------------------------------------------
+// Runs the incremental clustering on the infile of *opt*. The first
+// -window points determine dnn (and the grid cell size of the neighbour
+// search); then the window is moved by -step points at a time. Returns
+// the exit code for the command line tool.
+//-------------------------------------------------------------------
+int run_stream(Opt &opt, Stats &stats) {
+  const char *fname = opt.get_ifname();
+  const char *prefix = opt.get_ofprefix();
+  const size_t window = opt.get_window();
+  const size_t step = opt.get_step();
+  int opt_verbose = opt.get_verbosity();
+
+  std::ofstream of;
+  if (prefix) {
+    std::string outfname = std::string(prefix) + ".csv";
+    of.open(outfname.c_str());
+    if (!of.is_open()) {
+      std::cerr << "[Error] could not write file '" << outfname << "'"
+                << std::endl;
+      return 2;
+    }
+  }
+
+  int rc = 0;
+  StreamWindow *stream = NULL;
+  size_t n_points = 0, n_steps = 0;
+  try {
+    CsvReader reader(fname, opt.get_delimiter(), opt.get_skip());
+    std::vector<Point> incoming;
+    Point point;
+    bool is2d = false, eof = false;
+    while (!eof && rc == 0) {
+      // the first step fills the whole window
+      size_t want = stream ? step : window;
+      incoming.clear();
+      while (incoming.size() < want && !(eof = !reader.next(point))) {
+        if (n_points == 0) is2d = (reader.points2d() > 0);
+        if (is2d != (reader.points2d() > 0) ||
+            (is2d && reader.points2d() != reader.points())) {
+          throw std::invalid_argument("Mixed 2d and 3d points.");
+        }
+        incoming.push_back(point);
+        n_points++;
+      }
+
+      if (!stream) {
+        if (incoming.empty()) {
+          std::cerr << "[Error] empty cloud in file '" << fname << "'"
+                    << std::endl
+                    << "maybe you used the wrong delimiter" << std::endl;
+          rc = 2;
+          break;
+        }
+        // characteristic length dnn from the first window
+        PointCloud cloud;
+        cloud.set2d(is2d);
+        cloud.insert(cloud.end(), incoming.begin(), incoming.end());
+        stats.start("dnn");
+        double dnn = 0.0;
+        if (incoming.size() > 1) {
+          dnn = std::sqrt(first_quartile(cloud, opt.get_index(), &stats,
+                                         opt.get_threads()));
+        }
+        stats.stop("dnn");
+        stats.set_value("dnn", dnn);
+        if (opt_verbose > 0) {
+          std::cout << "[Info] computed dnn: " << dnn << std::endl;
+        }
+        if (dnn == 0.0) {
+          std::cerr << "[Error] dnn computed as zero in the first window. "
+                    << "Suggestion: use a larger -window or remove "
+                    << "doublets, e.g. with 'sort -u'" << std::endl;
+          rc = 3;
+          break;
+        }
+        opt.set_dnn(dnn);
+        // grid cells of about the size of the kNN balls, so that most
+        // kNN searches only visit the neighbouring cells
+        stats.start("knn_radius");
+        double cellsize = std::max(
+            median_knn_radius(cloud, opt.get_k(), opt.get_index(), &stats),
+            std::sqrt((double)opt.get_k()) * dnn);
+        stats.stop("knn_radius");
+        std::ostream &out = prefix ? of : std::cout;
+        stream = new StreamWindow(opt, window, cellsize, is2d, out, stats);
+        out << std::fixed << "# Comment: curveID -1 represents noise\n"
+            << "# x, y, z, curveID\n";
+      }
+      if (incoming.empty()) break;
+      stream->step(incoming);
+      n_steps++;
+      if (opt_verbose > 1) {
+        std::cout << "[Info] step " << n_steps << ": " << n_points
+                  << " points read, " << stream->n_triplets()
+                  << " triplets and " << stream->n_clusters()
+                  << " clusters in the window" << std::endl;
+      }
+    }
+    if (stream && rc == 0) stream->publish_all();
+  } catch (const std::invalid_argument &e) {
+    std::cerr << "[Error] in file'" << fname << "': " << e.what()
+              << std::endl;
+    rc = 2;
+  } catch (const std::exception &e) {
+    std::cerr << "[Error] cannot read infile '" << fname << "'! " << e.what()
+              << std::endl;
+    rc = 2;
+  }
+  delete stream;
+
+  stats.set_count("points", n_points);
+  stats.set_count("stream_steps", n_steps);
+  if (rc == 0 && opt_verbose > 0) {
+    std::cout << "[Info] clustered " << n_points << " points in " << n_steps
+              << " window steps" << std::endl;
+  }
+  return rc;
+}
@@ -0,0 +1,23 @@
+//
+// stream.h
+//     Incremental clustering of chronologically ordered point streams
+//     in a sliding window.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "option.h"
+#include "stats.h"
+
+// clusters the points of the infile of *opt* in a sliding window of
+// the last -window points, which is moved in steps of -step points,
+// and writes the label of each point when it leaves the window to
+// stdout or <prefix>.csv. Returns the exit code for the command line tool.
+int run_stream(Opt &opt, Stats &stats);
+
+#endif
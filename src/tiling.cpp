@@ -0,0 +1,419 @@
+//
+// tiling.cpp
+//     Splitting of large point clouds into overlapping tiles, which are
+//     clustered independently, and stitching of the tile clusters.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "tiling.h"
+#include "triplet.h"
+
+//-------------------------------------------------------------------
+// Initializes the grid of cubes with edge length *size* that covers
+// the bounding box *lower*, *upper*. Throws std::invalid_argument when
+// the grid has too many cells.
+//-------------------------------------------------------------------
+void TileGrid::init(const double lower[3], const double upper[3],
+                    double size) {
+  double n_cells = 1;
+  this->size = size;
+  for (size_t d = 0; d < 3; ++d) {
+    this->lower[d] = lower[d];
+    double n = std::floor((upper[d] - lower[d]) / size) + 1;
+    n_cells *= n;
+    this->dim[d] = (size_t)n;
+  }
+  if (n_cells > 1e15) {
+    throw std::invalid_argument("tile size too small");
+  }
+}
+
+// grid cell of the coordinate *x* in dimension *d*
+size_t grid_cell(const TileGrid &grid, double x, size_t d) {
+  double cell = std::floor((x - grid.lower[d]) / grid.size);
+  if (cell < 0) return 0;
+  if (cell >= (double)grid.dim[d]) return grid.dim[d] - 1;
+  return (size_t)cell;
+}
+
+size_t TileGrid::cell(double x, double y, double z) const {
+  return (grid_cell(*this, z, 2) * this->dim[1] + grid_cell(*this, y, 1)) *
+             this->dim[0] +
+         grid_cell(*this, x, 0);
+}
+
+void TileGrid::cells(const double p[3], double overlap,
+                     std::vector<size_t> &result) const {
+  size_t lo[3], hi[3];
+  result.clear();
+  for (size_t d = 0; d < 3; ++d) {
+    lo[d] = grid_cell(*this, p[d] - overlap, d);
+    hi[d] = grid_cell(*this, p[d] + overlap, d);
+  }
+  for (size_t z = lo[2]; z <= hi[2]; ++z) {
+    for (size_t y = lo[1]; y <= hi[1]; ++y) {
+      for (size_t x = lo[0]; x <= hi[0]; ++x) {
+        result.push_back((z * this->dim[1] + y) * this->dim[0] + x);
+      }
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+// Splits *cloud* into a grid of cubes with edge length *size*. Each
+// non-empty cube is extended by *overlap* on all sides and becomes a
+// tile in *tiling*, which contains all points within the extended
+// cube. Throws std::invalid_argument when the grid has too many cells.
+//-------------------------------------------------------------------
+void make_tiles(const PointCloud &cloud, double size, double overlap,
+                Tiling &tiling) {
+  tiling.tiles.clear();
+  if (cloud.empty()) return;
+
+  // bounding box
+  double lower[3], upper[3];
+  lower[0] = upper[0] = cloud[0].x;
+  lower[1] = upper[1] = cloud[0].y;
+  lower[2] = upper[2] = cloud[0].z;
+  for (size_t i = 1; i < cloud.size(); ++i) {
+    double p[3] = {cloud[i].x, cloud[i].y, cloud[i].z};
+    for (size_t d = 0; d < 3; ++d) {
+      lower[d] = std::min(lower[d], p[d]);
+      upper[d] = std::max(upper[d], p[d]);
+    }
+  }
+  tiling.grid.init(lower, upper, size);
+
+  // the tiles are the grid cells containing at least one point
+  std::map<size_t, size_t> cell_to_tile;
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    size_t cell = tiling.grid.cell(cloud[i].x, cloud[i].y, cloud[i].z);
+    if (cell_to_tile.find(cell) == cell_to_tile.end()) {
+      cell_to_tile[cell] = tiling.tiles.size();
+      tiling.tiles.push_back(Tile());
+      tiling.tiles.back().cell = cell;
+    }
+  }
+
+  // assign each point to all tiles whose extended cube contains it
+  std::vector<size_t> cells;
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    double p[3] = {cloud[i].x, cloud[i].y, cloud[i].z};
+    tiling.grid.cells(p, overlap, cells);
+    for (size_t j = 0; j < cells.size(); ++j) {
+      std::map<size_t, size_t>::iterator it = cell_to_tile.find(cells[j]);
+      if (it != cell_to_tile.end()) {
+        tiling.tiles[it->second].points.push_back(i);
+      }
+    }
+  }
+}
+
+TileParams::TileParams(Opt &opt) {
+  this->r = opt.get_r();
+  this->k = opt.get_k();
+  this->n = opt.get_n();
+  this->owindow = opt.get_owindow();
+  this->knn_eps = opt.get_knn_eps();
+  this->index = opt.get_index();
+  this->a = opt.get_a();
+  this->s = opt.get_s();
+  this->t = opt.get_t();
+  this->tauto = opt.is_tauto();
+  this->linkage = opt.get_linkage();
+  this->engine = opt.get_engine();
+  this->threads = opt.get_threads();
+  this->membudget = opt.get_membudget() / this->threads;
+}
+
+//-------------------------------------------------------------------
+// Runs steps 1) to 3) on the points *tile_cloud* of a tile, which have
+// the indices *indices* in the whole cloud. The triplets of the
+// unpruned clusters are stored in *result*; a triplet is owned by the
+// tile when its mid point lies in the core box *cell* of *grid*. When
+// *weights* is given, the points are weighted in the smoothing.
+// Returns the exit code for the command line tool, which is 4 when the
+// clustering needs more memory than the budget of the tile.
+//-------------------------------------------------------------------
+int process_tile(const PointCloud &tile_cloud,
+                 const std::vector<size_t> &indices, const TileGrid &grid,
+                 size_t cell, const TileParams &param, TileResult &result,
+                 const std::vector<size_t> *weights) {
+  result.triplets.clear();
+  result.n_triplets = 0;
+  result.n_clusters = 0;
+
+  // Step 1) and 2)
+  PointCloud cloud_smooth;
+  smoothen_cloud(tile_cloud, cloud_smooth, param.r, param.index, weights);
+  std::vector<triplet> triplets;
+  generate_triplets(cloud_smooth, triplets, param.k, param.n, param.a,
+                    param.owindow, param.knn_eps, param.index);
+  result.n_triplets = triplets.size();
+  if (triplets.empty()) return 0;
+
+  // Step 3) with the engine that fits into the memory budget of the
+  // tile, which includes the tile clouds and the triplets
+  double mem_base = 2.0 * tile_cloud.size() * sizeof(Point) +
+                    (double)triplets.size() * sizeof(triplet);
+  HcEngine engine = param.engine;
+  if (engine == ENGINE_AUTO) {
+    engine = ENGINE_MATRIX;
+    if (param.membudget > 0 && param.linkage == SINGLE &&
+        mem_base + estimate_hc_memory(triplets.size(), param.linkage,
+                                      ENGINE_MATRIX) >
+            param.membudget)
+      engine = ENGINE_MATRIXFREE;
+  }
+  if (param.membudget > 0 &&
+      mem_base + estimate_hc_memory(triplets.size(), param.linkage, engine) >
+          param.membudget) {
+    result.error = "memory budget exceeded";
+    return 4;
+  }
+  Dendrogram dendrogram;
+  cluster_group clusters;
+  try {
+    compute_dendrogram(tile_cloud, dendrogram, triplets, param.s,
+                       param.linkage, engine);
+  } catch (const std::bad_alloc &e) {
+    return 4;
+  } catch (const std::runtime_error &e) {
+    result.error = e.what();
+    return 2;
+  }
+  cut_dendrogram(dendrogram, clusters, param.t, param.tauto);
+
+  // only the point indices of the triplets are kept
+  result.n_clusters = clusters.size();
+  result.triplets.reserve(triplets.size());
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    for (size_t i = 0; i < clusters[c].size(); ++i) {
+      const triplet &tr = triplets[clusters[c][i]];
+      const Point &b = tile_cloud[tr.point_index_b];
+      TripletRef ref;
+      ref.a = indices[tr.point_index_a];
+      ref.b = indices[tr.point_index_b];
+      ref.c = indices[tr.point_index_c];
+      ref.cluster = c;
+      ref.owned = (grid.cell(b.x, b.y, b.z) == cell);
+      result.triplets.push_back(ref);
+    }
+  }
+  return 0;
+}
+
+//-------------------------------------------------------------------
+// Reports that the tile *t* with the result *result* of process_tile
+// could not be clustered because of missing memory.
+//-------------------------------------------------------------------
+void print_tile_memory_error(const TileResult &result, size_t t,
+                             const TileParams &param) {
+  if (result.error.empty()) {
+    std::cerr << "[Error] not enough memory for clustering "
+              << result.n_triplets << " triplets of tile " << t << std::endl;
+  } else {
+    std::cerr << "[Error] " << result.error << " by clustering "
+              << result.n_triplets << " triplets of tile " << t
+              << " (budget per tile: " << (size_t)param.membudget
+              << " bytes)" << std::endl;
+  }
+  std::cerr << "Suggestion: use a smaller tile size";
+  if (param.threads > 1) std::cerr << " or fewer threads";
+  std::cerr << std::endl;
+}
+
+//-------------------------------------------------------------------
+// Stitches the triplet clusters *tile_results* of the tiles into global
+// clusters *result*. Clusters of different tiles that contain the same
+// triplet are merged. Each triplet is only kept from the tile whose core
+// contains its mid point, because its neighbourhood is complete there.
+// These triplets are stored in *triplets* (only with point indices).
+// *tile_results* is emptied.
+//-------------------------------------------------------------------
+void stitch_clusters(std::vector<TileResult> &tile_results,
+                     std::vector<triplet> &triplets, cluster_group &result,
+                     Stats &stats) {
+  // all triplet occurrences with global cluster ids
+  std::vector<TripletRef> refs;
+  size_t n_clusters = 0, n_refs = 0;
+  for (size_t t = 0; t < tile_results.size(); ++t) {
+    n_refs += tile_results[t].triplets.size();
+  }
+  refs.reserve(n_refs);
+  for (size_t t = 0; t < tile_results.size(); ++t) {
+    std::vector<TripletRef> &tile_refs = tile_results[t].triplets;
+    for (size_t i = 0; i < tile_refs.size(); ++i) {
+      refs.push_back(tile_refs[i]);
+      refs.back().cluster += n_clusters;
+    }
+    n_clusters += tile_results[t].n_clusters;
+    std::vector<TripletRef>().swap(tile_refs);
+  }
+  std::sort(refs.begin(), refs.end());
+
+  // merge the clusters that share a triplet
+  std::vector<size_t> parent(n_clusters);
+  for (size_t g = 0; g < n_clusters; ++g) parent[g] = g;
+  size_t n_shared = 0, n_merges = 0;
+  for (size_t i = 1; i < refs.size(); ++i) {
+    const TripletRef &prev = refs[i - 1], &cur = refs[i];
+    if (prev < cur) continue;
+    n_shared++;
+    size_t root_g = find_root(parent, prev.cluster);
+    size_t root_h = find_root(parent, cur.cluster);
+    if (root_g == root_h) continue;
+    parent[std::max(root_g, root_h)] = std::min(root_g, root_h);
+    n_merges++;
+  }
+
+  // global clusters of the triplets from the core tiles of their mid points
+  std::vector<size_t> cluster_of(n_clusters, n_clusters);
+  triplets.clear();
+  result.clear();
+  for (size_t i = 0; i < refs.size(); ++i) {
+    const TripletRef &ref = refs[i];
+    if (!ref.owned) continue;
+    size_t root = find_root(parent, ref.cluster);
+    if (cluster_of[root] == n_clusters) {
+      cluster_of[root] = result.size();
+      result.push_back(cluster_t());
+    }
+    result[cluster_of[root]].push_back(triplets.size());
+    triplet tr;
+    tr.point_index_a = ref.a;
+    tr.point_index_b = ref.b;
+    tr.point_index_c = ref.c;
+    tr.error = 0.0;
+    triplets.push_back(tr);
+  }
+
+  stats.set_count("clusters_before_stitching", n_clusters);
+  stats.set_count("stitch_shared_triplets", n_shared);
+  stats.set_count("stitch_merges", n_merges);
+}
+
+//-------------------------------------------------------------------
+// Runs steps 1) to 3) on each tile of *cloud* with -threads threads
+// (when compiled with OpenMP), stitches the tile clusters and runs step 4)
+// on the stitched clusters, which are returned in *result*. *opt* must
+// already be scaled with dnn. When *weights* is given, the points of
+// *cloud* are weighted representatives. Returns the exit code for the
+// command line tool.
+//-------------------------------------------------------------------
+int run_tiled(const PointCloud &cloud, Opt &opt, cluster_group &result,
+              Stats &stats, const std::vector<size_t> *weights) {
+  int opt_verbose = opt.get_verbosity();
+  if (opt.get_engine() == ENGINE_MATRIXFREE && opt.get_linkage() != SINGLE) {
+    std::cerr << "[Error] engine 'matrixfree' requires single linkage"
+              << std::endl;
+    return 1;
+  }
+
+  stats.start("tiling");
+  Tiling tiling;
+  try {
+    make_tiles(cloud, opt.get_tile(), opt.get_overlap(), tiling);
+  } catch (const std::invalid_argument &e) {
+    std::cerr << "[Error] " << e.what() << std::endl;
+    return 1;
+  }
+  stats.stop("tiling");
+  size_t n_tiles = tiling.tiles.size(), n_points = 0, max_points = 0;
+  for (size_t t = 0; t < n_tiles; ++t) {
+    n_points += tiling.tiles[t].points.size();
+    max_points = std::max(max_points, tiling.tiles[t].points.size());
+  }
+  stats.set_count("tiles", n_tiles);
+  stats.set_count("tile_points", n_points);
+  stats.set_count("tile_points_max", max_points);
+  if (opt_verbose > 0) {
+    std::cout << "[Info] split " << cloud.size() << " points into " << n_tiles
+              << " tiles with " << n_points
+              << " points including overlap (at most " << max_points
+              << " per tile)" << std::endl;
+  }
+
+  // Steps 1) to 3) for each tile
+  TileParams param(opt);
+  std::vector<TileResult> tile_results(n_tiles);
+  std::vector<int> rc(n_tiles, 0);
+  stats.start("tiles");
+#pragma omp parallel for num_threads(param.threads) schedule(dynamic) if (param.threads > 1)
+  for (int t = 0; t < (int)n_tiles; ++t) {
+    const Tile &tile = tiling.tiles[t];
+    PointCloud tile_cloud;
+    tile_cloud.setOrdered(cloud.isOrdered());
+    tile_cloud.set2d(cloud.is2d());
+    std::vector<size_t> tile_weights;
+    for (size_t i = 0; i < tile.points.size(); ++i) {
+      tile_cloud.push_back(cloud[tile.points[i]]);
+      if (weights) tile_weights.push_back((*weights)[tile.points[i]]);
+    }
+    rc[t] = process_tile(tile_cloud, tile.points, tiling.grid, tile.cell,
+                         param, tile_results[t],
+                         weights ? &tile_weights : NULL);
+  }
+  stats.stop("tiles");
+  size_t n_tile_triplets = 0;
+  for (size_t t = 0; t < n_tiles; ++t) {
+    if (rc[t] == 2) {
+      std::cerr << "[Error] " << tile_results[t].error << " in tile " << t
+                << std::endl;
+      return 2;
+    } else if (rc[t] == 4) {
+      print_tile_memory_error(tile_results[t], t, param);
+      return 4;
+    }
+    n_tile_triplets += tile_results[t].n_triplets;
+  }
+  stats.set_count("tile_triplets", n_tile_triplets);
+
+  // stitching of the clusters that continue across tile borders
+  stats.start("stitching");
+  std::vector<triplet> triplets;
+  stitch_clusters(tile_results, triplets, result, stats);
+  stats.stop("stitching");
+  stats.set_count("triplets", triplets.size());
+  stats.set_count("clusters_before_pruning", result.size());
+  if (opt_verbose > 0) {
+    std::cout << "[Info] stitched "
+              << stats.get_count("clusters_before_stitching")
+              << " tile clusters into " << result.size() << " clusters ("
+              << stats.get_count("stitch_merges") << " merges, "
+              << stats.get_count("stitch_shared_triplets")
+              << " shared triplets)" << std::endl;
+  }
+
+  // Step 4) pruning by removal of small clusters ...
+  stats.start("pruning");
+  cleanup_cluster_group(result, opt.get_m(), opt_verbose);
+  stats.set_count("clusters_after_pruning", result.size());
+  cluster_triplets_to_points(triplets, result);
+  // .. and (optionally) by splitting up clusters at gaps > dmax
+  if (opt.is_dmax()) {
+    cluster_group cleaned_up_cluster_group;
+    for (cluster_group::iterator cl = result.begin(); cl != result.end();
+         ++cl) {
+      max_step(cleaned_up_cluster_group, *cl, cloud, opt.get_dmax(),
+               opt.get_m() + 2);
+    }
+    result = cleaned_up_cluster_group;
+  }
+  stats.stop("pruning");
+  stats.set_count("clusters", result.size());
+  return 0;
+}
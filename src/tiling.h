@@ -0,0 +1,115 @@
+//
+// tiling.h
+//     Splitting of large point clouds into overlapping tiles, which are
+//     clustered independently, and stitching of the tile clusters.
+//
+// Author:  triplclust contributors
+// Date:    2026-10-16
+// License: see ../LICENSE
+//
+
+#ifndef TILING_H
+#define TILING_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "cluster.h"
+#include "option.h"
+#include "pointcloud.h"
+#include "stats.h"
+
+// grid of cubes with edge length *size* starting at *lower*
+struct TileGrid {
+  double lower[3];
+  double size;
+  size_t dim[3];
+  // grid covering the bounding box *lower*, *upper*; throws
+  // std::invalid_argument when the grid has too many cells
+  void init(const double lower[3], const double upper[3], double size);
+  // cell containing the point (x,y,z)
+  size_t cell(double x, double y, double z) const;
+  // cells whose boxes extended by *overlap* contain the point p
+  void cells(const double p[3], double overlap,
+             std::vector<size_t> &result) const;
+};
+
+// a cell of the grid extended by the overlap on all sides
+struct Tile {
+  size_t cell;                 // grid cell of the core box
+  std::vector<size_t> points;  // indices of all points in the tile
+};
+
+// overlapping tiles of a point cloud
+struct Tiling {
+  TileGrid grid;
+  std::vector<Tile> tiles;  // non-empty tiles
+};
+
+// occurrence of a triplet in a tile cluster, identified by its points
+struct TripletRef {
+  size_t a, b, c;  // point indices into the whole cloud
+  size_t cluster;  // cluster within the tile, global after stitching
+  bool owned;      // mid point lies in the core box of the tile
+  friend bool operator<(const TripletRef &t1, const TripletRef &t2) {
+    if (t1.a != t2.a) return t1.a < t2.a;
+    if (t1.b != t2.b) return t1.b < t2.b;
+    return t1.c < t2.c;
+  }
+};
+
+// triplets of a tile and the number of their clusters before pruning
+struct TileResult {
+  std::vector<TripletRef> triplets;
+  size_t n_triplets, n_clusters;
+  std::string error;  // reason of exit code 2 or 4 of process_tile
+  TileResult() : n_triplets(0), n_clusters(0) {}
+};
+
+// parameters of steps 1) to 3), which are read from Opt once, because
+// its access functions are not const; *threads* tiles are processed at
+// the same time and share the memory budget, so that *membudget* is the
+// budget of a single tile
+struct TileParams {
+  double r, a, s, t, membudget, knn_eps;
+  size_t k, n, owindow;
+  int threads;
+  bool tauto;
+  Linkage linkage;
+  HcEngine engine;
+  IndexType index;
+  TileParams(Opt &opt);
+};
+
+// splits *cloud* into cubes with edge length *size* extended by *overlap*
+void make_tiles(const PointCloud &cloud, double size, double overlap,
+                Tiling &tiling);
+
+// runs steps 1) to 3) on *tile_cloud*, whose points have the indices
+// *indices* in the whole cloud and whose core box is *cell* of *grid*
+// (*weights* are the weights of weighted representatives in the tile)
+int process_tile(const PointCloud &tile_cloud,
+                 const std::vector<size_t> &indices, const TileGrid &grid,
+                 size_t cell, const TileParams &param, TileResult &result,
+                 const std::vector<size_t> *weights = NULL);
+
+// reports the exit code 4 of process_tile for the tile *t*
+void print_tile_memory_error(const TileResult &result, size_t t,
+                             const TileParams &param);
+
+// merges the clusters of *tile_results* that share triplets; the owned
+// triplets are returned in *triplets* and their clusters in *result*
+void stitch_clusters(std::vector<TileResult> &tile_results,
+                     std::vector<triplet> &triplets, cluster_group &result,
+                     Stats &stats);
+
+// runs steps 1) to 3) on each tile, stitches the tile clusters that
+// share triplets in the overlap zones and runs step 4) on the result;
+// *opt* must already be scaled with dnn. *weights* are the weights of
+// weighted representatives in *cloud*. Returns the exit code for the
+// command line tool.
+int run_tiled(const PointCloud &cloud, Opt &opt, cluster_group &result,
+              Stats &stats, const std::vector<size_t> *weights = NULL);
+
+#endif
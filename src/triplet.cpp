@@ -10,11 +10,277 @@
 
 #include <algorithm>
 #include <cmath>
+#include <utility>
 
 #include "kdtree/kdtree.hpp"
+#include "spatialindex.h"
+#include "stats.h"
 #include "triplet.h"
 
 
+//-------------------------------------------------------------------
+// Stores the points of *cloud* as the nodes of a spatial index in
+// *nodes*. The node data points into *indices*, so that *nodes* and
+// *indices* must live as long as the index.
+//-------------------------------------------------------------------
+void build_triplet_nodes(const PointCloud &cloud, Kdtree::KdNodeVector &nodes,
+                         std::vector<size_t> &indices) {
+  const size_t dimension = cloud.dimension();
+  indices.resize(cloud.size(), 0);
+  nodes.clear();
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    indices[i] = i;
+    Kdtree::KdNode n = Kdtree::KdNode(cloud[i].as_vector(dimension),
+                                      (void *)&indices[i]);
+    n.index = cloud[i].index;
+    nodes.push_back(n);//, NULL, (int)cloud[i].index);
+  }
+}
+
+//-------------------------------------------------------------------
+// Computes the triplet candidates with the mid point *point_index_b*
+// from its nearest neighbors *result* in *cloud* (sorted by their
+// *distances*). Candidates with error <= *a* are appended to
+// *triplet_candidates*. Returns the number of tested candidates. The
+// geometry is computed with the *D* coordinates of the kd-tree nodes.
+//-------------------------------------------------------------------
+template <size_t D>
+static size_t find_triplet_candidates_d(
+    const PointCloud &cloud, size_t point_index_b,
+    const Kdtree::KdNodeVector &result, const std::vector<double> &distances,
+    double a, std::vector<triplet> &triplet_candidates) {
+  size_t n_tested = 0;
+  const PointD<D> point_b(cloud[point_index_b]);
+  const size_t index_b = cloud[point_index_b].index;
+
+  // neighbours that can be point_c; in ordered clouds, these are only
+  // the neighbours after point_b
+  std::vector<size_t> candidates_c;
+  for (size_t i = 1; i < result.size(); ++i) {
+    if (!cloud.isOrdered() || index_b <= (size_t)result[i].index)
+      candidates_c.push_back(i);
+  }
+
+  for (size_t result_index_a = 1; result_index_a < result.size();
+       ++result_index_a) {
+    // When the distance is 0, we have the same point as point_b
+    if (distances[result_index_a] == 0) continue;
+    if (cloud.isOrdered() && ((size_t)result[result_index_a].index > index_b))
+      continue;
+    const PointD<D> point_a(&result[result_index_a].point[0]);
+    size_t point_index_a = *(size_t *)result[result_index_a].data;
+
+    PointD<D> direction_ab = point_b - point_a;
+    double ab_norm = direction_ab.norm();
+    direction_ab = direction_ab / ab_norm;
+
+    for (std::vector<size_t>::const_iterator it =
+             std::upper_bound(candidates_c.begin(), candidates_c.end(),
+                              result_index_a);
+         it != candidates_c.end(); ++it) {
+      size_t result_index_c = *it;
+      // When the distance is 0, we have the same point as point_b
+      if (distances[result_index_c] == 0) continue;
+      const PointD<D> point_c(&result[result_index_c].point[0]);
+      size_t point_index_c = *(size_t *)result[result_index_c].data;
+
+      PointD<D> direction_bc = point_c - point_b;
+      double bc_norm = direction_bc.norm();
+      direction_bc = direction_bc / bc_norm;
+
+      const double angle = direction_ab * direction_bc;
+      n_tested++;
+
+      // calculate error
+      const double error = 1.0f - angle;
+
+      if (error <= a) {
+        // calculate center
+        PointD<D> center = (point_a + point_b + point_c) / 3.0f;
+
+        // calculate direction
+        PointD<D> direction = point_c - point_b;
+        direction = direction / direction.norm();
+
+        triplet new_triplet;
+
+        new_triplet.point_index_a = point_index_a;
+        new_triplet.point_index_b = point_index_b;
+        new_triplet.point_index_c = point_index_c;
+        new_triplet.center = PointD<3>(center);
+        new_triplet.direction = PointD<3>(direction);
+        new_triplet.error = error;
+
+        triplet_candidates.push_back(new_triplet);
+      }
+    }
+  }
+  return n_tested;
+}
+
+// find_triplet_candidates_d for the dimension of *cloud*
+size_t find_triplet_candidates(const PointCloud &cloud, size_t point_index_b,
+                               const Kdtree::KdNodeVector &result,
+                               const std::vector<double> &distances,
+                               double a,
+                               std::vector<triplet> &triplet_candidates) {
+  if (cloud.dimension() == 2) {
+    return find_triplet_candidates_d<2>(cloud, point_index_b, result,
+                                        distances, a, triplet_candidates);
+  }
+  return find_triplet_candidates_d<3>(cloud, point_index_b, result,
+                                      distances, a, triplet_candidates);
+}
+
+// index windows up to this multiple of k are searched by a sweep,
+// larger windows with the kd-tree
+const size_t max_sweep_factor = 16;
+
+// search predicate for kd-tree nodes with an index in a window
+struct IndexWindowPredicate : Kdtree::KdNodePredicate {
+  size_t center, owindow;
+  IndexWindowPredicate(size_t center, size_t owindow)
+      : center(center), owindow(owindow) {}
+  bool operator()(const Kdtree::KdNode &node) const {
+    size_t index = (size_t)node.index;
+    return (index + this->owindow >= this->center &&
+            index <= this->center + this->owindow);
+  }
+};
+
+// true when the index window *owindow* is searched with the kd-tree
+bool use_kdtree_for_window(size_t k, size_t owindow) {
+  return owindow > max_sweep_factor * k;
+}
+
+//-------------------------------------------------------------------
+// Returns the type of the spatial index for the triplet neighbours,
+// which is *index*, unless only the kd-tree supports the search, i.e.
+// approximate searches with *knn_eps* and the index window *owindow*
+// of ordered clouds, when it is too large for sweeping.
+//-------------------------------------------------------------------
+IndexType triplet_index_type(IndexType index, size_t k, size_t owindow,
+                             double knn_eps) {
+  if (knn_eps > 0.0 || (owindow > 0 && use_kdtree_for_window(k, owindow)))
+    return INDEX_KDTREE;
+  return index;
+}
+
+//-------------------------------------------------------------------
+// Truncates the nearest neighbours *result* of a point and their
+// *distances* to the nearest ones that represent at least *k* points
+// together, when the points of the cloud are representatives with the
+// *weights*, so that k counts the represented points.
+//-------------------------------------------------------------------
+void truncate_weighted_neighbors(Kdtree::KdNodeVector &result,
+                                 std::vector<double> &distances, size_t k,
+                                 const std::vector<size_t> &weights) {
+  size_t n = 0, sum = 0;
+  while (n < result.size() && sum < k) {
+    sum += weights[*(size_t *)result[n].data];
+    ++n;
+  }
+  result.resize(n);
+  distances.resize(n);
+}
+
+//-------------------------------------------------------------------
+// Finds the *k* nearest neighbors of the point *point_index_b* in the
+// ordered *cloud* among the points whose index differs by at most
+// *owindow* from its index. For large windows, *kdtree* is searched
+// with a predicate. Otherwise, as the points of an ordered cloud are
+// sorted by their index, the window is swept in both directions from
+// *point_index_b*, and *kdtree* may be NULL. *result* and *distances*
+// are in the same form as from KdTree::k_nearest_neighbors, starting
+// with the point itself, and the node data points into *indices*.
+//-------------------------------------------------------------------
+void window_nearest_neighbors(const PointCloud &cloud, size_t point_index_b,
+                              size_t k, size_t owindow,
+                              Kdtree::KdTree *kdtree,
+                              std::vector<size_t> &indices,
+                              Kdtree::KdNodeVector &result,
+                              std::vector<double> &distances) {
+  const Point &point_b = cloud[point_index_b];
+  if (use_kdtree_for_window(k, owindow)) {
+    IndexWindowPredicate predicate(point_b.index, owindow);
+    distances.clear();
+    kdtree->k_nearest_neighbors(point_b.as_vector(cloud.dimension()), k,
+                                &result, &distances, &predicate);
+    return;
+  }
+
+  std::vector<std::pair<double, size_t> > neighbors;
+  size_t lo = point_index_b, hi = point_index_b + 1;
+  while (lo > 0 && cloud[lo - 1].index + owindow >= point_b.index) lo--;
+  while (hi < cloud.size() && cloud[hi].index <= point_b.index + owindow)
+    hi++;
+  for (size_t i = lo; i < hi; ++i) {
+    if (i == point_index_b) continue;
+    neighbors.push_back(
+        std::make_pair((cloud[i] - point_b).squared_norm(), i));
+  }
+  size_t n_neighbors = std::min(neighbors.size(), k > 0 ? k - 1 : 0);
+  std::partial_sort(neighbors.begin(), neighbors.begin() + n_neighbors,
+                    neighbors.end());
+
+  result.clear();
+  distances.clear();
+  result.push_back(Kdtree::KdNode(point_b.as_vector(cloud.dimension()),
+                                  &indices[point_index_b],
+                                  (int)point_b.index));
+  distances.push_back(0.0);
+  for (size_t i = 0; i < n_neighbors; ++i) {
+    const Point &q = cloud[neighbors[i].second];
+    result.push_back(Kdtree::KdNode(q.as_vector(cloud.dimension()),
+                                    &indices[neighbors[i].second],
+                                    (int)q.index));
+    distances.push_back(neighbors[i].first);
+  }
+}
+
+// number of points for which the recall of the approximate kNN search
+// is measured
+const size_t max_recall_samples = 1000;
+
+//-------------------------------------------------------------------
+// Compares the approximate k nearest neighbors from *kdtree* with the
+// exact ones for a sample of the points of *cloud*. The number of
+// compared neighbors and the number of approximate neighbors that are
+// not farther away than the exact k-th neighbor are counted in *stats*,
+// and their ratio is recorded as "knn_recall".
+//-------------------------------------------------------------------
+void record_knn_recall(const PointCloud &cloud, Kdtree::KdTree *kdtree,
+                       size_t k, Stats *stats) {
+  Kdtree::KdNodeVector result;
+  std::vector<double> approximate, exact;
+  double epsilon = kdtree->get_epsilon();
+  size_t stride = std::max(cloud.size() / max_recall_samples, (size_t)1);
+  size_t n_neighbors = 0, n_found = 0;
+  for (size_t i = 0; i < cloud.size(); i += stride) {
+    approximate.clear();
+    exact.clear();
+    std::vector<coord_t> point = cloud[i].as_vector(cloud.dimension());
+    kdtree->set_epsilon(epsilon);
+    kdtree->k_nearest_neighbors(point, k, &result, &approximate);
+    kdtree->set_epsilon(0.0);
+    kdtree->k_nearest_neighbors(point, k, &result, &exact);
+    if (exact.empty()) continue;
+    n_neighbors += exact.size();
+    for (size_t j = 0; j < approximate.size(); ++j) {
+      if (approximate[j] <= exact.back()) n_found++;
+    }
+  }
+  kdtree->set_epsilon(epsilon);
+  stats->count("knn_recall_neighbors", n_neighbors);
+  stats->count("knn_recall_found", n_found);
+  n_neighbors = stats->get_count("knn_recall_neighbors");
+  if (n_neighbors > 0) {
+    stats->set_value("knn_recall",
+                     (double)stats->get_count("knn_recall_found") /
+                         n_neighbors);
+  }
+}
+
 //-------------------------------------------------------------------
 // Generates triplets from the PointCloud *cloud*.
 // The resulting triplets are returned in *triplets*. *k* is the number
@@ -22,85 +288,61 @@
 // *n* is the number of the best triplet candidates to use. This can
 // be lesser than *n*. *a* is the max error (1-angle) for the triplet
 // to be a triplet candidate. If the cloud is ordered, only triplets
-// with a.index < b.index < c.index are considered.
+// with a.index < b.index < c.index are considered, and when *owindow*
+// is not zero, the neighbours are only searched among the points whose
+// index differs by at most *owindow*. When *knn_eps* is not zero, the
+// neighbours are only approximated up to a factor 1 + *knn_eps* in
+// distance. The neighbours are searched with the spatial index of type
+// *index*, if it supports the search. When *weights* is given, the
+// points of *cloud* are representatives of *weights* points each, and
+// the k neighbours are counted with these weights. When *stats* is
+// given, the index build time, the number of tested and accepted
+// triplet candidates, and the recall of the approximate neighbours are
+// recorded.
 //-------------------------------------------------------------------
 void generate_triplets(const PointCloud &cloud, std::vector<triplet> &triplets,
-                       size_t k, size_t n, double a) {
+                       size_t k, size_t n, double a, size_t owindow,
+                       double knn_eps, IndexType index,
+                       const std::vector<size_t> *weights, Stats *stats) {
   std::vector<double> distances;
   Kdtree::KdNodeVector nodes, result;
   std::vector<size_t> indices;  // save the indices so that they can be used
                                 // for the KdNode constructor
-  indices.resize(cloud.size(), 0);
+  size_t n_tested = 0, n_accepted = 0;
+  bool use_window = (cloud.isOrdered() && owindow > 0);
 
-  // build kdtree
-  for (size_t i = 0; i < cloud.size(); ++i) {
-    indices[i] = i;
-    Kdtree::KdNode n = Kdtree::KdNode(cloud[i].as_vector(), (void *)&indices[i]);
-    n.index = cloud[i].index;
-    nodes.push_back(n);//, NULL, (int)cloud[i].index);
+  // build spatial index, unless the index window is swept
+  SpatialIndex *spatial_index = NULL;
+  Kdtree::KdTree *kdtree = NULL;
+  if (use_window && !use_kdtree_for_window(k, owindow)) {
+    indices.resize(cloud.size());
+    for (size_t i = 0; i < cloud.size(); ++i) indices[i] = i;
+  } else {
+    build_triplet_nodes(cloud, nodes, indices);
+    spatial_index = build_spatial_index(
+        &nodes,
+        triplet_index_type(index, k, use_window ? owindow : 0, knn_eps), k,
+        0.0, stats);
+    kdtree = spatial_index->get_kdtree();
+    if (kdtree) kdtree->set_epsilon(knn_eps);
   }
-  Kdtree::KdTree kdtree(&nodes);
 
   for (size_t point_index_b = 0; point_index_b < cloud.size();
        ++point_index_b) {
     distances.clear();
-    Point point_b = cloud[point_index_b];
     std::vector<triplet> triplet_candidates;
-    kdtree.k_nearest_neighbors(cloud[point_index_b].as_vector(), k, &result,
-                               &distances);
-
-    for (size_t result_index_a = 1; result_index_a < result.size();
-         ++result_index_a) {
-      // When the distance is 0, we have the same point as point_b
-      if (distances[result_index_a] == 0) continue;
-      Point point_a(result[result_index_a].point);
-      point_a.index = result[result_index_a].index;
-      if (cloud.isOrdered() && (point_a.index > point_b.index)) continue;
-      size_t point_index_a = *(size_t *)result[result_index_a].data;
-
-      Point direction_ab = point_b - point_a;
-      double ab_norm = direction_ab.norm();
-      direction_ab = direction_ab / ab_norm;
-
-      for (size_t result_index_c = result_index_a + 1;
-           result_index_c < result.size(); ++result_index_c) {
-        // When the distance is 0, we have the same point as point_b
-        if (distances[result_index_c] == 0) continue;
-        Point point_c = Point(result[result_index_c].point);
-        point_c.index = result[result_index_c].index;
-        if (cloud.isOrdered() && (point_b.index > point_c.index)) continue;
-        size_t point_index_c = *(size_t *)result[result_index_c].data;   
-
-        Point direction_bc = point_c - point_b;
-        double bc_norm = direction_bc.norm();
-        direction_bc = direction_bc / bc_norm;
-
-        const double angle = direction_ab * direction_bc;
-
-        // calculate error
-        const double error = 1.0f - angle;
-
-        if (error <= a) {
-          // calculate center
-          Point center = (point_a + point_b + point_c) / 3.0f;
-
-          // calculate direction
-          Point direction = point_c - point_b;
-          direction = direction / direction.norm();
-
-          triplet new_triplet;
-
-          new_triplet.point_index_a = point_index_a;
-          new_triplet.point_index_b = point_index_b;
-          new_triplet.point_index_c = point_index_c;
-          new_triplet.center = center;
-          new_triplet.direction = direction;
-          new_triplet.error = error;
-
-          triplet_candidates.push_back(new_triplet);
-        }
-      }
+    if (use_window) {
+      window_nearest_neighbors(cloud, point_index_b, k, owindow, kdtree,
+                               indices, result, distances);
+    } else {
+      spatial_index->k_nearest_neighbors(
+          cloud[point_index_b].as_vector(cloud.dimension()), k, &result,
+          &distances);
     }
+    if (weights) truncate_weighted_neighbors(result, distances, k, *weights);
+    n_tested += find_triplet_candidates(cloud, point_index_b, result,
+                                        distances, a, triplet_candidates);
+    n_accepted += triplet_candidates.size();
 
     // order triplet candidates
     std::sort(triplet_candidates.begin(), triplet_candidates.end());
@@ -110,32 +352,119 @@ void generate_triplets(const PointCloud &cloud, std::vector<triplet> &triplets,
       triplets.push_back(triplet_candidates[i]);
     }
   }
+  if (stats && !use_window && knn_eps > 0.0) {
+    record_knn_recall(cloud, kdtree, k, stats);
+  }
+  delete spatial_index;
+
+  if (stats) {
+    stats->count("triplet_candidates_tested", n_tested);
+    stats->count("triplet_candidates_accepted", n_accepted);
+    stats->set_count("triplets", triplets.size());
+  }
 }
 
-// initialization of scale factor for triplet dissimilarity
-ScaleTripletMetric::ScaleTripletMetric(double s) {
-  this->scale = s;
+//-------------------------------------------------------------------
+// Prepares the triplet candidates of a parameter sweep over the points
+// of *cloud*, which must live as long as this object. The neighbours
+// are searched with the spatial index of type *index*, and counted
+// with the *weights* of the points, when given, which must live as
+// long as this object, too. A kd-tree is built only once for all
+// values of k, and when *stats* is given, its build time is recorded.
+//-------------------------------------------------------------------
+TripletCandidates::TripletCandidates(const PointCloud &cloud,
+                                     IndexType index,
+                                     const std::vector<size_t> *weights,
+                                     Stats *stats)
+    : cloud(cloud), weights(weights), index_type(index),
+      spatial_index(NULL) {
+  build_triplet_nodes(cloud, this->nodes, this->indices);
+  if (index == INDEX_KDTREE) {
+    this->spatial_index =
+        build_spatial_index(&this->nodes, INDEX_KDTREE, 0, 0.0, stats);
+  }
 }
 
+TripletCandidates::~TripletCandidates() { delete this->spatial_index; }
 
-// dissimilarity measure for triplets
-double ScaleTripletMetric::operator()(const triplet &lhs, const triplet &rhs) {
-  const double perpendicularDistanceA =
-    (rhs.center - lhs.center +
-     lhs.direction * (lhs.center - rhs.center) * lhs.direction).squared_norm();
-  const double perpendicularDistanceB =
-    (lhs.center - rhs.center +
-     rhs.direction * (rhs.center - lhs.center) * rhs.direction).squared_norm();
-  
-  double anglecos = lhs.direction * rhs.direction;
-  if (anglecos > 1.0) anglecos = 1.0;
-  if (anglecos < -1.0) anglecos = -1.0;
-  if (std::fabs(anglecos) < 1.0e-8) {
-    return 1.0e+8;
-  } else {
-    return (
-       std::sqrt(std::max(perpendicularDistanceA, perpendicularDistanceB)) /
-       this->scale +
-       std::fabs(std::tan(std::acos(anglecos))) );
+//-------------------------------------------------------------------
+// Computes the triplet candidates of all points for *k* neighbors and
+// the largest value *amax* that is used in the parameter sweep. When
+// *stats* is given, the number of tested and accepted triplet
+// candidates and the recall of the approximate neighbours are recorded.
+// *owindow* and *knn_eps* are the index window and the approximation
+// factor of generate_triplets. As the cell size of a grid depends on
+// *k*, a grid index is rebuilt for each k.
+//-------------------------------------------------------------------
+void TripletCandidates::generate(size_t k, double amax, size_t owindow,
+                                 double knn_eps, Stats *stats) {
+  std::vector<double> distances;
+  Kdtree::KdNodeVector result;
+  size_t n_tested = 0;
+  bool use_window = (this->cloud.isOrdered() && owindow > 0);
+
+  IndexType type = triplet_index_type(this->index_type, k,
+                                      use_window ? owindow : 0, knn_eps);
+  if (!this->spatial_index || type != INDEX_KDTREE ||
+      !this->spatial_index->get_kdtree()) {
+    delete this->spatial_index;
+    this->spatial_index =
+        build_spatial_index(&this->nodes, type, k, 0.0, stats);
+  }
+  Kdtree::KdTree *kdtree = this->spatial_index->get_kdtree();
+  if (kdtree) kdtree->set_epsilon(knn_eps);
+  this->candidates.clear();
+  this->offsets.assign(1, 0);
+  for (size_t point_index_b = 0; point_index_b < this->cloud.size();
+       ++point_index_b) {
+    distances.clear();
+    if (use_window) {
+      window_nearest_neighbors(this->cloud, point_index_b, k, owindow,
+                               kdtree, this->indices, result, distances);
+    } else {
+      this->spatial_index->k_nearest_neighbors(
+          this->cloud[point_index_b].as_vector(this->cloud.dimension()), k,
+          &result, &distances);
+    }
+    if (this->weights) {
+      truncate_weighted_neighbors(result, distances, k, *this->weights);
+    }
+    n_tested += find_triplet_candidates(this->cloud, point_index_b, result,
+                                        distances, amax, this->candidates);
+    this->offsets.push_back(this->candidates.size());
+  }
+  if (stats && !use_window && knn_eps > 0.0) {
+    record_knn_recall(this->cloud, kdtree, k, stats);
+  }
+
+  if (stats) {
+    stats->count("triplet_candidates_tested", n_tested);
+    stats->count("triplet_candidates_accepted", this->candidates.size());
+  }
+}
+
+//-------------------------------------------------------------------
+// Selects the triplets for the parameters *n* and *a* from the
+// candidates and stores them in *triplets*. *a* must not be larger
+// than the value used in generate(). The result is the same as from
+// generate_triplets with the same k.
+//-------------------------------------------------------------------
+void TripletCandidates::select(size_t n, double a,
+                               std::vector<triplet> &triplets) const {
+  std::vector<triplet> triplet_candidates;
+  triplets.clear();
+  for (size_t b = 0; b + 1 < this->offsets.size(); ++b) {
+    // the candidates are in the same order as in generate_triplets,
+    // so that sorting yields the same order for equal errors
+    triplet_candidates.clear();
+    for (size_t i = this->offsets[b]; i < this->offsets[b + 1]; ++i) {
+      if (this->candidates[i].error <= a) {
+        triplet_candidates.push_back(this->candidates[i]);
+      }
+    }
+    std::sort(triplet_candidates.begin(), triplet_candidates.end());
+    for (size_t i = 0; i < std::min(n, triplet_candidates.size()); ++i) {
+      triplets.push_back(triplet_candidates[i]);
+    }
   }
 }
@@ -11,36 +11,120 @@
 #ifndef TRIPLET_H
 #define TRIPLET_H
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <vector>
 
+#include "kdtree/kdtree.hpp"
 #include "pointcloud.h"
+#include "util.h"
 
-// triplet of three points
+class SpatialIndex;
+class Stats;
+
+// triplet of three points; center and direction have z = 0 in 2D
+// clouds, so that the stored triplets do not depend on the dimension
 struct triplet {
   size_t point_index_a;
   size_t point_index_b;
   size_t point_index_c;
-  Point center;
-  Point direction;
+  PointD<3> center;
+  PointD<3> direction;
   double error;
   friend bool operator<(const triplet &t1, const triplet &t2) {
     return (t1.error < t2.error);
   };
 };
 
-// dissimilarity for triplets.
+// dissimilarity for triplets in a cloud of dimension *D*, which is
+// computed from the first D coordinates of centers and directions.
 // scale is an external scale factor.
+template <size_t D>
 class ScaleTripletMetric {
  private:
   double scale;
 
  public:
-  ScaleTripletMetric(double s);
-  double operator()(const triplet &lhs, const triplet &rhs);
+  ScaleTripletMetric(double s) : scale(s) {}
+  double operator()(const triplet &lhs, const triplet &rhs) const {
+    const PointD<D> lhs_center(lhs.center), lhs_direction(lhs.direction);
+    const PointD<D> rhs_center(rhs.center), rhs_direction(rhs.direction);
+    const double perpendicularDistanceA =
+        (rhs_center - lhs_center +
+         lhs_direction * (lhs_center - rhs_center) * lhs_direction)
+            .squared_norm();
+    const double perpendicularDistanceB =
+        (lhs_center - rhs_center +
+         rhs_direction * (rhs_center - lhs_center) * rhs_direction)
+            .squared_norm();
+
+    double anglecos = lhs_direction * rhs_direction;
+    if (anglecos > 1.0) anglecos = 1.0;
+    if (anglecos < -1.0) anglecos = -1.0;
+    if (std::fabs(anglecos) < 1.0e-8) {
+      return 1.0e+8;
+    } else {
+      return (
+          std::sqrt(std::max(perpendicularDistanceA, perpendicularDistanceB)) /
+              this->scale +
+          std::fabs(std::tan(std::acos(anglecos))));
+    }
+  }
 };
 
-// generates triplets from PointCloud
+// appends the triplet candidates with mid point *point_index_b* from its
+// nearest neighbours *result* in *cloud* and returns the number of tests
+size_t find_triplet_candidates(const PointCloud &cloud, size_t point_index_b,
+                               const Kdtree::KdNodeVector &result,
+                               const std::vector<double> &distances,
+                               double a,
+                               std::vector<triplet> &triplet_candidates);
+
+// k nearest neighbours of the point *point_index_b* of an ordered cloud
+// among the points whose index differs by at most *owindow*
+void window_nearest_neighbors(const PointCloud &cloud, size_t point_index_b,
+                              size_t k, size_t owindow,
+                              Kdtree::KdTree *kdtree,
+                              std::vector<size_t> &indices,
+                              Kdtree::KdNodeVector &result,
+                              std::vector<double> &distances);
+
+// generates triplets from PointCloud (with *weights*, the points are
+// weighted representatives)
 void generate_triplets(const PointCloud &cloud, std::vector<triplet> &triplets,
-                       size_t k, size_t n, double a);
+                       size_t k, size_t n, double a, size_t owindow = 0,
+                       double knn_eps = 0.0, IndexType index = INDEX_KDTREE,
+                       const std::vector<size_t> *weights = NULL,
+                       Stats *stats = NULL);
+
+// triplet candidates of all points for one k and the largest a in a
+// parameter sweep, from which the triplets for all values of n and
+// smaller values of a can be selected. A kd-tree is only built once
+// for all values of k.
+class TripletCandidates {
+ private:
+  const PointCloud &cloud;
+  const std::vector<size_t> *weights;
+  Kdtree::KdNodeVector nodes;
+  std::vector<size_t> indices;
+  IndexType index_type;
+  SpatialIndex *spatial_index;
+  // candidates of each point in the order of their generation, the
+  // candidates of point i are in [offsets[i], offsets[i+1])
+  std::vector<triplet> candidates;
+  std::vector<size_t> offsets;
+  // not copyable
+  TripletCandidates(const TripletCandidates &);
+  TripletCandidates &operator=(const TripletCandidates &);
+
+ public:
+  TripletCandidates(const PointCloud &cloud, IndexType index = INDEX_KDTREE,
+                    const std::vector<size_t> *weights = NULL,
+                    Stats *stats = NULL);
+  ~TripletCandidates();
+  void generate(size_t k, double amax, size_t owindow = 0,
+                double knn_eps = 0.0, Stats *stats = NULL);
+  void select(size_t n, double a, std::vector<triplet> &triplets) const;
+};
 #endif
@@ -8,8 +8,15 @@
 //
 
 #include "util.h"
+#include <cstdio>
+#include <ctime>
 #include <sstream>
 #include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
 
 //-------------------------------------------------------------------
 // converts *str* to double.
@@ -32,3 +39,72 @@ double stod(const char* s) {
   }
   return result;
 }
+
+// Split string *input* into substrings by *delimiter*. The result is
+// returned in *result*
+void split(const std::string &input, std::vector<std::string> &result,
+           const char delimiter) {
+  std::stringstream ss(input);
+  std::string element;
+
+  while (std::getline(ss, element, delimiter)) {
+    result.push_back(element);
+  }
+}
+
+//-------------------------------------------------------------------
+// elapsed wall clock time in seconds.
+// Only differences between two calls are meaningful.
+//-------------------------------------------------------------------
+double wall_time() {
+#ifdef _WIN32
+  LARGE_INTEGER freq, count;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+  return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + 1.0e-6 * (double)tv.tv_usec;
+#endif
+}
+
+//-------------------------------------------------------------------
+// CPU time in seconds consumed by the process (all threads).
+// Only differences between two calls are meaningful.
+//-------------------------------------------------------------------
+double cpu_time() { return (double)std::clock() / CLOCKS_PER_SEC; }
+
+//-------------------------------------------------------------------
+// escapes quotes, backslashes and control characters in *str*
+// so that it can be written as a JSON string.
+//-------------------------------------------------------------------
+std::string json_escape(const std::string& str) {
+  std::string result;
+  for (size_t i = 0; i < str.size(); ++i) {
+    unsigned char c = (unsigned char)str[i];
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += (char)c;
+    } else if (c < 0x20) {
+      char buff[8];
+      sprintf(buff, "\\u%04x", (unsigned int)c);
+      result += buff;
+    } else {
+      result += (char)c;
+    }
+  }
+  return result;
+}
+
+//-------------------------------------------------------------------
+// root of *i* in the union-find forest *parent*, where parent[i] == i
+// for the roots. The path is halved on the way.
+//-------------------------------------------------------------------
+size_t find_root(std::vector<size_t>& parent, size_t i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
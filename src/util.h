@@ -10,9 +10,49 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <string>
+#include <vector>
+
+#define TRIPLCLUST_VERSION "1.5"
+
 enum Linkage { SINGLE, COMPLETE, AVERAGE };
 
+// algorithms for computing the dendrogram:
+// ENGINE_MATRIX stores the full condensed distance matrix,
+// ENGINE_MATRIXFREE computes distances on demand (single linkage only),
+// ENGINE_DISK stores the matrix in a memory-mapped file,
+// ENGINE_GRAPH computes only the clusters at a fixed threshold as
+// connected components (single linkage only, no dendrogram),
+// ENGINE_AUTO chooses one of these depending on the memory budget
+enum HcEngine {
+  ENGINE_AUTO,
+  ENGINE_MATRIX,
+  ENGINE_MATRIXFREE,
+  ENGINE_DISK,
+  ENGINE_GRAPH
+};
+
+// spatial index for the neighbour searches:
+// INDEX_KDTREE is a kd-tree, INDEX_GRID is a uniform grid of cells,
+// INDEX_AUTO chooses one of these depending on the point distribution
+enum IndexType { INDEX_KDTREE, INDEX_GRID, INDEX_AUTO };
+
 // converts *str* to double.
 double stod(const char* str);
 
+// splits *input* at *delimiter* and appends the substrings to *result*.
+void split(const std::string& input, std::vector<std::string>& result,
+           const char delimiter);
+
+// elapsed wall clock time in seconds since an arbitrary fixed point.
+double wall_time();
+// CPU time in seconds consumed by the process so far.
+double cpu_time();
+
+// root of *i* in the union-find forest *parent* (with path halving).
+size_t find_root(std::vector<size_t>& parent, size_t i);
+
+// escapes *str* for use as a JSON string literal (without quotes).
+std::string json_escape(const std::string& str);
+
 #endif